@@ -9,7 +9,9 @@ namespace bp
 class AttachmentSlot
 {
 public:
-	AttachmentSlot() : description{} {}
+	AttachmentSlot() :
+		description{},
+		usedAfterPass{true} {}
 	AttachmentSlot(VkFormat format, VkSampleCountFlagBits samples,
 		       VkAttachmentLoadOp loadOp, VkAttachmentStoreOp storeOp,
 		       VkImageLayout initialLayout, VkImageLayout finalLayout) :
@@ -32,9 +34,28 @@ public:
 		description.finalLayout = finalLayout;
 	}
 
+	/*
+	 * Whether the contents of the attachment are used after the render pass, by sampling,
+	 * copying or presenting them. Render passes only store attachments that are used after
+	 * the pass.
+	 */
+	void setUsedAfterPass(bool usedAfterPass) { AttachmentSlot::usedAfterPass = usedAfterPass; }
+
+	/*
+	 * Attachments that are neither loaded nor used after the render pass only live within it,
+	 * and can be transient images backed by lazily allocated memory.
+	 */
+	bool isTransient() const
+	{
+		return !usedAfterPass && description.loadOp != VK_ATTACHMENT_LOAD_OP_LOAD
+		       && description.stencilLoadOp != VK_ATTACHMENT_LOAD_OP_LOAD;
+	}
+
 	const VkAttachmentDescription& getDescription() const { return description; }
+	bool isUsedAfterPass() const { return usedAfterPass; }
 private:
 	VkAttachmentDescription description;
+	bool usedAfterPass;
 };
 
 /*
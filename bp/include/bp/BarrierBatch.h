@@ -0,0 +1,79 @@
+#ifndef BP_BARRIERBATCH_H
+#define BP_BARRIERBATCH_H
+
+#include "Device.h"
+#include <vector>
+
+namespace bp
+{
+
+/*
+ * Collects global, image and buffer memory barriers and records them with a single pipeline barrier
+ * command. The barriers are given in their original form, with the stages they synchronize
+ * given separately. vkCmdPipelineBarrier2KHR is used when the Vulkan headers have
+ * VK_KHR_synchronization2 and it is enabled, keeping the stages of each barrier separate. The
+ * synchronization2 feature must then be enabled through DeviceRequirements::next as well.
+ * Otherwise the barriers are recorded with the union of their stages.
+ *
+ * Stages are limited to the ones supported by the queue family of the command buffer when it
+ * was allocated by a command pool or the command pool manager, so that state tracked from use
+ * on one queue can be used in barriers recorded for another, such as a transfer-only queue.
+ */
+class BarrierBatch
+{
+public:
+	BarrierBatch() :
+		device{nullptr} {}
+	explicit BarrierBatch(Device& device) :
+		BarrierBatch{}
+	{
+		init(device);
+	}
+
+	void init(Device& device);
+
+	void addMemoryBarrier(const VkMemoryBarrier& barrier, VkPipelineStageFlags srcStage,
+			      VkPipelineStageFlags dstStage);
+	void addImageBarrier(const VkImageMemoryBarrier& barrier, VkPipelineStageFlags srcStage,
+			     VkPipelineStageFlags dstStage);
+	void addBufferBarrier(const VkBufferMemoryBarrier& barrier, VkPipelineStageFlags srcStage,
+			      VkPipelineStageFlags dstStage);
+
+	/*
+	 * Record the collected barriers and clear the batch. Nothing is recorded if the batch is
+	 * empty.
+	 */
+	void record(VkCommandBuffer cmdBuffer);
+	void clear();
+
+	bool isEmpty() const
+	{
+		return memoryBarriers.empty() && imageBarriers.empty() && bufferBarriers.empty();
+	}
+	bool isReady() const { return device != nullptr; }
+
+private:
+	struct Stages
+	{
+		VkPipelineStageFlags src;
+		VkPipelineStageFlags dst;
+	};
+
+	Device* device;
+	std::vector<VkMemoryBarrier> memoryBarriers;
+	std::vector<Stages> memoryStages;
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	std::vector<Stages> imageStages;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	std::vector<Stages> bufferStages;
+
+#ifdef VK_KHR_synchronization2
+	void recordSynchronization2(VkCommandBuffer cmdBuffer);
+#endif
+	void recordLegacy(VkCommandBuffer cmdBuffer);
+	void assertReady();
+};
+
+}
+
+#endif
@@ -3,8 +3,8 @@
 
 #include "Device.h"
 #include "Image.h"
-#include "CommandPool.h"
 #include "MemoryAllocator.h"
+#include <vector>
 
 namespace bp
 {
@@ -15,21 +15,30 @@ public:
 	Buffer() :
 		device{nullptr},
 		size{0},
+		usage{0},
 		handle{VK_NULL_HANDLE},
+		ownerQueueFamily{VK_QUEUE_FAMILY_IGNORED},
 		memory{nullptr},
 		stagingBuffer{nullptr} {}
 	Buffer(Device& device, VkDeviceSize size, VkBufferUsageFlags usage,
-	       VmaMemoryUsage memoryUsage) :
+	       VmaMemoryUsage memoryUsage, MemoryPool memoryPool = MemoryPool::DEFAULT) :
 		Buffer()
 	{
-		init(device, size, usage, memoryUsage);
+		init(device, size, usage, memoryUsage, memoryPool);
 	}
 	~Buffer();
 
 	void init(Device& device, VkDeviceSize size, VkBufferUsageFlags usage,
-		  VmaMemoryUsage memoryUsage);
+		  VmaMemoryUsage memoryUsage, MemoryPool memoryPool = MemoryPool::DEFAULT);
+
+	/*
+	 * Share the buffer between the queue families instead of transferring its ownership, e.g.
+	 * for small buffers that are updated often. Must be set before init.
+	 */
+	void setConcurrentSharing(const std::vector<uint32_t>& queueFamilyIndices);
 
 	uint8_t* map();
+	void flushMapped() { memory->flushMapped(); }
 	void createStagingBuffer();
 	void freeStagingBuffer();
 	void updateStagingBuffer(VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
@@ -41,21 +50,59 @@ public:
 		      VkDeviceSize size, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
 	void transfer(Image& src, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
 
+	/*
+	 * Let defragmentation move the buffer. Its contents are copied to the new buffer by the
+	 * device, so buffers written by the CPU while the device reads them, such as rings, arenas
+	 * and staging buffers, must not be relocatable. The old handle is retired to the device,
+	 * and relocateEvent is triggered.
+	 */
+	void enableRelocation();
+
+	/*
+	 * Queue family ownership transfer of an exclusive buffer. The release is recorded on the
+	 * source queue and the acquire on the destination queue, which must wait for the release
+	 * with a semaphore. The acquiring family is recorded as the owner of the buffer.
+	 */
+	void releaseOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkAccessFlags srcAccess, VkPipelineStageFlags srcStage,
+			      VkCommandBuffer cmdBuffer);
+	void acquireOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkAccessFlags dstAccess, VkPipelineStageFlags dstStage,
+			      VkCommandBuffer cmdBuffer);
+
 	operator VkBuffer() { return handle; }
 
 	VkDeviceSize getSize() const { return size; }
 	VkBuffer getHandle() { return handle; }
+	bool isMapped() const { return memory->isMapped(); }
+	bool isConcurrent() const { return queueFamilies.size() > 1; }
+	/*
+	 * The queue family that last acquired the buffer, or VK_QUEUE_FAMILY_IGNORED if its
+	 * ownership has never been transferred.
+	 */
+	uint32_t getOwnerQueueFamily() const { return ownerQueueFamily; }
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
 
+	/*
+	 * Triggered when the buffer has been recreated after its memory was moved by
+	 * defragmentation. Descriptors and other objects referring to the old handle must be
+	 * updated.
+	 */
+	bpUtil::Event<> relocateEvent;
+
 private:
 	Device* device;
 	VkDeviceSize size;
+	VkBufferUsageFlags usage;
 	VkBuffer handle;
-	CommandPool cmdPool;
+	std::vector<uint32_t> queueFamilies;
+	uint32_t ownerQueueFamily;
 
 	std::shared_ptr<Memory> memory;
 	Buffer* stagingBuffer;
 
+	VkBufferCreateInfo createInfo() const;
+	void relocate(VkCommandBuffer cmdBuffer, const std::shared_ptr<Allocation>& oldMemory);
 	void assertReady();
 };
 
@@ -15,12 +15,35 @@ public:
 	BufferDescriptor(VkDescriptorType type, uint32_t binding, uint32_t firstIndex,
 			const std::vector<VkDescriptorBufferInfo>& infos) :
 		Descriptor{type, binding, firstIndex},
-		descriptorInfos{infos} {}
+		descriptorInfos{infos}
+	{
+		updateInfos();
+	}
+	BufferDescriptor(const BufferDescriptor& other) :
+		Descriptor{other},
+		descriptorInfos{other.descriptorInfos}
+	{
+		updateInfos();
+	}
+	BufferDescriptor& operator=(const BufferDescriptor& other)
+	{
+		Descriptor::operator=(other);
+		descriptorInfos = other.descriptorInfos;
+		updateInfos();
+		return *this;
+	}
 	virtual ~BufferDescriptor() = default;
 
+	void resetDescriptorInfos()
+	{
+		descriptorInfos.clear();
+		updateInfos();
+	}
+
 	void addDescriptorInfo(const VkDescriptorBufferInfo& info)
 	{
 		descriptorInfos.push_back(info);
+		updateInfos();
 	}
 
 	const std::vector<VkDescriptorBufferInfo>& getDescriptorInfos() const
@@ -42,6 +65,12 @@ public:
 
 private:
 	std::vector<VkDescriptorBufferInfo> descriptorInfos;
+
+	void updateInfos()
+	{
+		setInfos(descriptorInfos.data(), sizeof(VkDescriptorBufferInfo),
+			 static_cast<uint32_t>(descriptorInfos.size()));
+	}
 };
 
 }
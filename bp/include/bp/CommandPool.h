@@ -33,16 +33,30 @@ public:
 		uint32_t count, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 	void freeCommandBuffer(VkCommandBuffer cmdBuffer);
 	void freeCommandBuffers(std::vector<VkCommandBuffer>& cmdBuffers);
+	void reset();
 
 	operator VkCommandPool() { return handle; }
 
+	/*
+	 * Queue family of the pool a command buffer was allocated from by a command pool or the
+	 * command pool manager, or VK_QUEUE_FAMILY_IGNORED for other command buffers.
+	 */
+	static uint32_t getQueueFamilyIndex(VkCommandBuffer cmdBuffer);
+
 	Queue* getQueue() { return queue; }
 	VkCommandPool getHandle() { return handle; }
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
 
 private:
+	friend class CommandPoolManager;
+
 	Queue* queue;
 	VkCommandPool handle;
+
+	static void registerCommandBuffers(VkCommandPool pool, uint32_t queueFamilyIndex,
+					   const VkCommandBuffer* cmdBuffers, uint32_t count);
+	static void unregisterCommandBuffers(const VkCommandBuffer* cmdBuffers, uint32_t count);
+	static void unregisterPool(VkCommandPool pool);
 };
 
 }
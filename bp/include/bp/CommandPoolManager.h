@@ -0,0 +1,81 @@
+#ifndef BP_COMMANDPOOLMANAGER_H
+#define BP_COMMANDPOOLMANAGER_H
+
+#include "Queue.h"
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <functional>
+
+namespace bp
+{
+
+/*
+ * Hands out command buffers from one transient command pool per thread and queue family.
+ * Command buffers are given back with release when the device is done executing them, and are
+ * recycled by resetting the whole pool once every command buffer from it has been released.
+ * A command buffer must be recorded on the thread that acquired it. execute is a shorthand for
+ * recording and submitting a one-off command buffer, and waiting for it to complete. The pools
+ * of threads that have exited are destroyed when a new pool is created, once all their command
+ * buffers have been released.
+ */
+class CommandPoolManager
+{
+public:
+	CommandPoolManager() :
+		device{VK_NULL_HANDLE} {}
+	explicit CommandPoolManager(VkDevice device) :
+		CommandPoolManager{}
+	{
+		init(device);
+	}
+	~CommandPoolManager();
+
+	void init(VkDevice device);
+
+	VkCommandBuffer acquire(uint32_t queueFamilyIndex,
+				VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+	void release(VkCommandBuffer cmdBuffer);
+	void execute(Queue& queue, const std::function<void(VkCommandBuffer)>& commands);
+
+	bool isReady() const { return device != VK_NULL_HANDLE; }
+
+private:
+	struct ThreadPool
+	{
+		ThreadPool() :
+			handle{VK_NULL_HANDLE},
+			acquiredCount{0} {}
+
+		VkCommandPool handle;
+		std::weak_ptr<int> thread;
+		std::mutex mutex;
+		unsigned acquiredCount;
+		std::vector<VkCommandBuffer> available[2];
+		std::vector<std::pair<VkCommandBuffer, VkCommandBufferLevel>> released;
+	};
+
+	struct Owner
+	{
+		ThreadPool* pool;
+		VkCommandBufferLevel level;
+	};
+
+	VkDevice device;
+	std::mutex poolsMutex;
+	std::map<std::pair<std::thread::id, uint32_t>, std::unique_ptr<ThreadPool>> pools;
+	std::unordered_map<VkCommandBuffer, Owner> owners;
+
+	ThreadPool& getThreadPool(uint32_t queueFamilyIndex);
+	void destroyExitedPools();
+	void assertReady();
+};
+
+}
+
+#endif
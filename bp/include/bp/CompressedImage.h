@@ -0,0 +1,74 @@
+#ifndef BP_COMPRESSEDIMAGE_H
+#define BP_COMPRESSEDIMAGE_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+
+namespace bp
+{
+
+/*
+ * Block compressed (BCn) 2D image with its mip levels, read from a DDS or KTX2 file. The blocks
+ * are kept as they are stored in the file, so they can be copied directly into an image of the
+ * same format.
+ */
+class CompressedImage
+{
+public:
+	struct Level
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t width, height;
+	};
+
+	CompressedImage() :
+		format{VK_FORMAT_UNDEFINED},
+		width{0},
+		height{0} {}
+	explicit CompressedImage(const std::string& path) :
+		CompressedImage{}
+	{
+		load(path);
+	}
+
+	void load(const std::string& path);
+
+	/*
+	 * Read only the header of a file and return the format of its blocks, or
+	 * VK_FORMAT_UNDEFINED if the file can not be read or is not a supported compressed image.
+	 */
+	static VkFormat queryFormat(const std::string& path);
+
+	/*
+	 * Check the extension of a path for a supported container format.
+	 */
+	static bool isCompressedImagePath(const std::string& path);
+
+	/*
+	 * Find a compressed image stored next to the image at the given path, with the same name
+	 * but a .ktx2 or .dds extension. Returns an empty string if there is none.
+	 */
+	static std::string findVariant(const std::string& path);
+
+	std::vector<VkBufferImageCopy> getCopyRegions() const;
+
+	VkFormat getFormat() const { return format; }
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+	uint32_t getMipLevels() const { return static_cast<uint32_t>(levels.size()); }
+	const Level& getLevel(uint32_t i) const { return levels[i]; }
+	const uint8_t* getData() const { return data.data(); }
+	VkDeviceSize getSize() const { return data.size(); }
+
+private:
+	VkFormat format;
+	uint32_t width, height;
+	std::vector<Level> levels;
+	std::vector<uint8_t> data;
+};
+
+}
+
+#endif
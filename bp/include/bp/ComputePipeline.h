@@ -25,6 +25,8 @@ public:
 		create();
 	}
 private:
+	friend class PipelineBuilder;
+
 	void create();
 };
 
@@ -13,11 +13,17 @@ public:
 	Descriptor() :
 		type{VK_DESCRIPTOR_TYPE_MAX_ENUM},
 		binding{0},
-		firstIndex{0} {}
+		firstIndex{0},
+		infoData{nullptr},
+		infoStride{0},
+		infoCount{0} {}
 	Descriptor(VkDescriptorType type, uint32_t binding, uint32_t firstIndex) :
 		type{type},
 		binding{binding},
-		firstIndex{firstIndex} {}
+		firstIndex{firstIndex},
+		infoData{nullptr},
+		infoStride{0},
+		infoCount{0} {}
 	virtual ~Descriptor() = default;
 
 	VkDescriptorType getType() const
@@ -47,10 +53,32 @@ public:
 
 	virtual VkWriteDescriptorSet getWriteInfo() const = 0;
 
+	/*
+	 * The descriptor infos as raw data, for updating descriptor sets with templates without
+	 * going through getWriteInfo.
+	 */
+	const void* getInfoData() const { return infoData; }
+	size_t getInfoStride() const { return infoStride; }
+	uint32_t getInfoCount() const { return infoCount; }
+
+protected:
+	/*
+	 * Must be called by subclasses whenever their descriptor infos are changed or moved.
+	 */
+	void setInfos(const void* data, size_t stride, uint32_t count)
+	{
+		infoData = data;
+		infoStride = stride;
+		infoCount = count;
+	}
+
 private:
 	VkDescriptorType type;
 	uint32_t binding;
 	uint32_t firstIndex;
+	const void* infoData;
+	size_t infoStride;
+	uint32_t infoCount;
 };
 
 }
@@ -0,0 +1,87 @@
+#ifndef BP_DESCRIPTORALLOCATOR_H
+#define BP_DESCRIPTORALLOCATOR_H
+
+#include "Device.h"
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+namespace bp
+{
+
+/*
+ * Allocates descriptor sets from chains of descriptor pools, adding a pool whenever the
+ * current one runs out, so that pool sizes need not be known up front. Each thread allocates
+ * from pools of its own, without locking once the thread has allocated from the allocator
+ * before. Sets are not freed individually. Instead there is a chain per frame in flight, and
+ * beginFrame resets the chains of a frame all at once. Allocators of long lived sets should
+ * have a single frame, and never begin a frame.
+ *
+ * setSizes gives the average number of descriptors of each type per set, which is scaled by
+ * setsPerPool to get the pool sizes.
+ */
+class DescriptorAllocator
+{
+public:
+	DescriptorAllocator() :
+		device{nullptr},
+		setsPerPool{0},
+		frameCount{0},
+		frameIndex{0},
+		id{0} {}
+	DescriptorAllocator(Device& device, uint32_t frameCount = 1, uint32_t setsPerPool = 64,
+			    const std::vector<VkDescriptorPoolSize>& setSizes = {}) :
+		DescriptorAllocator{}
+	{
+		init(device, frameCount, setsPerPool, setSizes);
+	}
+	~DescriptorAllocator();
+
+	void init(Device& device, uint32_t frameCount = 1, uint32_t setsPerPool = 64,
+		  const std::vector<VkDescriptorPoolSize>& setSizes = {});
+
+	/*
+	 * Reset the pools of frameIndex for all threads, freeing the sets allocated for that frame
+	 * the last time it was begun. Must not be called while other threads are allocating.
+	 */
+	void beginFrame(uint32_t frameIndex);
+	VkDescriptorSet allocate(VkDescriptorSetLayout layout);
+
+	uint32_t getFrameCount() const { return frameCount; }
+	uint32_t getFrameIndex() const { return frameIndex; }
+	uint32_t getSetsPerPool() const { return setsPerPool; }
+	size_t getPoolCount();
+	bool isReady() const { return device != nullptr; }
+
+private:
+	struct Chain
+	{
+		std::vector<VkDescriptorPool> pools;
+		size_t current;
+	};
+
+	struct ThreadPools
+	{
+		std::vector<Chain> frames;
+	};
+
+	Device* device;
+	uint32_t setsPerPool;
+	uint32_t frameCount;
+	uint32_t frameIndex;
+	uint64_t id;
+	std::vector<VkDescriptorPoolSize> poolSizes;
+
+	std::unordered_map<std::thread::id, std::unique_ptr<ThreadPools>> threadPools;
+	std::mutex threadPoolsMutex;
+
+	ThreadPools& getThreadPools();
+	VkDescriptorPool createPool();
+	void assertReady();
+};
+
+}
+
+#endif
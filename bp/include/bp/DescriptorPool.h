@@ -14,15 +14,19 @@ public:
 		device{VK_NULL_HANDLE},
 		handle{VK_NULL_HANDLE} {}
 	DescriptorPool(Device& device, const std::vector<VkDescriptorPoolSize>& poolSizes,
-		       uint32_t maxSets) :
+		       uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0) :
 		DescriptorPool()
 	{
-		init(device, poolSizes, maxSets);
+		init(device, poolSizes, maxSets, flags);
 	}
 	~DescriptorPool();
 
+	/*
+	 * Sets can always be freed individually. Sets of update after bind layouts need a pool
+	 * with VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT.
+	 */
 	void init(Device& device, const std::vector<VkDescriptorPoolSize>& poolSizes,
-		  uint32_t maxSets);
+		  uint32_t maxSets, VkDescriptorPoolCreateFlags flags = 0);
 
 	operator VkDescriptorPool() { return handle; }
 
@@ -3,6 +3,7 @@
 
 #include "Device.h"
 #include "DescriptorPool.h"
+#include "DescriptorAllocator.h"
 #include "DescriptorSetLayout.h"
 #include "Descriptor.h"
 #include <vector>
@@ -16,30 +17,113 @@ public:
 	DescriptorSet() :
 		device{nullptr},
 		pool{nullptr},
-		handle{VK_NULL_HANDLE} {}
+		layout{VK_NULL_HANDLE},
+		handle{VK_NULL_HANDLE},
+		updateTemplate{VK_NULL_HANDLE},
+		templateDataSize{0},
+		templatePipelineLayout{VK_NULL_HANDLE},
+		templateSet{0},
+		templateBindPoint{VK_PIPELINE_BIND_POINT_GRAPHICS} {}
 	DescriptorSet(Device& device, DescriptorPool& pool, DescriptorSetLayout& layout) :
 		DescriptorSet()
 	{
 		init(device, pool, layout);
 	}
+	DescriptorSet(Device& device, DescriptorAllocator& allocator, DescriptorSetLayout& layout) :
+		DescriptorSet()
+	{
+		init(device, allocator, layout);
+	}
+	DescriptorSet(Device& device, DescriptorSetLayout& layout,
+		      VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t set = 0,
+		      VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS) :
+		DescriptorSet()
+	{
+		init(device, layout, pipelineLayout, set, bindPoint);
+	}
 	~DescriptorSet();
 
 	void init(Device& device, DescriptorPool& pool,
 		  DescriptorSetLayout& layout);
+	/*
+	 * Allocate the set from a descriptor allocator. The set is not freed when destroyed, but
+	 * when the pools of the allocator are reset or destroyed.
+	 */
+	void init(Device& device, DescriptorAllocator& allocator, DescriptorSetLayout& layout);
+	/*
+	 * Set up a push descriptor set for a layout with push descriptors enabled. No set is
+	 * allocated. Instead the bound descriptors are pushed to the command buffer every time the
+	 * set is bound, which requires VK_KHR_push_descriptor to be enabled on the device.
+	 *
+	 * Push templates are made for a specific pipeline layout, set number and bind point. When
+	 * a pipeline layout is given and VK_KHR_descriptor_update_template is enabled, the template
+	 * is created here, and recreated when descriptors are bound or the set is updated.
+	 */
+	void init(Device& device, DescriptorSetLayout& layout,
+		  VkPipelineLayout pipelineLayout = VK_NULL_HANDLE, uint32_t set = 0,
+		  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 	void bind(const Descriptor& descriptor);
+
+	/*
+	 * Write the current infos of the bound descriptors to the set. When the device has
+	 * VK_KHR_descriptor_update_template enabled, an update template is created on the first
+	 * update and recreated only when descriptors are bound or change their type, binding or
+	 * number of infos. Updates then copy the infos into a packed blob and write it with a single
+	 * call. Push descriptor sets are not written, but their push template is recreated if the
+	 * descriptors no longer match it.
+	 */
 	void update();
+	/*
+	 * Write the current infos of one descriptor, e.g. an element of an array that is updated
+	 * after binding while the other bindings of the set are in use.
+	 */
+	void update(const Descriptor& descriptor);
+
+	/*
+	 * Bind the set to the command buffer, or push its descriptors if it is a push descriptor
+	 * set.
+	 */
+	void bind(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout, uint32_t set = 0,
+		  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+	/*
+	 * Push the current infos of the bound descriptors to the command buffer, with the push
+	 * template when it was made for the same pipeline layout, set and bind point and still
+	 * matches the descriptors. The set is only read, so several threads can push it while
+	 * recording, as long as no descriptors are bound and the set is not updated meanwhile.
+	 */
+	void push(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout, uint32_t set = 0,
+		  VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS);
 
 	operator VkDescriptorSet() { return handle; }
 
 	VkDescriptorSet getHandle() { return handle; }
 
-	bool isReady() const { return handle != VK_NULL_HANDLE; }
+	bool isPushSet() const { return isReady() && handle == VK_NULL_HANDLE; }
+	bool isReady() const { return device != nullptr; }
 
 private:
 	Device* device;
 	DescriptorPool* pool;
+	VkDescriptorSetLayout layout;
 	VkDescriptorSet handle;
 	std::vector<const Descriptor*> descriptors;
+
+	VkDescriptorUpdateTemplate updateTemplate;
+	std::vector<VkDescriptorUpdateTemplateEntry> templateEntries;
+	std::vector<const Descriptor*> templateDescriptors;
+	std::vector<uint8_t> templateData;
+	size_t templateDataSize;
+	VkPipelineLayout templatePipelineLayout;
+	uint32_t templateSet;
+	VkPipelineBindPoint templateBindPoint;
+
+	bool isTemplateValid() const;
+	void createUpdateTemplate();
+	void createPushTemplate();
+	void destroyUpdateTemplate();
+	void packTemplateData(uint8_t* data) const;
+	std::vector<VkWriteDescriptorSet> getWrites();
 };
 
 }
@@ -26,6 +26,13 @@ public:
 	~DescriptorSetLayout();
 
 	void addLayoutBinding(const VkDescriptorSetLayoutBinding& binding);
+	/*
+	 * Add a binding with VK_EXT_descriptor_indexing binding flags, e.g. a partially bound array
+	 * of textures. Layouts with bindings that can be updated after binding are created for
+	 * update after bind pools.
+	 */
+	void addLayoutBinding(const VkDescriptorSetLayoutBinding& binding,
+			      VkDescriptorBindingFlagsEXT flags);
 	void init(Device& device, VkDescriptorSetLayoutCreateFlags createFlags = 0);
 
 	operator VkDescriptorSetLayout() { return handle; }
@@ -39,6 +46,11 @@ public:
 		return static_cast<bool>(createFlags &
 					 VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR);
 	}
+	bool isUpdateAfterBindEnabled() const
+	{
+		return static_cast<bool>(createFlags &
+				VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT);
+	}
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
 
 private:
@@ -46,6 +58,7 @@ private:
 	VkDescriptorSetLayoutCreateFlags createFlags;
 	VkDescriptorSetLayout handle;
 	std::vector<VkDescriptorSetLayoutBinding> bindings;
+	std::vector<VkDescriptorBindingFlagsEXT> bindingFlags;
 };
 
 }
@@ -4,12 +4,23 @@
 #include "Instance.h"
 #include "Queue.h"
 #include "MemoryAllocator.h"
+#include "CommandPoolManager.h"
+#include "PipelineCache.h"
+#include "RetireQueue.h"
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <string>
+#include <mutex>
+#include <map>
+#include <functional>
 
 namespace bp
 {
 
+class UploadContext;
+class StagingRing;
+class ShaderCompiler;
+
 struct DeviceRequirements
 {
 	DeviceRequirements(VkQueueFlags queues, const VkPhysicalDeviceFeatures& features,
@@ -17,16 +28,51 @@ struct DeviceRequirements
 		queues{queues},
 		features{features},
 		surface{surface},
-		extensions{extensions} {}
+		extensions{extensions},
+		next{nullptr} {}
 	DeviceRequirements() :
 		queues{0},
 		features{},
-		surface{VK_NULL_HANDLE} {}
+		surface{VK_NULL_HANDLE},
+		next{nullptr} {}
 
 	VkQueueFlags queues;
 	VkPhysicalDeviceFeatures features;
 	VkSurfaceKHR surface;
 	std::vector<const char*> extensions;
+
+	/*
+	 * Chain of extension feature structs to enable, such as
+	 * VkPhysicalDeviceDescriptorIndexingFeaturesEXT.
+	 */
+	const void* next;
+};
+
+/*
+ * Entry points of device extensions, loaded when the device is created. Null if the extension
+ * is not enabled. Entry points of extensions missing from the Vulkan headers are left out.
+ */
+struct DeviceFunctions
+{
+	DeviceFunctions() :
+		createDescriptorUpdateTemplate{nullptr},
+		destroyDescriptorUpdateTemplate{nullptr},
+		updateDescriptorSetWithTemplate{nullptr},
+		cmdPushDescriptorSet{nullptr},
+		cmdPushDescriptorSetWithTemplate{nullptr}
+#ifdef VK_KHR_synchronization2
+		, cmdPipelineBarrier2{nullptr}
+#endif
+	{}
+
+	PFN_vkCreateDescriptorUpdateTemplateKHR createDescriptorUpdateTemplate;
+	PFN_vkDestroyDescriptorUpdateTemplateKHR destroyDescriptorUpdateTemplate;
+	PFN_vkUpdateDescriptorSetWithTemplateKHR updateDescriptorSetWithTemplate;
+	PFN_vkCmdPushDescriptorSetKHR cmdPushDescriptorSet;
+	PFN_vkCmdPushDescriptorSetWithTemplateKHR cmdPushDescriptorSetWithTemplate;
+#ifdef VK_KHR_synchronization2
+	PFN_vkCmdPipelineBarrier2KHR cmdPipelineBarrier2;
+#endif
 };
 
 bool queryDevice(VkPhysicalDevice device, const DeviceRequirements& requirements);
@@ -39,24 +85,42 @@ class Device
 {
 public:
 	Device() :
+		instance{VK_NULL_HANDLE},
+		instanceApiVersion{VK_MAKE_VERSION(1, 0, 0)},
 		physical{VK_NULL_HANDLE},
 		logical{VK_NULL_HANDLE},
 		properties{},
-		allocator{nullptr} {}
+		descriptorIndexingFeatures{},
+		allocator{nullptr},
+		cmdPoolManager{nullptr},
+		pipelineCache{nullptr},
+		uploadContext{nullptr},
+		stagingRing{nullptr},
+		stagingRingSize{64 * 1024 * 1024},
+		shaderCompiler{nullptr},
+		nextDestroyListener{0} {}
 	Device(const Instance& instance, const DeviceRequirements& requirements) :
 		Device()
 	{
 		init(instance, requirements);
 	}
-	Device(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements) :
+	Device(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements,
+	       VkInstance instance = VK_NULL_HANDLE,
+	       uint32_t instanceApiVersion = VK_MAKE_VERSION(1, 0, 0)) :
 		Device()
 	{
-		init(physicalDevice, requirements);
+		init(physicalDevice, requirements, instance, instanceApiVersion);
 	}
 	~Device();
 
 	void init(const Instance& instance, const DeviceRequirements& requirements);
-	void init(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements);
+	/*
+	 * The instance and the Vulkan version it was created for are used to query instance level
+	 * functions, such as the memory budget, which is estimated without them.
+	 */
+	void init(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements,
+		  VkInstance instance = VK_NULL_HANDLE,
+		  uint32_t instanceApiVersion = VK_MAKE_VERSION(1, 0, 0));
 
 	operator VkPhysicalDevice() { return physical; }
 	operator VkDevice() { return logical; }
@@ -64,8 +128,50 @@ public:
 	VkPhysicalDevice getPhysicalHandle() { return physical; }
 	VkDevice getLogicalHandle() { return logical; }
 	const VkPhysicalDeviceProperties& getProperties() const { return properties; }
+	const DeviceFunctions& getFunctions() const { return functions; }
+	/*
+	 * The descriptor indexing features enabled through DeviceRequirements::next, all false when
+	 * none were enabled.
+	 */
+	const VkPhysicalDeviceDescriptorIndexingFeaturesEXT& getDescriptorIndexingFeatures() const
+	{
+		return descriptorIndexingFeatures;
+	}
+	bool isExtensionEnabled(const std::string& name) const;
 	MemoryAllocator& getMemoryAllocator() { return *allocator; }
+	CommandPoolManager& getCommandPoolManager() { return *cmdPoolManager; }
+	PipelineCache& getPipelineCache() { return *pipelineCache; }
+	/*
+	 * Objects replaced while frames may still use them, such as the old handles of relocated
+	 * resources, are retired here. The frame loop sets the number of frames in flight and
+	 * begins each frame after waiting for its fence.
+	 */
+	RetireQueue& getRetireQueue() { return retireQueue; }
+	UploadContext& getUploadContext();
+	StagingRing& getStagingRing();
+	void setStagingRingSize(VkDeviceSize size);
+	ShaderCompiler& getShaderCompiler();
+
+	/*
+	 * Listeners are called with the handle of every shader module, render pass and pipeline
+	 * layout destroyed by the objects of this library, so that caches keyed on the handles can
+	 * drop their entries before the handles are reused. The returned id removes the listener.
+	 */
+	unsigned addDestroyListener(const std::function<void(uint64_t)>& listener);
+	void removeDestroyListener(unsigned id);
+	template <typename T>
+	void notifyDestroyed(T handle)
+	{
+		notifyDestroyed(reinterpret_cast<uint64_t>(handle));
+	}
+	void notifyDestroyed(uint64_t handle);
+
 	uint32_t getQueueCount() const { return static_cast<uint32_t>(queues.size()); }
+	/*
+	 * Pipeline stages that barriers recorded for a queue of the family may use. All stages
+	 * when the family is VK_QUEUE_FAMILY_IGNORED.
+	 */
+	VkPipelineStageFlags getSupportedStages(uint32_t queueFamilyIndex) const;
 	Queue& getQueue(uint32_t index = 0);
 	Queue& getGraphicsQueue();
 	Queue& getComputeQueue();
@@ -74,11 +180,30 @@ public:
 	bool isReady() const { return logical != VK_NULL_HANDLE; }
 
 private:
+	VkInstance instance;
+	uint32_t instanceApiVersion;
 	VkPhysicalDevice physical;
 	VkDevice logical;
 	VkPhysicalDeviceProperties properties;
+	std::vector<VkQueueFlags> queueFamilyFlags;
+	std::vector<std::string> extensions;
+	DeviceFunctions functions;
+	VkPhysicalDeviceDescriptorIndexingFeaturesEXT descriptorIndexingFeatures;
 
 	MemoryAllocator* allocator;
+	CommandPoolManager* cmdPoolManager;
+	PipelineCache* pipelineCache;
+	RetireQueue retireQueue;
+	UploadContext* uploadContext;
+	std::mutex uploadContextMutex;
+	StagingRing* stagingRing;
+	VkDeviceSize stagingRingSize;
+	std::mutex stagingRingMutex;
+	ShaderCompiler* shaderCompiler;
+	std::mutex shaderCompilerMutex;
+	std::map<unsigned, std::function<void(uint64_t)>> destroyListeners;
+	unsigned nextDestroyListener;
+	std::mutex destroyListenersMutex;
 
 	struct QueueInfo
 	{
@@ -90,6 +215,7 @@ private:
 
 	void createLogicalDevice(const DeviceRequirements& requirements);
 	void createQueues();
+	void loadFunctions();
 
 	std::vector<VkDeviceQueueCreateInfo>
 	setupQueueCreateInfos(const DeviceRequirements& requirements);
@@ -12,16 +12,17 @@ public:
 	Fence() :
 		device{VK_NULL_HANDLE},
 		handle{VK_NULL_HANDLE} {}
-	explicit Fence(VkDevice device) :
+	explicit Fence(VkDevice device, VkFenceCreateFlags flags = 0) :
 	Fence{}
 	{
-		init(device);
+		init(device, flags);
 	}
 	~Fence();
 
-	void init(VkDevice device);
+	void init(VkDevice device, VkFenceCreateFlags flags = 0);
 	void reset();
 	bool wait(uint64_t timeout = UINT64_MAX);
+	bool isSignaled();
 
 	operator VkFence() { return handle; }
 
@@ -0,0 +1,78 @@
+#ifndef BP_FRAMEARENA_H
+#define BP_FRAMEARENA_H
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Fence.h"
+#include <vector>
+#include <atomic>
+
+namespace bp
+{
+
+/*
+ * Linear allocator for transient per-frame data, such as uniforms and dynamic vertex data.
+ * Holds one host visible buffer per frame in flight. Allocations are made by bumping an offset
+ * into the buffer of the current frame, and are reset all at once when the frame is begun
+ * again. Allocating is lock free and may be done from multiple threads.
+ */
+class FrameArena
+{
+public:
+	struct Allocation
+	{
+		VkBuffer buffer;
+		VkDeviceSize offset;
+		uint8_t* mapped;
+	};
+
+	FrameArena() :
+		device{nullptr},
+		frameSize{0},
+		usage{0},
+		alignment{1},
+		frameIndex{0},
+		offset{0} {}
+	FrameArena(Device& device, VkDeviceSize frameSize, uint32_t frameCount,
+		   VkBufferUsageFlags usage) :
+		FrameArena{}
+	{
+		init(device, frameSize, frameCount, usage);
+	}
+
+	void init(Device& device, VkDeviceSize frameSize, uint32_t frameCount,
+		  VkBufferUsageFlags usage);
+
+	void beginFrame(uint32_t frameIndex, Fence* frameFence = nullptr);
+	Allocation allocate(VkDeviceSize size, VkDeviceSize alignment = 0);
+	template <typename T>
+	T* allocate(Allocation& allocation)
+	{
+		allocation = allocate(sizeof(T));
+		return reinterpret_cast<T*>(allocation.mapped);
+	}
+	void flush();
+
+	VkDeviceSize getFrameSize() const { return frameSize; }
+	VkBufferUsageFlags getUsage() const { return usage; }
+	uint32_t getFrameCount() const { return static_cast<uint32_t>(buffers.size()); }
+	uint32_t getFrameIndex() const { return frameIndex; }
+	VkDeviceSize getUsedSize() const { return offset; }
+	VkBuffer getBuffer(uint32_t frameIndex) { return buffers[frameIndex]; }
+	bool isReady() const { return device != nullptr; }
+
+private:
+	Device* device;
+	VkDeviceSize frameSize;
+	VkBufferUsageFlags usage;
+	VkDeviceSize alignment;
+	std::vector<Buffer> buffers;
+	uint32_t frameIndex;
+	std::atomic<VkDeviceSize> offset;
+
+	void assertReady();
+};
+
+}
+
+#endif
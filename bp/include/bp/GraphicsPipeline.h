@@ -12,6 +12,7 @@ public:
 	GraphicsPipeline() :
 		Pipeline{},
 		renderPass{nullptr},
+		subpass{0},
 		primitiveTopology{VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST},
 		polygonMode{VK_POLYGON_MODE_FILL},
 		cullMode{VK_CULL_MODE_BACK_BIT},
@@ -67,6 +68,14 @@ public:
 		depthEnabled = enabled;
 	}
 
+	/*
+	 * Index of the subpass of the render pass that the pipeline is used in.
+	 */
+	void setSubpass(uint32_t subpass)
+	{
+		GraphicsPipeline::subpass = subpass;
+	}
+
 	VkPrimitiveTopology getPrimitiveTopology() const
 	{
 		return primitiveTopology;
@@ -87,9 +96,17 @@ public:
 	{
 		return depthEnabled;
 	}
+	uint32_t getSubpass() const
+	{
+		return subpass;
+	}
 
 private:
+	friend class PipelineBuilder;
+	friend class PipelineRegistry;
+
 	RenderPass* renderPass;
+	uint32_t subpass;
 	std::vector<VkVertexInputBindingDescription> vertexBindingDescriptions;
 	std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions;
 	VkPrimitiveTopology primitiveTopology;
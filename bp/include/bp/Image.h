@@ -2,7 +2,9 @@
 #define BP_IMAGE_H
 
 #include "Device.h"
-#include "CommandPool.h"
+#include "BarrierBatch.h"
+#include <vector>
+#include <utility>
 
 namespace bp
 {
@@ -16,24 +18,52 @@ public:
 		device{nullptr},
 		handle{VK_NULL_HANDLE},
 		width{0}, height{0},
+		mipLevels{1},
 		format{VK_FORMAT_UNDEFINED},
 		tiling{VK_IMAGE_TILING_LINEAR},
 		usage{0},
-		accessFlags{0},
 		memory{VK_NULL_HANDLE},
+		memorySize{0},
 		stagingBuffer{nullptr} {}
 	Image(Device& device, uint32_t width, uint32_t height, VkFormat format,
 	      VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
-	      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED) :
+	      VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1,
+	      MemoryPool memoryPool = MemoryPool::DEFAULT) :
 		Image()
 	{
-		init(device, width, height, format, tiling, usage, memoryUsage, initialLayout);
+		init(device, width, height, format, tiling, usage, memoryUsage, initialLayout,
+		     mipLevels, memoryPool);
 	}
 	~Image();
 
 	void init(Device& device, uint32_t width, uint32_t height, VkFormat format,
 		  VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
-		  VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED);
+		  VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1,
+		  MemoryPool memoryPool = MemoryPool::DEFAULT);
+	/*
+	 * Bind the image to memory at an offset instead of allocating its own memory, e.g. to alias
+	 * it with other resources that are never used at the same time. The memory must fit the
+	 * requirements given by getMemoryRequirements for the same parameters, must not be mapped,
+	 * and must outlive the image. Such images are not relocated by defragmentation.
+	 */
+	void init(Device& device, uint32_t width, uint32_t height, VkFormat format,
+		  VkImageTiling tiling, VkImageUsageFlags usage,
+		  const std::shared_ptr<Allocation>& memory, VkDeviceSize offset,
+		  VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED, uint32_t mipLevels = 1);
+
+	static VkMemoryRequirements getMemoryRequirements(Device& device, uint32_t width,
+							  uint32_t height, VkFormat format,
+							  VkImageTiling tiling,
+							  VkImageUsageFlags usage,
+							  uint32_t mipLevels = 1);
+
+	/*
+	 * Let defragmentation move the image, which must have memory of its own and not be
+	 * transient. Its mip levels are copied to the new image by the device, and end up in the
+	 * layouts they were in, except that undefined and preinitialized levels end up as transfer
+	 * destinations. The old handle is retired to the device, and relocateEvent is triggered.
+	 */
+	void enableRelocation();
 
 	uint8_t* map();
 	void createStagingBuffer();
@@ -41,39 +71,129 @@ public:
 	void updateStagingBuffer(VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
 	void flushStagingBuffer(VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
 
+	/*
+	 * Transition the mip levels not already in dstLayout. The layout, access and stage of each
+	 * level is tracked, so the source stage of a barrier is the stage given when the level was
+	 * last transitioned. That stage must therefore cover every use of the image until the next
+	 * transition. Stages the queue of cmdBuffer does not support are left out of the barrier.
+	 */
 	void transition(VkImageLayout dstLayout, VkAccessFlags dstAccess,
 			VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
+	/*
+	 * Add the barriers of the transition to a batch instead of recording them. The tracked state
+	 * is updated right away, so the batch must be recorded before the image is used.
+	 */
+	void transition(VkImageLayout dstLayout, VkAccessFlags dstAccess,
+			VkPipelineStageFlags dstStage, BarrierBatch& batch);
+
+	/*
+	 * Record a barrier for a range of mip levels with explicit layouts, leaving the other levels
+	 * untouched. The tracked state of the levels in the range is updated.
+	 */
+	void transitionMipLevels(uint32_t baseMipLevel, uint32_t levelCount,
+				 VkImageLayout srcLayout, VkImageLayout dstLayout,
+				 VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+				 VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+				 VkCommandBuffer cmdBuffer,
+				 uint32_t srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+				 uint32_t dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED);
+
+	/*
+	 * Queue family ownership transfer of an exclusive image. The release is recorded on the
+	 * source queue and the acquire on the destination queue, which must wait for the release
+	 * with a semaphore. Both must be given the same layout, as the layout transition is part of
+	 * the transfer. The tracked layout is updated by the acquire.
+	 */
+	void releaseOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkImageLayout dstLayout, VkCommandBuffer cmdBuffer);
+	void acquireOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkImageLayout dstLayout, VkAccessFlags dstAccess,
+			      VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer);
+
+	/*
+	 * Generate all mip levels below the first one by repeatedly blitting each level into the
+	 * next. Must be recorded on a queue with graphics support. All levels end up in dstLayout.
+	 */
+	void generateMipmaps(VkImageLayout dstLayout, VkAccessFlags dstAccess,
+			     VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
+
 	void transfer(Image& fromImage, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
 	void transfer(Buffer& src, VkCommandBuffer cmdBuffer = VK_NULL_HANDLE);
+	void transfer(Buffer& src, VkDeviceSize srcOffset, VkCommandBuffer cmdBuffer);
+	void transfer(Buffer& src, VkDeviceSize srcOffset,
+		      const std::vector<VkBufferImageCopy>& regions, VkCommandBuffer cmdBuffer);
 
 	operator VkImage() { return handle; }
 
 	VkImage getHandle() { return handle; }
 	uint32_t getWidth() const { return width; }
 	uint32_t getHeight() const { return height; }
+	uint32_t getMipLevels() const { return mipLevels; }
 	VkFormat getFormat() const { return format; }
 	VkImageTiling getTiling() const { return tiling; }
 	VkImageUsageFlags getUsage() const { return usage; }
-	VkImageLayout getLayout() const { return layout; }
-	VkDeviceSize getMemorySize() const { return memory->getSize(); }
+	VkImageLayout getLayout(uint32_t mipLevel = 0) const
+	{
+		return mipLevel < levelStates.size() ? levelStates[mipLevel].layout
+						     : VK_IMAGE_LAYOUT_UNDEFINED;
+	}
+	VkDeviceSize getMemorySize() const { return memorySize; }
 	Buffer* getStagingBuffer() { return stagingBuffer; }
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
+
+	/*
+	 * Triggered when the image has been recreated after its memory was moved by
+	 * defragmentation. Image views of the old handle must be recreated, and descriptors
+	 * referring to them updated.
+	 */
+	bpUtil::Event<> relocateEvent;
+
 private:
 	friend class Buffer;
 
 	Device* device;
 	VkImage handle;
-	CommandPool transferCmdPool, graphicsCmdPool;
 	uint32_t width, height;
+	uint32_t mipLevels;
 	VkFormat format;
 	VkImageTiling tiling;
 	VkImageUsageFlags usage;
-	VkImageLayout layout;
-	VkAccessFlags accessFlags;
+
+	struct LevelState
+	{
+		VkImageLayout layout;
+		VkAccessFlags access;
+		VkPipelineStageFlags stage;
+
+		bool operator==(const LevelState& other) const
+		{
+			return layout == other.layout && access == other.access
+			       && stage == other.stage;
+		}
+	};
+	std::vector<LevelState> levelStates;
 
 	std::shared_ptr<Memory> memory;
+	VkDeviceSize memorySize;
 	Buffer* stagingBuffer;
 
+	VkImageMemoryBarrier createBarrier(uint32_t baseMipLevel, uint32_t levelCount,
+					   VkImageLayout srcLayout, VkImageLayout dstLayout,
+					   VkAccessFlags srcAccess, VkAccessFlags dstAccess);
+	VkImageMemoryBarrier createBarrier(uint32_t baseMipLevel, uint32_t levelCount,
+					   VkImageLayout dstLayout, VkAccessFlags dstAccess);
+	std::vector<std::pair<uint32_t, uint32_t>> getLevelRuns() const;
+	void setLevelStates(uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout layout,
+			    VkAccessFlags access, VkPipelineStageFlags stage);
+	void setup(Device& device, uint32_t width, uint32_t height, VkFormat format,
+		   VkImageTiling tiling, VkImageUsageFlags usage, VkImageLayout initialLayout,
+		   uint32_t mipLevels);
+	VkImageCreateInfo createInfo(VkImageLayout initialLayout);
+	static VkImageUsageFlags getImageUsage(VkImageUsageFlags usage);
+	static VkImageCreateInfo createInfo(uint32_t width, uint32_t height, VkFormat format,
+					    VkImageTiling tiling, VkImageUsageFlags usage,
+					    VkImageLayout initialLayout, uint32_t mipLevels);
+	void relocate(VkCommandBuffer cmdBuffer, const std::shared_ptr<Allocation>& oldMemory);
 	void assertReady();
 };
 
@@ -15,14 +15,35 @@ public:
 	ImageDescriptor(VkDescriptorType type, uint32_t binding, uint32_t firstIndex,
 			const std::vector<VkDescriptorImageInfo>& infos) :
 		Descriptor{type, binding, firstIndex},
-		descriptorInfos{infos} {}
+		descriptorInfos{infos}
+	{
+		updateInfos();
+	}
+	ImageDescriptor(const ImageDescriptor& other) :
+		Descriptor{other},
+		descriptorInfos{other.descriptorInfos}
+	{
+		updateInfos();
+	}
+	ImageDescriptor& operator=(const ImageDescriptor& other)
+	{
+		Descriptor::operator=(other);
+		descriptorInfos = other.descriptorInfos;
+		updateInfos();
+		return *this;
+	}
 	virtual ~ImageDescriptor() = default;
 
-	void resetDescriptorInfos() { descriptorInfos.clear(); }
+	void resetDescriptorInfos()
+	{
+		descriptorInfos.clear();
+		updateInfos();
+	}
 
 	void addDescriptorInfo(const VkDescriptorImageInfo& info)
 	{
 		descriptorInfos.push_back(info);
+		updateInfos();
 	}
 
 	const std::vector<VkDescriptorImageInfo>& getDescriptorInfos() const
@@ -44,6 +65,12 @@ public:
 
 private:
 	std::vector<VkDescriptorImageInfo> descriptorInfos;
+
+	void updateInfos()
+	{
+		setInfos(descriptorInfos.data(), sizeof(VkDescriptorImageInfo),
+			 static_cast<uint32_t>(descriptorInfos.size()));
+	}
 };
 
 }
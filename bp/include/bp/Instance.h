@@ -19,6 +19,7 @@ class Instance
 public:
 	Instance() :
 		handle{VK_NULL_HANDLE},
+		apiVersion{VK_MAKE_VERSION(1, 0, 0)},
 		debugReportCallback{VK_NULL_HANDLE} {}
 	Instance(bool enableDebug, std::initializer_list<std::string> enabledExtensions,
 		const VkApplicationInfo* applicationInfo = nullptr) :
@@ -48,7 +49,11 @@ public:
 
 	operator VkInstance() { return handle; }
 
-	VkInstance getHandle() { return handle; }
+	VkInstance getHandle() const { return handle; }
+	/*
+	 * The Vulkan version the instance was created for, given by the application info.
+	 */
+	uint32_t getApiVersion() const { return apiVersion; }
 	std::vector<VkPhysicalDevice>& getPhysicalDevices() { return physicalDevices; }
 	const std::vector<VkPhysicalDevice>& getPhysicalDevices() const { return physicalDevices; }
 	const std::vector<std::string>& getEnabledExtensions() const { return enabledExtensions; }
@@ -64,6 +69,7 @@ public:
 	bpUtil::Event<const std::string&> errorEvent;
 private:
 	VkInstance handle;
+	uint32_t apiVersion;
 	std::vector<VkPhysicalDevice> physicalDevices;
 	VkDebugReportCallbackEXT debugReportCallback;
 
@@ -3,25 +3,40 @@
 
 #include <vulkan/vulkan.h>
 #include <vk_mem_alloc.h>
+#include <bpUtil/Event.h>
 #include <memory>
+#include <vector>
+#include <string>
+#include <functional>
+#include <unordered_set>
+#include <mutex>
+#include <map>
 #include "Memory.h"
 
 namespace bp
 {
 
+class MemoryAllocator;
+
 class Allocation : public Memory
 {
 public:
 	Allocation() :
 		device{VK_NULL_HANDLE},
 		allocator{VK_NULL_HANDLE},
-		handle{VK_NULL_HANDLE} {}
+		handle{VK_NULL_HANDLE},
+		createInfo{},
+		requirements{},
+		owner{nullptr} {}
 	Allocation(VkDevice device, VmaAllocator allocator, VmaAllocation handle,
 		   VmaAllocationInfo& info) :
 		device{device},
 		allocator{allocator},
 		handle{handle},
-		info{info}
+		info{info},
+		createInfo{},
+		requirements{},
+		owner{nullptr}
 	{
 		VkMemoryPropertyFlags memFlags;
 		vmaGetMemoryTypeProperties(allocator, info.memoryType, &memFlags);
@@ -36,12 +51,92 @@ public:
 	void* getMapped() override { return info.pMappedData; }
 	void flushMapped() override;
 
+	/*
+	 * Let the owning allocator move this allocation when defragmenting. The handler is called
+	 * after the allocation has been given new memory, with the command buffer given to
+	 * defragment and the old memory. It must create the resource anew, bind it at the new
+	 * place, record a copy from the old resource and retire the old resource along with the old
+	 * memory. Mapped pointers obtained before the move are invalidated. Only allocations made
+	 * for a single resource by createBuffer or createImage can be moved.
+	 */
+	void setRelocationHandler(
+		const std::function<void(VkCommandBuffer, const std::shared_ptr<Allocation>&)>&
+		handler);
+	bool isRelocatable() const { return owner != nullptr; }
+
+	VkDeviceMemory getDeviceMemory() const { return info.deviceMemory; }
+	VkDeviceSize getOffset() const { return info.offset; }
+	uint32_t getMemoryType() const { return info.memoryType; }
+
 private:
+	friend class MemoryAllocator;
+
 	VkDevice device;
 	VmaAllocator allocator;
 	VmaAllocation handle;
 	VmaAllocationInfo info;
+	VmaAllocationCreateInfo createInfo;
+	VkMemoryRequirements requirements;
 	bool coherent;
+
+	MemoryAllocator* owner;
+	std::function<void(VkCommandBuffer, const std::shared_ptr<Allocation>&)> relocationHandler;
+};
+
+/*
+ * Usage of a memory heap. budget and usage come from VK_EXT_memory_budget when it is enabled, and
+ * include memory allocated by other processes and outside of the allocator. Without the
+ * extension, budget is estimated as 80% of the heap size and usage is the memory allocated by
+ * this allocator. The remaining members are statistics of the allocator itself. fragmentation is
+ * 0 when all unused memory in the blocks is one contiguous range, and approaches 1 as it gets
+ * split up.
+ */
+struct MemoryHeapBudget
+{
+	VkDeviceSize size;
+	VkDeviceSize budget;
+	VkDeviceSize usage;
+	uint32_t blockCount;
+	uint32_t allocationCount;
+	VkDeviceSize blockBytes;
+	VkDeviceSize allocationBytes;
+	VkDeviceSize unusedBytes;
+	VkDeviceSize unusedRangeSizeMax;
+	float fragmentation;
+};
+
+/*
+ * Pools that resources are allocated from, so that resources with different lifetimes do not
+ * share memory blocks. Attachments are resized with their framebuffers, static geometry lives
+ * as long as its model, frame data is reallocated every frame, and streaming textures come and
+ * go as they are streamed in.
+ */
+enum class MemoryPool
+{
+	DEFAULT,
+	ATTACHMENT,
+	STATIC_GEOMETRY,
+	FRAME,
+	STREAMING
+};
+
+/*
+ * blockSize and maxBlockCount may be 0 for the default block size and no block limit. Dedicated
+ * pools give each resource its own device memory allocation. Resources larger than half a block
+ * are allocated outside of the pool, as blocks of a pool never grow.
+ */
+struct MemoryPoolSettings
+{
+	VkDeviceSize blockSize;
+	size_t maxBlockCount;
+	bool dedicated;
+};
+
+struct DefragmentationStats
+{
+	VkDeviceSize bytesMoved;
+	uint32_t allocationsMoved;
+	bool complete;
 };
 
 class MemoryAllocator
@@ -50,26 +145,117 @@ public:
 	MemoryAllocator() :
 		physicalDevice{VK_NULL_HANDLE},
 		logicalDevice{VK_NULL_HANDLE},
-		handle{VK_NULL_HANDLE} {}
-	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice logicalDevice) :
+		handle{VK_NULL_HANDLE},
+		getMemoryProperties2{nullptr} {}
+	MemoryAllocator(VkPhysicalDevice physicalDevice, VkDevice logicalDevice,
+			bool memoryBudget = false, VkInstance instance = VK_NULL_HANDLE,
+			uint32_t instanceApiVersion = VK_MAKE_VERSION(1, 0, 0)) :
 		MemoryAllocator{}
 	{
-		init(physicalDevice, logicalDevice);
+		init(physicalDevice, logicalDevice, memoryBudget, instance, instanceApiVersion);
 	}
 	~MemoryAllocator();
 
-	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice);
+	/*
+	 * memoryBudget should be true when VK_EXT_memory_budget is enabled on the device. The budget
+	 * is queried with a function of the instance, which is the core one when the instance was
+	 * created with an instanceApiVersion of at least Vulkan 1.1 and the physical device supports
+	 * it, and the one of VK_KHR_get_physical_device_properties2 otherwise. Without an instance,
+	 * the budget is estimated.
+	 */
+	void init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice,
+		  bool memoryBudget = false, VkInstance instance = VK_NULL_HANDLE,
+		  uint32_t instanceApiVersion = VK_MAKE_VERSION(1, 0, 0));
 	std::shared_ptr<Allocation> createBuffer(const VkBufferCreateInfo& bufferInfo, VmaMemoryUsage usage,
-						 VkBuffer& buffer);
-	std::shared_ptr<Allocation> createImage(const VkImageCreateInfo& bufferInfo, VmaMemoryUsage usage,
-						VkImage& image);
+						 VkBuffer& buffer,
+						 MemoryPool pool = MemoryPool::DEFAULT);
+	std::shared_ptr<Allocation> createImage(const VkImageCreateInfo& imageInfo, VmaMemoryUsage usage,
+						VkImage& image, MemoryPool pool = MemoryPool::DEFAULT);
+
+	/*
+	 * Allocate memory without a resource, for resources that are bound to it by the caller,
+	 * such as several resources sharing the same memory. preferredFlags are preferred on top of
+	 * the usage, e.g. lazily allocated memory for transient attachments.
+	 */
+	std::shared_ptr<Allocation> allocateMemory(const VkMemoryRequirements& requirements,
+						   VmaMemoryUsage usage,
+						   MemoryPool pool = MemoryPool::DEFAULT,
+						   VkMemoryPropertyFlags preferredFlags = 0);
+
+	/*
+	 * Settings of a pool must be changed before anything is allocated from it.
+	 */
+	void setPoolSettings(MemoryPool pool, const MemoryPoolSettings& settings);
+	MemoryPoolSettings getPoolSettings(MemoryPool pool);
+
+	/*
+	 * Compact memory by moving allocations with a relocation handler out of the blocks holding
+	 * the fewest relocatable bytes and into free space of fuller blocks of the same memory type
+	 * and pool, until maxBytes or maxAllocations have been moved. No memory is allocated, and
+	 * blocks are freed once everything in them has moved and the old memory is retired.
+	 *
+	 * The contents are copied by the device, with commands recorded to cmdBuffer by the
+	 * relocation handlers between barriers recorded here. It is meant to be called once per
+	 * frame, with a command buffer of the frame before anything using the resources is
+	 * recorded to it. The old resources and memory are retired to the device, so the frame of
+	 * the retire queue must have begun. Exclusive resources must be owned by the queue family
+	 * of cmdBuffer. The handlers are called without the allocator locked, and relocatable
+	 * resources must not be destroyed while defragmenting.
+	 */
+	DefragmentationStats defragment(VkCommandBuffer cmdBuffer,
+					VkDeviceSize maxBytes = VK_WHOLE_SIZE,
+					uint32_t maxAllocations = 16);
+
+	std::vector<MemoryHeapBudget> getHeapBudgets();
+	VmaStats calculateStats();
+
+	/*
+	 * Dump the state of the allocator as JSON, for offline analysis. The detailed map lists
+	 * every allocation and free range of every block.
+	 */
+	std::string buildStatsString(bool detailedMap = false);
 
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
 
+	/*
+	 * Triggered with the heap index and size when a block of device memory is allocated or
+	 * freed. Handlers are called from the allocating thread while the allocator is locked, so
+	 * they must not use the allocator. They are meant for bookkeeping, such as flagging that
+	 * the budget should be checked.
+	 */
+	bpUtil::Event<uint32_t, VkDeviceSize> blockAllocateEvent;
+	bpUtil::Event<uint32_t, VkDeviceSize> blockFreeEvent;
+
 private:
+	friend class Allocation;
+
 	VkPhysicalDevice physicalDevice;
 	VkDevice logicalDevice;
 	VmaAllocator handle;
+	PFN_vkVoidFunction getMemoryProperties2;
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+
+	MemoryPoolSettings poolSettings[5];
+	std::map<std::pair<MemoryPool, uint32_t>, VmaPool> pools;
+	std::mutex poolMutex;
+
+	std::unordered_set<Allocation*> relocatable;
+	std::mutex relocatableMutex;
+
+	VmaAllocationCreateInfo createAllocationInfo(VmaMemoryUsage usage, MemoryPool pool,
+						     const VkMemoryRequirements& requirements,
+						     VkImageUsageFlags imageUsage = 0,
+						     VkMemoryPropertyFlags preferredFlags = 0);
+	VkDeviceSize getBlockSize(const MemoryPoolSettings& settings, uint32_t memoryTypeIndex);
+	VmaPool getPool(MemoryPool pool, uint32_t memoryTypeIndex);
+	void addRelocatable(Allocation* allocation);
+	void removeRelocatable(Allocation* allocation);
+
+	static void VKAPI_PTR onBlockAllocate(VmaAllocator allocator, uint32_t memoryType,
+					      VkDeviceMemory memory, VkDeviceSize size);
+	static void VKAPI_PTR onBlockFree(VmaAllocator allocator, uint32_t memoryType,
+					  VkDeviceMemory memory, VkDeviceSize size);
+	void assertReady();
 };
 
 }
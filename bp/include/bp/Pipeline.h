@@ -4,7 +4,9 @@
 #include "Device.h"
 #include "Shader.h"
 #include "RenderPass.h"
+#include "SpecializationConstants.h"
 #include <vector>
+#include <map>
 #include <initializer_list>
 
 namespace bp
@@ -34,6 +36,15 @@ public:
 		shaderStageInfos.insert(shaderStageInfos.end(), begin, end);
 	}
 
+	/*
+	 * Override the specialization constants of the shader of the given stage.
+	 */
+	void setSpecializationConstants(VkShaderStageFlagBits stage,
+					const SpecializationConstants& constants)
+	{
+		specializations[stage] = constants;
+	}
+
 	operator VkPipeline() { return handle; }
 
 	bool isReady() const { return handle != VK_NULL_HANDLE; }
@@ -46,6 +57,22 @@ protected:
 	VkPipeline handle;
 	VkPipelineLayout layout;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStageInfos;
+	std::map<VkShaderStageFlagBits, SpecializationConstants> specializations;
+
+	/*
+	 * The shader stage infos with the specialization constants of the pipeline applied.
+	 */
+	std::vector<VkPipelineShaderStageCreateInfo> getShaderStageInfos()
+	{
+		std::vector<VkPipelineShaderStageCreateInfo> infos = shaderStageInfos;
+		for (auto& info : infos)
+		{
+			auto found = specializations.find(info.stage);
+			if (found != specializations.end())
+				info.pSpecializationInfo = found->second.getInfo();
+		}
+		return infos;
+	}
 };
 
 }
@@ -0,0 +1,53 @@
+#ifndef BP_PIPELINEBUILDER_H
+#define BP_PIPELINEBUILDER_H
+
+#include "GraphicsPipeline.h"
+#include "ComputePipeline.h"
+#include <vector>
+
+namespace bp
+{
+
+/*
+ * Creates many pipelines at once. Pipelines are configured as usual, but instead of being
+ * initialized one by one they are added to the builder, and build creates them all, spread
+ * over a number of worker threads. Vulkan allows pipelines to be created concurrently, and
+ * each worker creates its pipelines with a pipeline cache of its own.
+ */
+class PipelineBuilder
+{
+public:
+	PipelineBuilder() :
+		device{nullptr} {}
+	PipelineBuilder(Device& device) :
+		PipelineBuilder{}
+	{
+		init(device);
+	}
+
+	void init(Device& device);
+
+	void add(GraphicsPipeline& pipeline, RenderPass& renderPass, VkPipelineLayout layout);
+	void add(ComputePipeline& pipeline, VkPipelineLayout layout);
+
+	/*
+	 * Create all added pipelines and clear the builder. A worker count of 0 uses one worker
+	 * per hardware thread. If any pipeline fails, the others are still created before the
+	 * first error is thrown, and the failed pipelines are left uninitialized.
+	 */
+	void build(unsigned workerCount = 0);
+
+	size_t getPendingCount() const { return graphicsPipelines.size() + computePipelines.size(); }
+	bool isReady() const { return device != nullptr; }
+
+private:
+	Device* device;
+	std::vector<GraphicsPipeline*> graphicsPipelines;
+	std::vector<ComputePipeline*> computePipelines;
+
+	void assertReady();
+};
+
+}
+
+#endif
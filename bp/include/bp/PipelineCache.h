@@ -0,0 +1,94 @@
+#ifndef BP_PIPELINECACHE_H
+#define BP_PIPELINECACHE_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <memory>
+
+namespace bp
+{
+
+/*
+ * Pipeline cache of a device, which pipelines are created with. Each thread creating pipelines
+ * gets a cache of its own, seeded from the shared cache, and the thread caches are merged back
+ * into the shared cache when it is saved. The caches of threads that have exited are destroyed
+ * after merging them. Saved caches are tagged with the vendor, device,
+ * driver version and pipeline cache UUID of the physical device, and files written for another
+ * device or driver are ignored when loading.
+ */
+class PipelineCache
+{
+public:
+	PipelineCache() :
+		physical{VK_NULL_HANDLE},
+		device{VK_NULL_HANDLE},
+		handle{VK_NULL_HANDLE} {}
+	PipelineCache(VkPhysicalDevice physical, VkDevice device) :
+		PipelineCache{}
+	{
+		init(physical, device);
+	}
+	~PipelineCache();
+
+	void init(VkPhysicalDevice physical, VkDevice device);
+
+	/*
+	 * Load the cache from the file at path if it exists and is valid for the device, and save
+	 * it there when the cache is destroyed.
+	 */
+	void setFile(const std::string& path);
+
+	/*
+	 * Merge cache data from a file into the cache. Returns false if the file could not be read
+	 * or was written for another device or driver.
+	 */
+	bool load(const std::string& path);
+	void save(const std::string& path);
+	void save();
+
+	/*
+	 * Cache to create pipelines with on the calling thread.
+	 */
+	VkPipelineCache getHandle();
+
+	/*
+	 * Merge the cache of the calling thread into the shared cache and destroy it. Should be
+	 * called by short lived threads that have created pipelines, before they exit.
+	 */
+	void releaseThreadCache();
+
+	const std::string& getFile() const { return file; }
+	bool isReady() const { return handle != VK_NULL_HANDLE; }
+
+private:
+	VkPhysicalDevice physical;
+	VkDevice device;
+	VkPipelineCache handle;
+	VkPhysicalDeviceProperties properties;
+	std::string file;
+
+	/*
+	 * The thread pointer expires when the thread that created the cache exits.
+	 */
+	struct ThreadCache
+	{
+		VkPipelineCache cache;
+		std::weak_ptr<int> thread;
+	};
+
+	std::unordered_map<std::thread::id, ThreadCache> threadCaches;
+	std::mutex cacheMutex;
+
+	VkPipelineCache createCache(const void* data, size_t size);
+	std::vector<uint8_t> getData(VkPipelineCache cache);
+	void mergeThreadCaches();
+	void assertReady();
+};
+
+}
+
+#endif
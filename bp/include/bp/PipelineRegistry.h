@@ -0,0 +1,79 @@
+#ifndef BP_PIPELINEREGISTRY_H
+#define BP_PIPELINEREGISTRY_H
+
+#include "GraphicsPipeline.h"
+#include <unordered_map>
+#include <string>
+#include <memory>
+#include <vector>
+#include <mutex>
+
+namespace bp
+{
+
+/*
+ * Shares graphics pipelines with the same state. A pipeline is described by configuring an
+ * uninitialized GraphicsPipeline, and get returns a registered pipeline with the same shader
+ * stages, specialization constants, vertex input, rasterization and depth state, render pass
+ * and layout, creating it only if there is none. Drawables using the returned pipelines are
+ * grouped by DrawableSubpass, so sharing pipelines also saves pipeline binds when rendering.
+ *
+ * Pipelines are looked up by the handles of their render pass, layout and shader modules. When
+ * one of these is destroyed, the pipelines using it are no longer returned by get, as the
+ * handle may be reused, but they are kept alive until the registry is cleared or destroyed.
+ */
+class PipelineRegistry
+{
+public:
+	PipelineRegistry() :
+		device{nullptr},
+		destroyListener{0},
+		hitCount{0},
+		missCount{0} {}
+	PipelineRegistry(Device& device) :
+		PipelineRegistry{}
+	{
+		init(device);
+	}
+	~PipelineRegistry();
+
+	void init(Device& device);
+
+	GraphicsPipeline& get(const GraphicsPipeline& description, RenderPass& renderPass,
+			      VkPipelineLayout layout);
+
+	/*
+	 * Destroy all registered and evicted pipelines, which must no longer be in use, and reset
+	 * the statistics.
+	 */
+	void clear();
+
+	size_t getHitCount() const { return hitCount; }
+	size_t getMissCount() const { return missCount; }
+	size_t getPipelineCount() const { return pipelines.size(); }
+	bool isReady() const { return device != nullptr; }
+
+private:
+	struct Entry
+	{
+		std::unique_ptr<GraphicsPipeline> pipeline;
+		std::vector<uint64_t> handles;
+	};
+
+	Device* device;
+	unsigned destroyListener;
+	std::unordered_map<std::string, Entry> pipelines;
+	std::vector<std::unique_ptr<GraphicsPipeline>> evicted;
+	std::mutex pipelinesMutex;
+	size_t hitCount;
+	size_t missCount;
+
+	std::string createKey(const GraphicsPipeline& description, RenderPass& renderPass,
+			      VkPipelineLayout layout);
+	void evict(uint64_t handle);
+	void assertReady();
+};
+
+}
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
+#include <memory>
+#include <mutex>
 
 namespace bp
 {
@@ -16,6 +18,7 @@ public:
 		const std::vector<std::pair<VkSemaphore, VkPipelineStageFlags>>& waitSemaphores,
 		const std::vector<VkCommandBuffer>& cmdBuffers,
 		const std::vector<VkSemaphore>& signalSemaphores, VkFence fence = VK_NULL_HANDLE);
+	VkResult present(const VkPresentInfoKHR& presentInfo);
 	void waitIdle();
 
 	operator VkQueue() { return handle; }
@@ -29,6 +32,7 @@ private:
 	uint32_t queueFamilyIndex;
 	uint32_t queueIndex;
 	VkQueue handle;
+	std::unique_ptr<std::mutex> submitMutex;
 };
 
 }
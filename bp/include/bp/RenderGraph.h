@@ -0,0 +1,286 @@
+#ifndef BP_RENDERGRAPH_H
+#define BP_RENDERGRAPH_H
+
+#include "Device.h"
+#include "Subpass.h"
+#include "RenderPass.h"
+#include "Framebuffer.h"
+#include "Texture.h"
+#include "Buffer.h"
+#include "BarrierBatch.h"
+#include <vector>
+#include <memory>
+#include <functional>
+
+namespace bp
+{
+
+/*
+ * Graph of passes declaring the images and buffers they read and write. On initialization the
+ * passes are ordered, graphics passes that only depend on each other through attachments are
+ * merged into subpasses of the same render pass, and transient resources whose lifetimes never
+ * overlap are placed in the same memory. Rendering records each render pass or callback with the
+ * barriers needed between them, batched into one pipeline barrier per step.
+ *
+ * Passes accessing the same resource keep the order they were added in when one of them writes
+ * it or they use it in different layouts. Transient images have the size of the graph, and their
+ * contents do not survive between frames. Imported attachments, such as the swapchain, can only
+ * be used as color or depth attachments, and must have the size of the graph.
+ */
+class RenderGraph
+{
+public:
+	class Resource
+	{
+		friend class RenderGraph;
+	public:
+		void setClearValue(const VkClearValue& clearValue);
+
+		/*
+		 * The texture of a transient or imported image. Transient textures are created by
+		 * init, and recreated by resize.
+		 */
+		Texture* getTexture() { return texture; }
+		/*
+		 * The buffer of a buffer resource. Transient buffers are created by init, and
+		 * recreated by resize.
+		 */
+		VkBuffer getBuffer() const { return buffer; }
+		bool isImage() const { return image; }
+		bool isTransient() const { return attachment == nullptr && importedBuffer == nullptr; }
+
+	private:
+		struct State
+		{
+			VkImageLayout layout;
+			VkPipelineStageFlags writeStages;
+			VkAccessFlags writeAccess;
+			VkPipelineStageFlags readStages;
+			VkPipelineStageFlags visibleStages;
+			VkAccessFlags visibleAccess;
+		};
+
+		Resource() :
+			image{true},
+			format{VK_FORMAT_UNDEFINED},
+			clear{false},
+			clearValue{},
+			attachment{nullptr},
+			texture{nullptr},
+			imageUsage{0},
+			size{0},
+			bufferUsage{0},
+			importedBuffer{nullptr},
+			buffer{VK_NULL_HANDLE},
+			firstStep{-1}, lastStep{-1},
+			requirements{},
+			heap{0},
+			offset{0},
+			state{},
+			used{false} {}
+
+		bool image;
+		VkFormat format;
+		bool clear;
+		VkClearValue clearValue;
+		Attachment* attachment;
+		std::unique_ptr<Texture> transientTexture;
+		Texture* texture;
+		VkImageUsageFlags imageUsage;
+
+		VkDeviceSize size;
+		VkBufferUsageFlags bufferUsage;
+		Buffer* importedBuffer;
+		VkBuffer buffer;
+
+		int firstStep, lastStep;
+		VkMemoryRequirements requirements;
+		size_t heap;
+		VkDeviceSize offset;
+		std::vector<Resource*> aliases;
+
+		State state;
+		bool used;
+	};
+
+	class Pass
+	{
+		friend class RenderGraph;
+	public:
+		/*
+		 * Color attachments are bound in the order they are written.
+		 */
+		void writeColor(Resource& image);
+		void writeDepth(Resource& image);
+		void readInputAttachment(Resource& image);
+		void readSampled(Resource& image, VkPipelineStageFlags stage);
+		void readStorage(Resource& image, VkPipelineStageFlags stage);
+		void writeStorage(Resource& image, VkPipelineStageFlags stage);
+		void readBuffer(Resource& buffer, VkPipelineStageFlags stage, VkAccessFlags access);
+		void writeBuffer(Resource& buffer, VkPipelineStageFlags stage, VkAccessFlags access);
+
+		/*
+		 * The render pass and subpass index of a graphics pass, for creating its pipelines
+		 * after the graph is initialized.
+		 */
+		RenderPass& getRenderPass();
+		uint32_t getSubpassIndex() const { return subpassIndex; }
+		bool isGraphics() const { return subpass != nullptr; }
+
+	private:
+		enum class AccessType
+		{
+			COLOR,
+			DEPTH,
+			INPUT,
+			SAMPLED,
+			STORAGE,
+			BUFFER
+		};
+
+		struct Access
+		{
+			Resource* resource;
+			AccessType type;
+			VkImageLayout layout;
+			VkPipelineStageFlags stage;
+			VkAccessFlags access;
+			bool write;
+
+			bool isAttachment() const
+			{
+				return type == AccessType::COLOR || type == AccessType::DEPTH
+				       || type == AccessType::INPUT;
+			}
+			bool conflicts(const Access& other) const
+			{
+				return resource == other.resource
+				       && (write || other.write || layout != other.layout);
+			}
+		};
+
+		Pass() :
+			graph{nullptr},
+			subpass{nullptr},
+			step{0},
+			subpassIndex{0} {}
+
+		RenderGraph* graph;
+		Subpass* subpass;
+		std::function<void(VkCommandBuffer)> callback;
+		std::vector<Access> accesses;
+		size_t step;
+		uint32_t subpassIndex;
+
+		void addAccess(Resource& resource, AccessType type, VkImageLayout layout,
+			       VkPipelineStageFlags stage, VkAccessFlags access, bool write);
+	};
+
+	RenderGraph() :
+		device{nullptr},
+		width{0}, height{0},
+		transientMemorySize{0} {}
+	~RenderGraph();
+
+	/*
+	 * Transient images are cleared on their first use in a frame when clear is set, and
+	 * undefined otherwise.
+	 */
+	Resource& addImage(VkFormat format, bool clear = true);
+	Resource& addBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+	/*
+	 * Use a texture or swapchain owned elsewhere. The contents are loaded on the first use in
+	 * a frame unless clear is set. A swapchain can only be used in one render pass.
+	 */
+	Resource& importAttachment(Attachment& attachment, bool clear = true);
+	/*
+	 * Use a buffer owned elsewhere. Accesses to it outside of the graph must be synchronized
+	 * by the caller.
+	 */
+	Resource& importBuffer(Buffer& buffer);
+
+	/*
+	 * The attachments of the subpass and its dependencies on other subpasses are set up by
+	 * the graph, so the subpass must not have any of its own.
+	 */
+	Pass& addGraphicsPass(Subpass& subpass);
+	/*
+	 * Pass recorded outside of render passes, e.g. compute dispatches or copies.
+	 */
+	Pass& addPass(const std::function<void(VkCommandBuffer)>& callback);
+
+	void init(Device& device, uint32_t width, uint32_t height);
+	/*
+	 * Recreate the transient resources and framebuffers. Imported attachments must be resized
+	 * first, and the graph must not be in use by pending command buffers. Must also be called
+	 * when imported attachments are recreated at the same size.
+	 */
+	void resize(uint32_t width, uint32_t height);
+	void render(VkCommandBuffer cmdBuffer);
+
+	uint32_t getWidth() const { return width; }
+	uint32_t getHeight() const { return height; }
+	uint32_t getRenderPassCount() const;
+	VkDeviceSize getTransientMemorySize() const { return transientMemorySize; }
+	bool isReady() const { return device != nullptr; }
+
+private:
+	struct AttachmentUse
+	{
+		Resource* resource;
+		AttachmentSlot* slot;
+		VkImageLayout layout;
+		VkImageLayout finalLayout;
+		VkPipelineStageFlags stages;
+		VkAccessFlags access;
+		bool write;
+	};
+
+	struct Step
+	{
+		std::vector<Pass*> passes;
+		std::vector<std::unique_ptr<AttachmentSlot>> slots;
+		std::vector<AttachmentUse> attachments;
+		std::unique_ptr<RenderPass> renderPass;
+		std::unique_ptr<Framebuffer> framebuffer;
+	};
+
+	/*
+	 * Heaps of lazy images only hold transient attachments, and prefer lazily allocated memory.
+	 */
+	struct Heap
+	{
+		bool images;
+		bool lazy;
+		VkMemoryRequirements requirements;
+		std::shared_ptr<Allocation> memory;
+	};
+
+	Device* device;
+	uint32_t width, height;
+	std::vector<std::unique_ptr<Resource>> resources;
+	std::vector<std::unique_ptr<Pass>> passes;
+	std::vector<Step> steps;
+	std::vector<Heap> heaps;
+	VkDeviceSize transientMemorySize;
+	BarrierBatch barrierBatch;
+
+	void schedule();
+	bool canMerge(const Step& step, const Pass& pass) const;
+	void computeLifetimes();
+	void allocateMemory();
+	void placeResources();
+	void createSteps();
+	void createRenderPass(Step& step, size_t index);
+	void addBarrier(Resource& resource, VkImageLayout layout, VkPipelineStageFlags stage,
+			VkAccessFlags access, bool write);
+	void addResourceBarrier(Resource& resource, VkImageLayout oldLayout, VkImageLayout newLayout,
+				VkPipelineStageFlags srcStage, VkAccessFlags srcAccess,
+				VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	void destroyBuffers();
+	void assertReady();
+};
+
+}
+
+#endif
@@ -18,6 +18,11 @@ public:
 	~RenderPass();
 
 	void addSubpassGraph(Subpass& subpass);
+	/*
+	 * Add a single subpass without its dependents. Subpasses a subpass depends on must be added
+	 * before it.
+	 */
+	void addSubpass(Subpass& subpass);
 	void init(Device& device);
 	void render(Framebuffer& framebuffer, VkCommandBuffer cmdBuffer);
 
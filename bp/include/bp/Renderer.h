@@ -12,12 +12,19 @@ class Renderer
 public:
 	Renderer() :
 		width{0}, height{0},
-		device{nullptr} {}
+		device{nullptr},
+		depthUsedAfterPass{false} {}
 	virtual ~Renderer() = default;
 
 	void init(Device& device, VkFormat colorFormat, uint32_t width, uint32_t height);
 
 	virtual void resize(uint32_t width, uint32_t height);
+
+	/*
+	 * The depth attachment is only stored if it is used after rendering. Must be set before
+	 * initialization.
+	 */
+	void setDepthUsedAfterPass(bool used);
 	virtual void render(Framebuffer& fbo, VkCommandBuffer cmdBuffer);
 
 	uint32_t getWidth() const { return  width; }
@@ -36,6 +43,7 @@ protected:
 private:
 	uint32_t width, height;
 	Device* device;
+	bool depthUsedAfterPass;
 	AttachmentSlot colorAttachmentSlot;
 	AttachmentSlot depthAttachmentSlot;
 	RenderPass renderPass;
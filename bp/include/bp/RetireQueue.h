@@ -0,0 +1,55 @@
+#ifndef BP_RETIREQUEUE_H
+#define BP_RETIREQUEUE_H
+
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+
+namespace bp
+{
+
+/*
+ * Defers destroying objects that may still be used by frames in flight. Objects retired while a
+ * frame is recorded are destroyed when the same frame index is begun again, after the fence of
+ * that frame has been waited on. As the fence of a submission also covers the ones submitted
+ * before it on the same queue, this outlives every frame that could have used them. Without
+ * frames in flight, retired objects are destroyed right away, so they must not be used by
+ * pending command buffers.
+ */
+class RetireQueue
+{
+public:
+	RetireQueue() :
+		frameIndex{0} {}
+	~RetireQueue();
+
+	/*
+	 * Destroys everything retired so far, so no frame may be pending.
+	 */
+	void setFrameCount(uint32_t frameCount);
+	/*
+	 * Destroy the objects retired during the last use of frameIndex, whose fence must have
+	 * been waited on, and retire new objects to it.
+	 */
+	void beginFrame(uint32_t frameIndex);
+	/*
+	 * Thread safe, destroy may be called from the thread beginning frames.
+	 */
+	void retire(const std::function<void()>& destroy);
+	/*
+	 * Destroy everything retired, when the device is idle.
+	 */
+	void flush();
+
+	uint32_t getFrameCount() const { return static_cast<uint32_t>(frames.size()); }
+
+private:
+	std::vector<std::vector<std::function<void()>>> frames;
+	uint32_t frameIndex;
+	std::mutex retiredMutex;
+};
+
+}
+
+#endif
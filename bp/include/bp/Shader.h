@@ -2,6 +2,8 @@
 #define BP_SHADER_H
 
 #include "Device.h"
+#include "ShaderCompiler.h"
+#include "SpecializationConstants.h"
 #include <string>
 
 namespace bp
@@ -21,17 +23,28 @@ public:
 	{
 		init(device, stage, codeSize, code);
 	}
-	Shader(Device& device, VkShaderStageFlagBits stage, const std::string& glslSource) :
+	Shader(Device& device, VkShaderStageFlagBits stage, const std::string& glslSource,
+	       const ShaderCompileOptions& options = ShaderCompileOptions{}) :
 		Shader{}
 	{
-		init(device, stage, glslSource);
+		init(device, stage, glslSource, options);
 	}
 	~Shader();
 
 	void init(Device& device, VkShaderStageFlagBits stage, uint32_t codeSize,
 		  const uint32_t* code);
-	void init(Device& device, VkShaderStageFlagBits stage,
-		  const std::string& glslSource);
+
+	/*
+	 * Compile GLSL source with the shader compiler of the device, which caches the SPIR-V.
+	 */
+	void init(Device& device, VkShaderStageFlagBits stage, const std::string& glslSource,
+		  const ShaderCompileOptions& options = ShaderCompileOptions{});
+
+	/*
+	 * Constants used for this shader by pipelines created after the call, unless the pipeline
+	 * sets constants of its own for the stage.
+	 */
+	void setSpecializationConstants(const SpecializationConstants& constants);
 
 	operator VkShaderModule() { return handle; }
 
@@ -48,6 +61,7 @@ private:
 	VkShaderStageFlagBits stage;
 	VkShaderModule handle;
 	VkPipelineShaderStageCreateInfo pipelineShaderStageInfo;
+	SpecializationConstants specialization;
 };
 
 }
@@ -0,0 +1,93 @@
+#ifndef BP_SHADERCOMPILER_H
+#define BP_SHADERCOMPILER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <string>
+#include <utility>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace shaderc
+{
+class Compiler;
+}
+
+namespace bp
+{
+
+class Device;
+class Shader;
+
+enum class ShaderOptimization
+{
+	NONE,
+	SIZE,
+	PERFORMANCE
+};
+
+struct ShaderCompileOptions
+{
+	ShaderCompileOptions() :
+		optimization{ShaderOptimization::NONE},
+		debugInfo{false} {}
+
+	ShaderOptimization optimization;
+	bool debugInfo;
+	std::vector<std::pair<std::string, std::string>> macros;
+};
+
+struct ShaderSource
+{
+	VkShaderStageFlagBits stage;
+	std::string glsl;
+};
+
+/*
+ * Compiles GLSL to SPIR-V with shaderc. Compiled code is cached in memory, and on disk if a
+ * cache directory is set, keyed by a hash of the source, stage and options. Compilation may be
+ * done from several threads at once, and compileBatch spreads a batch of sources over a number
+ * of worker threads.
+ */
+class ShaderCompiler
+{
+public:
+	ShaderCompiler();
+	~ShaderCompiler();
+
+	/*
+	 * Directory to read and write cached SPIR-V in. It must exist.
+	 */
+	void setCacheDirectory(const std::string& path);
+
+	std::vector<uint32_t> compile(const ShaderSource& source,
+				      const ShaderCompileOptions& options = ShaderCompileOptions{});
+	std::vector<std::vector<uint32_t>> compileBatch(
+		const std::vector<ShaderSource>& sources,
+		const ShaderCompileOptions& options = ShaderCompileOptions{},
+		unsigned workerCount = 0);
+
+	/*
+	 * Compile a batch of sources in parallel, then initialize shaders[i] from sources[i].
+	 */
+	void createShaders(Device& device, const std::vector<ShaderSource>& sources,
+			   const std::vector<Shader*>& shaders,
+			   const ShaderCompileOptions& options = ShaderCompileOptions{},
+			   unsigned workerCount = 0);
+
+	const std::string& getCacheDirectory() const { return cacheDirectory; }
+
+private:
+	std::unique_ptr<shaderc::Compiler> compiler;
+	std::string cacheDirectory;
+	std::unordered_map<std::string, std::vector<uint32_t>> cache;
+	std::mutex cacheMutex;
+
+	bool readCache(const std::string& key, std::vector<uint32_t>& code);
+	void writeCache(const std::string& key, const std::vector<uint32_t>& code);
+};
+
+}
+
+#endif
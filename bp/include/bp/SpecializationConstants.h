@@ -0,0 +1,103 @@
+#ifndef BP_SPECIALIZATIONCONSTANTS_H
+#define BP_SPECIALIZATIONCONSTANTS_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <initializer_list>
+#include <type_traits>
+#include <cstring>
+
+namespace bp
+{
+
+/*
+ * Values for the specialization constants of a shader stage, folded into the pipeline when it
+ * is created. Constants are set one by one with set, or all at once from a struct with
+ * fromStruct and map entries giving the constant ID, offset and size of each member.
+ */
+class SpecializationConstants
+{
+public:
+	SpecializationConstants() :
+		info{} {}
+
+	/*
+	 * Set the value of a scalar constant. bool values are stored as VkBool32, as expected for
+	 * GLSL bool constants.
+	 */
+	template <typename T>
+	void set(uint32_t constantID, const T& value)
+	{
+		static_assert(std::is_arithmetic<T>::value, "Constants must be scalar values.");
+		setData(constantID, &value, sizeof(T));
+	}
+	void set(uint32_t constantID, bool value)
+	{
+		VkBool32 b = value ? VK_TRUE : VK_FALSE;
+		setData(constantID, &b, sizeof(b));
+	}
+
+	template <typename T>
+	static SpecializationConstants fromStruct(const T& data,
+						  std::initializer_list<VkSpecializationMapEntry>
+						  entries)
+	{
+		static_assert(std::is_trivially_copyable<T>::value,
+			      "Specialization data must be trivially copyable.");
+		SpecializationConstants constants;
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&data);
+		constants.data.assign(bytes, bytes + sizeof(T));
+		constants.entries.assign(entries.begin(), entries.end());
+		return constants;
+	}
+
+	/*
+	 * The returned info points into this object, and is only valid until it is modified.
+	 * Returns nullptr if no constants are set.
+	 */
+	const VkSpecializationInfo* getInfo()
+	{
+		if (entries.empty()) return nullptr;
+		info.mapEntryCount = static_cast<uint32_t>(entries.size());
+		info.pMapEntries = entries.data();
+		info.dataSize = data.size();
+		info.pData = data.data();
+		return &info;
+	}
+
+	const std::vector<uint8_t>& getData() const { return data; }
+	const std::vector<VkSpecializationMapEntry>& getEntries() const { return entries; }
+	bool isEmpty() const { return entries.empty(); }
+
+private:
+	std::vector<uint8_t> data;
+	std::vector<VkSpecializationMapEntry> entries;
+	VkSpecializationInfo info;
+
+	void setData(uint32_t constantID, const void* value, size_t size)
+	{
+		for (auto it = entries.begin(); it != entries.end(); it++)
+		{
+			if (it->constantID != constantID) continue;
+			if (it->size == size)
+			{
+				std::memcpy(data.data() + it->offset, value, size);
+				return;
+			}
+			entries.erase(it);
+			break;
+		}
+
+		VkSpecializationMapEntry entry = {};
+		entry.constantID = constantID;
+		entry.offset = static_cast<uint32_t>(data.size());
+		entry.size = size;
+		entries.push_back(entry);
+		data.insert(data.end(), reinterpret_cast<const uint8_t*>(value),
+			    reinterpret_cast<const uint8_t*>(value) + size);
+	}
+};
+
+}
+
+#endif
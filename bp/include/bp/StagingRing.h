@@ -0,0 +1,71 @@
+#ifndef BP_STAGINGRING_H
+#define BP_STAGINGRING_H
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Fence.h"
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <vector>
+
+namespace bp
+{
+
+/*
+ * Persistently mapped host visible buffer that staging memory is sub-allocated from in a
+ * circular fashion. Allocations are released with the fence of the submission that reads them,
+ * and their space is reclaimed in allocation order once the fence has signaled.
+ */
+class StagingRing
+{
+public:
+	struct Region
+	{
+		uint64_t id;
+		VkDeviceSize offset;
+		uint8_t* mapped;
+	};
+
+	StagingRing() :
+		size{0},
+		head{0},
+		tail{0},
+		frontId{0} {}
+	StagingRing(Device& device, VkDeviceSize size) :
+		StagingRing{}
+	{
+		init(device, size);
+	}
+
+	void init(Device& device, VkDeviceSize size);
+
+	bool allocate(VkDeviceSize size, VkDeviceSize alignment, Region& region);
+	void release(const std::vector<uint64_t>& ids, const std::shared_ptr<Fence>& fence);
+
+	Buffer& getBuffer() { return buffer; }
+	VkDeviceSize getSize() const { return size; }
+	bool isReady() const { return buffer.isReady(); }
+
+private:
+	struct Span
+	{
+		VkDeviceSize end;
+		bool released;
+		std::shared_ptr<Fence> fence;
+	};
+
+	Buffer buffer;
+	VkDeviceSize size;
+	VkDeviceSize head, tail;
+	std::deque<Span> spans;
+	uint64_t frontId;
+	std::mutex allocationMutex;
+
+	void reclaim();
+	void assertReady();
+};
+
+}
+
+#endif
@@ -22,11 +22,18 @@ public:
 	};
 
 	Subpass() :
-		depthAttachment{nullptr} {}
+		depthAttachment{nullptr},
+		inheritanceInfo{} {}
 	virtual ~Subpass() = default;
 
 	virtual void render(const VkRect2D& area, VkCommandBuffer cmdBuffer) = 0;
 
+	/*
+	 * Subpasses recording their commands in secondary command buffers, which are executed in
+	 * the primary command buffer by render, must return VK_SUBPASS_CONTENTS_SECONDARY.
+	 */
+	virtual VkSubpassContents getContents() const { return VK_SUBPASS_CONTENTS_INLINE; }
+
 	void addDependency(Subpass& subpass, const DependencyInfo& dependencyInfo);
 	void addInputAttachment(const AttachmentSlot& attachment, VkImageLayout layout);
 	void addColorAttachment(const AttachmentSlot& attachment);
@@ -41,7 +48,14 @@ private:
 	std::vector<const AttachmentSlot*> colorAttachments;
 	std::vector<const AttachmentSlot*> resolveAttachments;
 	const AttachmentSlot* depthAttachment;
-
+	VkCommandBufferInheritanceInfo inheritanceInfo;
+
+protected:
+	/*
+	 * Inheritance info for secondary command buffers recorded by render, referring to the
+	 * render pass, subpass and framebuffer currently being rendered.
+	 */
+	const VkCommandBufferInheritanceInfo& getInheritanceInfo() const { return inheritanceInfo; }
 };
 
 }
@@ -18,19 +18,26 @@ public:
 		surface{VK_NULL_HANDLE},
 		handle{VK_NULL_HANDLE},
 		colorSpace{VK_COLOR_SPACE_SRGB_NONLINEAR_KHR},
+		presentMode{VK_PRESENT_MODE_FIFO_KHR},
+		requestedImageCount{2},
 		framebufferImageCount{2},
-		currentFramebufferIndex{0} {}
+		currentFramebufferIndex{0},
+		acquireSemaphore{VK_NULL_HANDLE} {}
 	Swapchain(Device& device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-		  bool vsync) :
+		  bool vsync, uint32_t imageCount = 2) :
 		Swapchain{}
 	{
-		init(device, surface, width, height, vsync);
+		init(device, surface, width, height, vsync, imageCount);
 	}
 
 	~Swapchain() override;
 
+	/*
+	 * imageCount is the minimum number of swapchain images to request, clamped to what the
+	 * surface supports. The presentation engine may create more.
+	 */
 	void init(Device& device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-		  bool vsync);
+		  bool vsync, uint32_t imageCount = 2);
 
 	void before(VkCommandBuffer cmdBuffer) override;
 	void after(VkCommandBuffer cmdBuffer) override;
@@ -40,6 +47,12 @@ public:
 	void recreate(VkSurfaceKHR newSurface = VK_NULL_HANDLE);
 	void destroy();
 
+	/*
+	 * Signal semaphore instead of the swapchain's own semaphore when acquiring the following
+	 * images, so that each frame in flight can wait on its own acquisition.
+	 */
+	void setImageAvailableSemaphore(VkSemaphore semaphore) { acquireSemaphore = semaphore; }
+
 	operator VkSwapchainKHR() { return handle; }
 
 	bool isReady() const override { return handle != VK_NULL_HANDLE; }
@@ -49,7 +62,8 @@ public:
 	uint32_t getCurrentFramebufferIndex() const { return currentFramebufferIndex; }
 	VkImage getFramebufferImage(uint32_t i) { return framebufferImages[i]; }
 	VkImageView getFramebufferImageView(uint32_t i) { return framebufferImageViews[i]; }
-	VkSemaphore getImageAvailableSemaphore() { return imageAvailableSemaphore; }
+	VkSemaphore getImageAvailableSemaphore() { return acquireSemaphore; }
+	VkPresentModeKHR getPresentMode() const { return presentMode; }
 
 	VkImageLayout getInitialLayout() const override
 	{
@@ -67,12 +81,15 @@ private:
 	VkSurfaceKHR surface;
 	VkSwapchainKHR handle;
 	VkColorSpaceKHR colorSpace;
+	VkPresentModeKHR presentMode;
+	uint32_t requestedImageCount;
 	uint32_t framebufferImageCount;
 	std::vector<VkImage> framebufferImages;
 	std::vector<bool> transitionStatus;
 	std::vector<VkImageView> framebufferImageViews;
 	uint32_t currentFramebufferIndex;
 	Semaphore imageAvailableSemaphore;
+	VkSemaphore acquireSemaphore;
 
 	void create();
 	void nextImage();
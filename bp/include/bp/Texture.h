@@ -4,6 +4,8 @@
 #include "Attachment.h"
 #include "Image.h"
 #include "ImageDescriptor.h"
+#include "UploadContext.h"
+#include "CompressedImage.h"
 
 namespace bp
 {
@@ -14,6 +16,11 @@ public:
 	Texture() :
 		Attachment{},
 		imageUsage{0},
+		mipLevels{1},
+		baseMipLevel{0},
+		memoryPool{MemoryPool::DEFAULT},
+		memoryOffset{0},
+		relocatable{false},
 		image{nullptr},
 		imageView{VK_NULL_HANDLE},
 		sampler{VK_NULL_HANDLE},
@@ -21,32 +28,71 @@ public:
 		renderAccessFlags{0},
 		renderPipelineStage{0} {}
 	Texture(Device& device, VkFormat format, VkImageUsageFlags usage,
-			uint32_t width, uint32_t height) :
+			uint32_t width, uint32_t height, uint32_t mipLevels = 1,
+			MemoryPool memoryPool = MemoryPool::DEFAULT) :
 		Texture{}
 	{
-		init(device, format, usage, width, height);
+		init(device, format, usage, width, height, mipLevels, memoryPool);
 	}
 
 	virtual ~Texture();
 
+	/*
+	 * Textures used as attachments are allocated from the attachment pool, unless another pool
+	 * is given.
+	 */
 	void init(Device& device, VkFormat format, VkImageUsageFlags usage, uint32_t width,
-			  uint32_t height);
+			  uint32_t height, uint32_t mipLevels = 1,
+			  MemoryPool memoryPool = MemoryPool::DEFAULT);
 	void load(Device& device, VkImageUsageFlags usage, const std::string& path);
+	void load(UploadContext& uploadContext, VkImageUsageFlags usage, const std::string& path);
+	void load(UploadContext& uploadContext, VkImageUsageFlags usage,
+		  const CompressedImage& compressedImage);
 	void resize(uint32_t width, uint32_t height) override;
+	void usePlaceholder(Texture& placeholder);
+	void setBaseMipLevel(uint32_t baseMipLevel);
+	/*
+	 * Bind the image to memory at an offset instead of allocating it from a pool, see
+	 * Image::init. Takes effect when the image is created by init or recreated by resize.
+	 */
+	void setMemory(const std::shared_ptr<Allocation>& memory, VkDeviceSize offset);
+	/*
+	 * Let defragmentation move the image of the texture, see Image::enableRelocation. Takes
+	 * effect for the current image and those created later, unless they are bound to memory
+	 * given by setMemory. Must not be used for textures that are being streamed, as uploads to
+	 * the old image may still be pending.
+	 */
+	void enableRelocation();
 	void transitionShaderReadable(VkCommandBuffer cmdBuffer, VkPipelineStageFlags stage);
+	void transitionShaderReadable(BarrierBatch& batch, VkPipelineStageFlags stage);
 	void before(VkCommandBuffer cmdBuffer) override;
 
 	void setDescriptorBinding(uint32_t binding) { descriptor.setBinding(binding); }
+	void setDescriptorArrayIndex(uint32_t index) { descriptor.setFirstIndex(index); }
 
 	VkImageUsageFlags getImageUsage() const { return imageUsage; }
+	uint32_t getMipLevels() const { return mipLevels; }
+	uint32_t getBaseMipLevel() const { return baseMipLevel; }
 	Image& getImage() { return *image; }
 	VkImageView getImageView() { return imageView; }
 	VkImageLayout getInitialLayout() const override { return renderLayout; }
 	VkImageLayout getFinalLayout() const override { return renderLayout; }
 	const Descriptor& getDescriptor() { return descriptor; }
 
+	/*
+	 * Triggered when the image view has been recreated after the image was moved by
+	 * defragmentation. Descriptor sets the texture is bound to must be updated.
+	 */
+	bpUtil::Event<> relocateEvent;
+
 private:
 	VkImageUsageFlags imageUsage;
+	uint32_t mipLevels;
+	uint32_t baseMipLevel;
+	MemoryPool memoryPool;
+	std::shared_ptr<Allocation> memory;
+	VkDeviceSize memoryOffset;
+	bool relocatable;
 	Image* image;
 	VkImageView imageView;
 	VkSampler sampler;
@@ -57,6 +103,9 @@ private:
 	VkPipelineStageFlags renderPipelineStage;
 
 	void create();
+	void createImageView();
+	void enableImageRelocation();
+	void relocate();
 	void destroy();
 };
 
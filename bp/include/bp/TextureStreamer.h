@@ -0,0 +1,110 @@
+#ifndef BP_TEXTURESTREAMER_H
+#define BP_TEXTURESTREAMER_H
+
+#include "Texture.h"
+#include "UploadContext.h"
+#include <bpUtil/AsyncQueue.h>
+#include <bpUtil/Event.h>
+#include <vector>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <string>
+
+namespace bp
+{
+
+/*
+ * Loads textures in the background. Image files are decoded on worker threads, and the mip
+ * levels of decoded images are uploaded by update, within a byte budget per call. Levels are
+ * uploaded from the smallest to the largest, so that a low resolution version of a texture is
+ * available early and refined over the following frames. Until its first levels are resident, a
+ * streamed texture refers to a placeholder texture.
+ *
+ * The streamer has an upload context of its own, from the transfer queue to the graphics queue,
+ * so that its batches are not submitted by other users. update should be called once per frame,
+ * after the frame loop has begun the frame of the device retire queue, as it recreates image
+ * views and calls the residency callbacks, which typically update descriptor sets. Replaced
+ * views are retired to the device, but the callbacks may only update descriptor sets that
+ * pending frames do not use, or that allow updates after binding. Textures must outlive their
+ * streaming.
+ */
+class TextureStreamer
+{
+public:
+	TextureStreamer() :
+		device{nullptr},
+		byteBudget{0} {}
+	TextureStreamer(Device& device, VkDeviceSize byteBudget, unsigned workerCount = 2) :
+		TextureStreamer{}
+	{
+		init(device, byteBudget, workerCount);
+	}
+	~TextureStreamer();
+
+	void init(Device& device, VkDeviceSize byteBudget, unsigned workerCount = 2);
+
+	/*
+	 * Start streaming the image file at path into texture. The texture refers to the
+	 * placeholder until it is initialized and its smallest levels are resident.
+	 * residencyChanged is called from update every time more levels have become resident.
+	 */
+	void stream(Texture& texture, const std::string& path,
+		    const std::function<void()>& residencyChanged);
+	void update();
+
+	void setByteBudget(VkDeviceSize byteBudget) { TextureStreamer::byteBudget = byteBudget; }
+
+	Texture& getPlaceholder() { return placeholder; }
+	VkDeviceSize getByteBudget() const { return byteBudget; }
+	size_t getPendingCount() const { return requests.size(); }
+	bool isReady() const { return device != nullptr; }
+
+	bpUtil::Event<const std::string&> errorEvent;
+
+private:
+	struct Level
+	{
+		VkDeviceSize offset;
+		VkDeviceSize size;
+		uint32_t width, height;
+	};
+
+	struct Request
+	{
+		Texture* texture;
+		std::string path;
+		std::function<void()> residencyChanged;
+
+		bool decoded;
+		bool initialized;
+		std::string error;
+		VkFormat format;
+		std::vector<Level> levels;
+		std::vector<uint8_t> data;
+
+		uint32_t uploadedLevel;
+		std::vector<std::pair<uint32_t, UploadHandle>> uploads;
+	};
+
+	Device* device;
+	VkDeviceSize byteBudget;
+	UploadContext uploadContext;
+	Texture placeholder;
+
+	std::list<std::unique_ptr<Request>> requests;
+	std::mutex decodeMutex;
+	bpUtil::AsyncQueue<Request*> decodeQueue;
+	std::vector<std::thread> workers;
+
+	void decode(Request& request);
+	bool uploadLevels(Request& request, VkDeviceSize& budget);
+	bool updateResidency(Request& request);
+	void assertReady();
+};
+
+}
+
+#endif
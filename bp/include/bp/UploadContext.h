@@ -0,0 +1,146 @@
+#ifndef BP_UPLOADCONTEXT_H
+#define BP_UPLOADCONTEXT_H
+
+#include "Device.h"
+#include "Buffer.h"
+#include "Image.h"
+#include "CommandPool.h"
+#include "Fence.h"
+#include "Semaphore.h"
+#include "StagingRing.h"
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <vector>
+
+namespace bp
+{
+
+/*
+ * Handle to a submitted batch of uploads. The destination resources can be used once the
+ * handle reports that the batch is complete. A default constructed handle is always complete.
+ */
+class UploadHandle
+{
+public:
+	UploadHandle() {}
+
+	bool isComplete() const;
+	void wait() const;
+
+private:
+	friend class UploadContext;
+
+	explicit UploadHandle(const std::shared_ptr<Fence>& fence) :
+		fence{fence} {}
+
+	std::shared_ptr<Fence> fence;
+};
+
+/*
+ * Records buffer and image uploads into a single command buffer, which is submitted with a
+ * fence when submit is called. Staging memory is sub-allocated from the staging ring of the
+ * device and kept alive until the batch has completed on the device. Uploads that are larger
+ * than the ring get a dedicated staging buffer. Command buffers of completed batches are reused.
+ * Recording may be done from multiple threads.
+ *
+ * The destination queue is the queue the uploaded resources will be used on. When it is of
+ * another family than the upload queue, uploaded resources are released to the destination
+ * family, and acquired by a command buffer submitted to the destination queue, which waits for
+ * the upload with a semaphore. Buffers are released once per batch, after all of their uploads,
+ * and concurrently shared buffers are not transferred at all. Uploads to buffers the destination
+ * family already owns are recorded on the destination queue, so that they never have to be
+ * transferred back. Uploads to other resources that the destination queue is using must be
+ * recorded on the destination queue by the caller. Commands recorded with recordOnDstQueue are
+ * executed on the destination queue after the uploaded resources have been acquired, e.g. for
+ * work that needs graphics support such as mip generation.
+ *
+ * uploadMipLevels only touches the given range of mip levels of the image, discarding their
+ * previous contents, so the other levels may be in use on the destination queue meanwhile.
+ */
+class UploadContext
+{
+public:
+	UploadContext() :
+		device{nullptr},
+		queue{nullptr},
+		dstQueue{nullptr} {}
+	UploadContext(Device& device, Queue& queue) :
+		UploadContext{}
+	{
+		init(device, queue);
+	}
+	UploadContext(Device& device, Queue& queue, Queue& dstQueue) :
+		UploadContext{}
+	{
+		init(device, queue, dstQueue);
+	}
+	~UploadContext();
+
+	void init(Device& device, Queue& queue);
+	void init(Device& device, Queue& queue, Queue& dstQueue);
+
+	void upload(Buffer& dst, VkDeviceSize offset, VkDeviceSize size, const void* data);
+	void upload(Image& dst, const void* data, VkDeviceSize size,
+		    VkImageLayout dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void upload(Image& dst, const void* data, VkDeviceSize size,
+		    const std::vector<VkBufferImageCopy>& regions,
+		    VkImageLayout dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void uploadMipLevels(Image& dst, const void* data, VkDeviceSize size,
+			     const std::vector<VkBufferImageCopy>& regions, uint32_t baseMipLevel,
+			     uint32_t levelCount,
+			     VkImageLayout dstLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	void record(const std::function<void(VkCommandBuffer)>& commands);
+	void recordOnDstQueue(const std::function<void(VkCommandBuffer)>& commands);
+	void transferOwnership(Buffer& buffer);
+	void transferOwnership(Image& image, VkImageLayout dstLayout);
+	UploadHandle submit();
+	void waitIdle();
+
+	Device& getDevice() { return *device; }
+	Queue& getQueue() { return *queue; }
+	Queue& getDstQueue() { return *dstQueue; }
+	bool isReady() const { return device != nullptr; }
+
+private:
+	struct Batch
+	{
+		Batch() :
+			cmdBuffer{VK_NULL_HANDLE},
+			acquireCmdBuffer{VK_NULL_HANDLE} {}
+
+		VkCommandBuffer cmdBuffer;
+		VkCommandBuffer acquireCmdBuffer;
+		std::unique_ptr<Semaphore> semaphore;
+		std::shared_ptr<Fence> fence;
+		std::vector<uint64_t> stagingRegions;
+		std::vector<std::unique_ptr<Buffer>> stagingBuffers;
+		std::vector<Buffer*> releasedBuffers;
+	};
+
+	Device* device;
+	Queue* queue;
+	Queue* dstQueue;
+	CommandPool cmdPool, acquireCmdPool;
+	std::vector<VkCommandBuffer> freeCmdBuffers, freeAcquireCmdBuffers;
+	std::mutex recordMutex;
+	Batch current;
+	std::vector<Batch> pending;
+
+	VkCommandBuffer begin();
+	VkCommandBuffer beginAcquire();
+	static VkCommandBuffer beginCmdBuffer(CommandPool& pool,
+					      std::vector<VkCommandBuffer>& freeList);
+	bool needsOwnershipTransfer() const;
+	void transferBufferOwnership(Buffer& buffer);
+	void transferImageOwnership(Image& image, VkImageLayout dstLayout);
+	void finishImageUpload(Image& image, VkImageLayout dstLayout, VkCommandBuffer cmdBuffer);
+	Buffer* stage(const void* data, VkDeviceSize size, VkDeviceSize& offset);
+	std::shared_ptr<Fence> submitCurrent();
+	void collect();
+	void assertReady();
+};
+
+}
+
+#endif
@@ -4,6 +4,7 @@
 #include <vulkan/vulkan.h>
 #include <vector>
 #include <string>
+#include <memory>
 
 namespace bp
 {
@@ -32,6 +33,29 @@ int32_t findSurfaceQueueFamilyIndex(VkPhysicalDevice device, VkSurfaceKHR surfac
 int32_t findPhysicalDeviceMemoryType(VkPhysicalDevice physicalDevice, uint32_t memoryTypeBits,
 				     VkMemoryPropertyFlags properties);
 
+/*
+ * Check if the physical device supports the given features for images of the format and tiling.
+ * Useful for checking support for compressed formats before loading them.
+ */
+bool isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling,
+		       VkFormatFeatureFlags features);
+
+/*
+ * Calculate the number of mip levels in a full mip chain for an image of the given size, down to
+ * and including the 1x1 level.
+ */
+uint32_t calculateMipLevels(uint32_t width, uint32_t height);
+
+/*
+ * Check if the format has a depth component, with or without stencil.
+ */
+bool isDepthFormat(VkFormat format);
+
+/*
+ * Get all the aspects of images of the format, e.g. for barriers covering the whole image.
+ */
+VkImageAspectFlags getAspectFlags(VkFormat format);
+
 /*
  * Read a binary file into a vector.
  * Useful for loading SPIR-V binary code from files.
@@ -55,6 +79,12 @@ void replaceSubstrings(std::string& str, const std::string& find, const std::str
  */
 void* parallelCopy(void* dest, const void* src, size_t count);
 
+/*
+ * Get a token that lives as long as the calling thread. A weak pointer to it expires when the
+ * thread exits, so that objects kept per thread can be destroyed.
+ */
+std::shared_ptr<int> getThreadToken();
+
 }
 
 #endif
\ No newline at end of file
@@ -0,0 +1,190 @@
+#include <bp/BarrierBatch.h>
+#include <bp/CommandPool.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bp
+{
+
+/*
+ * Stages the queue does not support are left out, as they can not have work on it to wait for
+ * or to block. If none are left, the barrier waits for all commands instead.
+ */
+static VkPipelineStageFlags maskStages(VkPipelineStageFlags stages,
+				       VkPipelineStageFlags supported)
+{
+	if (stages == 0) return 0;
+	VkPipelineStageFlags masked = stages & supported;
+	return masked != 0 ? masked : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+}
+
+void BarrierBatch::init(Device& device)
+{
+	if (isReady()) throw runtime_error("Barrier batch already initialized.");
+	BarrierBatch::device = &device;
+}
+
+void BarrierBatch::addMemoryBarrier(const VkMemoryBarrier& barrier, VkPipelineStageFlags srcStage,
+				    VkPipelineStageFlags dstStage)
+{
+	memoryBarriers.push_back(barrier);
+	memoryBarriers.back().sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	memoryStages.push_back({srcStage, dstStage});
+}
+
+void BarrierBatch::addImageBarrier(const VkImageMemoryBarrier& barrier,
+				   VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	imageBarriers.push_back(barrier);
+	imageBarriers.back().sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	imageStages.push_back({srcStage, dstStage});
+}
+
+void BarrierBatch::addBufferBarrier(const VkBufferMemoryBarrier& barrier,
+				    VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage)
+{
+	bufferBarriers.push_back(barrier);
+	bufferBarriers.back().sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	bufferStages.push_back({srcStage, dstStage});
+}
+
+void BarrierBatch::record(VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	if (isEmpty()) return;
+
+	VkPipelineStageFlags supported =
+		device->getSupportedStages(CommandPool::getQueueFamilyIndex(cmdBuffer));
+	for (auto* stages : {&memoryStages, &imageStages, &bufferStages})
+	{
+		for (auto& s : *stages)
+		{
+			s.src = maskStages(s.src, supported);
+			s.dst = maskStages(s.dst, supported);
+		}
+	}
+
+#ifdef VK_KHR_synchronization2
+	if (device->getFunctions().cmdPipelineBarrier2 != nullptr)
+	{
+		recordSynchronization2(cmdBuffer);
+		clear();
+		return;
+	}
+#endif
+	recordLegacy(cmdBuffer);
+	clear();
+}
+
+void BarrierBatch::clear()
+{
+	memoryBarriers.clear();
+	memoryStages.clear();
+	imageBarriers.clear();
+	imageStages.clear();
+	bufferBarriers.clear();
+	bufferStages.clear();
+}
+
+#ifdef VK_KHR_synchronization2
+void BarrierBatch::recordSynchronization2(VkCommandBuffer cmdBuffer)
+{
+	vector<VkMemoryBarrier2KHR> memory(memoryBarriers.size());
+	for (size_t i = 0; i < memoryBarriers.size(); i++)
+	{
+		const VkMemoryBarrier& b = memoryBarriers[i];
+		VkMemoryBarrier2KHR& barrier = memory[i];
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+		barrier.srcStageMask = memoryStages[i].src;
+		barrier.srcAccessMask = b.srcAccessMask;
+		barrier.dstStageMask = memoryStages[i].dst;
+		barrier.dstAccessMask = b.dstAccessMask;
+	}
+
+	vector<VkImageMemoryBarrier2KHR> images(imageBarriers.size());
+	for (size_t i = 0; i < imageBarriers.size(); i++)
+	{
+		const VkImageMemoryBarrier& b = imageBarriers[i];
+		VkImageMemoryBarrier2KHR& barrier = images[i];
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR;
+		barrier.srcStageMask = imageStages[i].src;
+		barrier.srcAccessMask = b.srcAccessMask;
+		barrier.dstStageMask = imageStages[i].dst;
+		barrier.dstAccessMask = b.dstAccessMask;
+		barrier.oldLayout = b.oldLayout;
+		barrier.newLayout = b.newLayout;
+		barrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+		barrier.image = b.image;
+		barrier.subresourceRange = b.subresourceRange;
+	}
+
+	vector<VkBufferMemoryBarrier2KHR> buffers(bufferBarriers.size());
+	for (size_t i = 0; i < bufferBarriers.size(); i++)
+	{
+		const VkBufferMemoryBarrier& b = bufferBarriers[i];
+		VkBufferMemoryBarrier2KHR& barrier = buffers[i];
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR;
+		barrier.srcStageMask = bufferStages[i].src;
+		barrier.srcAccessMask = b.srcAccessMask;
+		barrier.dstStageMask = bufferStages[i].dst;
+		barrier.dstAccessMask = b.dstAccessMask;
+		barrier.srcQueueFamilyIndex = b.srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = b.dstQueueFamilyIndex;
+		barrier.buffer = b.buffer;
+		barrier.offset = b.offset;
+		barrier.size = b.size;
+	}
+
+	VkDependencyInfoKHR info = {};
+	info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+	info.memoryBarrierCount = static_cast<uint32_t>(memory.size());
+	info.pMemoryBarriers = memory.data();
+	info.bufferMemoryBarrierCount = static_cast<uint32_t>(buffers.size());
+	info.pBufferMemoryBarriers = buffers.data();
+	info.imageMemoryBarrierCount = static_cast<uint32_t>(images.size());
+	info.pImageMemoryBarriers = images.data();
+	device->getFunctions().cmdPipelineBarrier2(cmdBuffer, &info);
+}
+#endif
+
+/*
+ * An empty source or destination stage means no dependency in synchronization2, which is
+ * expressed with the top and bottom of the pipe in the original barrier command.
+ */
+void BarrierBatch::recordLegacy(VkCommandBuffer cmdBuffer)
+{
+	VkPipelineStageFlags srcStage = 0, dstStage = 0;
+	for (auto& s : memoryStages)
+	{
+		srcStage |= s.src;
+		dstStage |= s.dst;
+	}
+	for (auto& s : imageStages)
+	{
+		srcStage |= s.src;
+		dstStage |= s.dst;
+	}
+	for (auto& s : bufferStages)
+	{
+		srcStage |= s.src;
+		dstStage |= s.dst;
+	}
+
+	if (srcStage == 0) srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (dstStage == 0) dstStage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+
+	vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0,
+			     static_cast<uint32_t>(memoryBarriers.size()), memoryBarriers.data(),
+			     static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+			     static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+}
+
+void BarrierBatch::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Barrier batch not ready. Must initialize before use.");
+}
+
+}
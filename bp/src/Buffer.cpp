@@ -1,4 +1,5 @@
 #include <bp/Buffer.h>
+#include <bp/UploadContext.h>
 #include <stdexcept>
 #include <bp/Util.h>
 #include <algorithm>
@@ -9,23 +10,26 @@ namespace bp
 {
 
 void Buffer::init(Device& device, VkDeviceSize size, VkBufferUsageFlags usage,
-		  VmaMemoryUsage memoryUsage)
+		  VmaMemoryUsage memoryUsage, MemoryPool memoryPool)
 {
 	if (isReady()) throw runtime_error("Buffer already initialized.");
 	Buffer::device = &device;
 	Buffer::size = size;
 
 	usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	Buffer::usage = usage;
 
-	VkBufferCreateInfo info = {};
-	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	info.size = size;
-	info.usage = usage;
-	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-	memory = device.getMemoryAllocator().createBuffer(info, memoryUsage, handle);
+	VkBufferCreateInfo info = createInfo();
+	memory = device.getMemoryAllocator().createBuffer(info, memoryUsage, handle, memoryPool);
+}
 
-	cmdPool.init(device.getTransferQueue(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+void Buffer::setConcurrentSharing(const vector<uint32_t>& queueFamilyIndices)
+{
+	if (isReady()) throw runtime_error("Sharing must be set before the buffer is initialized.");
+	queueFamilies = queueFamilyIndices;
+	sort(queueFamilies.begin(), queueFamilies.end());
+	queueFamilies.erase(unique(queueFamilies.begin(), queueFamilies.end()),
+			    queueFamilies.end());
 }
 
 Buffer::~Buffer()
@@ -78,46 +82,47 @@ void Buffer::transfer(VkDeviceSize offset, VkDeviceSize size, const void* data,
 {
 	assertReady();
 	if (size == VK_WHOLE_SIZE) size = Buffer::size - offset;
+
+	if (cmdBuffer == VK_NULL_HANDLE && stagingBuffer == nullptr && !memory->isMapped())
+	{
+		UploadContext& uploadContext = device->getUploadContext();
+		uploadContext.upload(*this, offset, size, data);
+		uploadContext.submit().wait();
+		return;
+	}
+
 	void* mapped = map();
 	parallelCopy(mapped, data, size);
 
 	if (stagingBuffer != nullptr)
-	{
-		bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-		if (useOwnBuffer)
-		{
-			cmdBuffer = cmdPool.allocateCommandBuffer();
-			VkCommandBufferBeginInfo beginInfo = {};
-			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-			vkBeginCommandBuffer(cmdBuffer, &beginInfo);
-		}
-
 		transfer(*stagingBuffer, offset, offset, size, cmdBuffer);
-
-		if (useOwnBuffer)
-		{
-			vkEndCommandBuffer(cmdBuffer);
-			Queue& queue = device->getTransferQueue();
-			queue.submit({}, {cmdBuffer}, {});
-			queue.waitIdle();
-			cmdPool.freeCommandBuffer(cmdBuffer);
-		}
-	}
 }
 
 void Buffer::transfer(Buffer& src, VkDeviceSize srcOffset, VkDeviceSize dstOffset,
 		      VkDeviceSize size, VkCommandBuffer cmdBuffer)
 {
 	assertReady();
-	bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-	if (useOwnBuffer)
+	auto commands = [&](VkCommandBuffer cmdBuffer) {
+		transfer(src, srcOffset, dstOffset, size, cmdBuffer);
+	};
+
+	/*
+	 * Copies from host memory are uploads and go through the upload context. Copies between
+	 * device local buffers are done on the graphics queue, which owns them.
+	 */
+	if (cmdBuffer == VK_NULL_HANDLE && src.isMapped())
 	{
-		cmdBuffer = cmdPool.allocateCommandBuffer();
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+		UploadContext& uploadContext = device->getUploadContext();
+		uploadContext.record(commands);
+		uploadContext.transferOwnership(*this);
+		uploadContext.submit().wait();
+		return;
+	}
+
+	if (cmdBuffer == VK_NULL_HANDLE)
+	{
+		device->getCommandPoolManager().execute(device->getGraphicsQueue(), commands);
+		return;
 	}
 
 	VkBufferCopy copy_region = {};
@@ -130,36 +135,26 @@ void Buffer::transfer(Buffer& src, VkDeviceSize srcOffset, VkDeviceSize dstOffse
 		copy_region.size = size;
 
 	vkCmdCopyBuffer(cmdBuffer, src.getHandle(), handle, 1, &copy_region);
-
-	if (useOwnBuffer)
-	{
-		vkEndCommandBuffer(cmdBuffer);
-		Queue& queue = device->getTransferQueue();
-		queue.submit({}, {cmdBuffer}, {});
-		queue.waitIdle();
-		cmdPool.freeCommandBuffer(cmdBuffer);
-	}
 }
 
 void Buffer::transfer(Image& src, VkCommandBuffer cmdBuffer)
 {
 	assertReady();
-	bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-	if (useOwnBuffer)
+	if (cmdBuffer == VK_NULL_HANDLE)
 	{
-		cmdBuffer = cmdPool.allocateCommandBuffer();
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+		device->getCommandPoolManager().execute(
+			device->getGraphicsQueue(), [&](VkCommandBuffer cmdBuffer) {
+				transfer(src, cmdBuffer);
+			});
+		return;
 	}
 
 	src.transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
 		       VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
 
 	VkImageSubresourceLayers subResource = {};
-	subResource.aspectMask = src.format == VK_FORMAT_D16_UNORM ? VK_IMAGE_ASPECT_DEPTH_BIT
-								   : VK_IMAGE_ASPECT_COLOR_BIT;
+	subResource.aspectMask = isDepthFormat(src.format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+							   : VK_IMAGE_ASPECT_COLOR_BIT;
 	subResource.baseArrayLayer = 0;
 	subResource.mipLevel = 0;
 	subResource.layerCount = 1;
@@ -168,16 +163,103 @@ void Buffer::transfer(Image& src, VkCommandBuffer cmdBuffer)
 	region.imageSubresource = subResource;
 	region.imageExtent = {src.width, src.height, 1};
 
-	vkCmdCopyImageToBuffer(cmdBuffer, src, src.layout, handle, 1, &region);
+	vkCmdCopyImageToBuffer(cmdBuffer, src, src.getLayout(), handle, 1, &region);
+}
 
-	if (useOwnBuffer)
+void Buffer::releaseOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkAccessFlags srcAccess, VkPipelineStageFlags srcStage,
+			      VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+	barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+	barrier.buffer = handle;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(cmdBuffer, srcStage, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+			     nullptr, 1, &barrier, 0, nullptr);
+}
+
+void Buffer::acquireOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			      VkAccessFlags dstAccess, VkPipelineStageFlags dstStage,
+			      VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	VkBufferMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+	barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+	barrier.buffer = handle;
+	barrier.size = VK_WHOLE_SIZE;
+
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStage, 0, 0,
+			     nullptr, 1, &barrier, 0, nullptr);
+	ownerQueueFamily = dstQueueFamilyIndex;
+}
+
+VkBufferCreateInfo Buffer::createInfo() const
+{
+	VkBufferCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	info.size = size;
+	info.usage = usage;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (isConcurrent())
 	{
-		vkEndCommandBuffer(cmdBuffer);
-		Queue& queue = device->getTransferQueue();
-		queue.submit({}, {cmdBuffer}, {});
-		queue.waitIdle();
-		cmdPool.freeCommandBuffer(cmdBuffer);
+		info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		info.queueFamilyIndexCount = static_cast<uint32_t>(queueFamilies.size());
+		info.pQueueFamilyIndices = queueFamilies.data();
 	}
+	return info;
+}
+
+void Buffer::enableRelocation()
+{
+	assertReady();
+	auto allocation = static_pointer_cast<Allocation>(memory);
+	if (!allocation->isRelocatable())
+		throw invalid_argument("Only buffers with memory of their own can be relocated.");
+	allocation->setRelocationHandler(
+		[this](VkCommandBuffer cmdBuffer, const shared_ptr<Allocation>& oldMemory) {
+			relocate(cmdBuffer, oldMemory);
+		});
+}
+
+void Buffer::relocate(VkCommandBuffer cmdBuffer, const shared_ptr<Allocation>& oldMemory)
+{
+	VkBuffer oldHandle = handle;
+	VkBufferCreateInfo info = createInfo();
+	VkResult result = vkCreateBuffer(*device, &info, nullptr, &handle);
+	if (result != VK_SUCCESS)
+	{
+		handle = oldHandle;
+		throw runtime_error("Failed to recreate relocated buffer.");
+	}
+
+	Allocation& allocation = static_cast<Allocation&>(*memory);
+	result = vkBindBufferMemory(*device, handle, allocation.getDeviceMemory(),
+				    allocation.getOffset());
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyBuffer(*device, handle, nullptr);
+		handle = oldHandle;
+		throw runtime_error("Failed to bind relocated buffer memory.");
+	}
+
+	VkBufferCopy region = {};
+	region.size = size;
+	vkCmdCopyBuffer(cmdBuffer, oldHandle, handle, 1, &region);
+
+	VkDevice logical = *device;
+	device->getRetireQueue().retire([logical, oldHandle, oldMemory] {
+		vkDestroyBuffer(logical, oldHandle, nullptr);
+	});
+
+	relocateEvent();
 }
 
 void Buffer::assertReady()
@@ -1,15 +1,74 @@
 #include <bp/CommandPool.h>
 #include <stdexcept>
+#include <mutex>
+#include <unordered_map>
 
 using namespace std;
 
 namespace bp
 {
 
+/*
+ * Pool and queue family of every command buffer allocated through this library, so that the
+ * barriers recorded to a command buffer can be limited to the stages of its queue.
+ */
+struct RegisteredCommandBuffers
+{
+	mutex registeredMutex;
+	unordered_map<VkCommandBuffer, pair<VkCommandPool, uint32_t>> families;
+};
+
+static RegisteredCommandBuffers& getRegistered()
+{
+	static RegisteredCommandBuffers registered;
+	return registered;
+}
+
+uint32_t CommandPool::getQueueFamilyIndex(VkCommandBuffer cmdBuffer)
+{
+	RegisteredCommandBuffers& registered = getRegistered();
+	lock_guard<mutex> lock(registered.registeredMutex);
+	auto found = registered.families.find(cmdBuffer);
+	return found != registered.families.end() ? found->second.second
+						  : VK_QUEUE_FAMILY_IGNORED;
+}
+
+void CommandPool::registerCommandBuffers(VkCommandPool pool, uint32_t queueFamilyIndex,
+					 const VkCommandBuffer* cmdBuffers, uint32_t count)
+{
+	RegisteredCommandBuffers& registered = getRegistered();
+	lock_guard<mutex> lock(registered.registeredMutex);
+	for (uint32_t i = 0; i < count; i++)
+		registered.families[cmdBuffers[i]] = {pool, queueFamilyIndex};
+}
+
+void CommandPool::unregisterCommandBuffers(const VkCommandBuffer* cmdBuffers, uint32_t count)
+{
+	RegisteredCommandBuffers& registered = getRegistered();
+	lock_guard<mutex> lock(registered.registeredMutex);
+	for (uint32_t i = 0; i < count; i++) registered.families.erase(cmdBuffers[i]);
+}
+
+void CommandPool::unregisterPool(VkCommandPool pool)
+{
+	RegisteredCommandBuffers& registered = getRegistered();
+	lock_guard<mutex> lock(registered.registeredMutex);
+	for (auto it = registered.families.begin(); it != registered.families.end();)
+	{
+		if (it->second.first == pool)
+			it = registered.families.erase(it);
+		else
+			it++;
+	}
+}
+
 CommandPool::~CommandPool()
 {
 	if (isReady())
+	{
+		unregisterPool(handle);
 		vkDestroyCommandPool(queue->getDevice(), handle, nullptr);
+	}
 }
 
 void CommandPool::init(Queue& queue, VkCommandPoolCreateFlags flags)
@@ -38,6 +97,7 @@ VkCommandBuffer CommandPool::allocateCommandBuffer(VkCommandBufferLevel level)
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to allocate command buffer.");
 
+	registerCommandBuffers(handle, queue->getQueueFamilyIndex(), &cmdBuffer, 1);
 	return cmdBuffer;
 }
 
@@ -55,18 +115,28 @@ vector<VkCommandBuffer> CommandPool::allocateCommandBuffers(uint32_t count,
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to allocate command buffers.");
 
+	registerCommandBuffers(handle, queue->getQueueFamilyIndex(), cmdBuffers.data(), count);
 	return cmdBuffers;
 }
 
 void CommandPool::freeCommandBuffer(VkCommandBuffer cmdBuffer)
 {
+	unregisterCommandBuffers(&cmdBuffer, 1);
 	vkFreeCommandBuffers(queue->getDevice(), handle, 1, &cmdBuffer);
 }
 
 void CommandPool::freeCommandBuffers(vector<VkCommandBuffer>& cmdBuffers)
 {
+	unregisterCommandBuffers(cmdBuffers.data(), static_cast<uint32_t>(cmdBuffers.size()));
 	vkFreeCommandBuffers(queue->getDevice(), handle, static_cast<uint32_t>(cmdBuffers.size()),
 			     cmdBuffers.data());
 }
 
+void CommandPool::reset()
+{
+	VkResult result = vkResetCommandPool(queue->getDevice(), handle, 0);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to reset command pool.");
+}
+
 }
\ No newline at end of file
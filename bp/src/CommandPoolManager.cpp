@@ -0,0 +1,175 @@
+#include <bp/CommandPoolManager.h>
+#include <bp/Fence.h>
+#include <bp/CommandPool.h>
+#include <bp/Util.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bp
+{
+
+CommandPoolManager::~CommandPoolManager()
+{
+	for (auto& p : pools)
+	{
+		CommandPool::unregisterPool(p.second->handle);
+		vkDestroyCommandPool(device, p.second->handle, nullptr);
+	}
+}
+
+void CommandPoolManager::init(VkDevice device)
+{
+	if (isReady()) throw runtime_error("Command pool manager already initialized.");
+	CommandPoolManager::device = device;
+}
+
+VkCommandBuffer CommandPoolManager::acquire(uint32_t queueFamilyIndex, VkCommandBufferLevel level)
+{
+	assertReady();
+	ThreadPool& pool = getThreadPool(queueFamilyIndex);
+
+	VkCommandBuffer cmdBuffer;
+	{
+		lock_guard<mutex> lock(pool.mutex);
+		vector<VkCommandBuffer>& available = pool.available[level];
+		if (!available.empty())
+		{
+			cmdBuffer = available.back();
+			available.pop_back();
+			pool.acquiredCount++;
+			return cmdBuffer;
+		}
+
+		VkCommandBufferAllocateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		info.commandPool = pool.handle;
+		info.level = level;
+		info.commandBufferCount = 1;
+
+		VkResult result = vkAllocateCommandBuffers(device, &info, &cmdBuffer);
+		if (result != VK_SUCCESS)
+			throw runtime_error("Failed to allocate command buffer.");
+		CommandPool::registerCommandBuffers(pool.handle, queueFamilyIndex, &cmdBuffer, 1);
+		pool.acquiredCount++;
+	}
+
+	lock_guard<mutex> lock(poolsMutex);
+	owners[cmdBuffer] = {&pool, level};
+	return cmdBuffer;
+}
+
+void CommandPoolManager::release(VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	Owner owner;
+	{
+		lock_guard<mutex> lock(poolsMutex);
+		auto it = owners.find(cmdBuffer);
+		if (it == owners.end())
+			throw invalid_argument("Command buffer was not acquired from this manager.");
+		owner = it->second;
+	}
+
+	ThreadPool& pool = *owner.pool;
+	lock_guard<mutex> lock(pool.mutex);
+	pool.released.push_back({cmdBuffer, owner.level});
+	if (--pool.acquiredCount > 0) return;
+
+	/*
+	 * Resetting the pool recycles the memory of all its command buffers at once, which is
+	 * cheaper than resetting or freeing them one by one.
+	 */
+	vkResetCommandPool(device, pool.handle, 0);
+	for (auto& r : pool.released)
+		pool.available[r.second].push_back(r.first);
+	pool.released.clear();
+}
+
+void CommandPoolManager::execute(Queue& queue, const function<void(VkCommandBuffer)>& commands)
+{
+	VkCommandBuffer cmdBuffer = acquire(queue.getQueueFamilyIndex());
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+	commands(cmdBuffer);
+	vkEndCommandBuffer(cmdBuffer);
+
+	Fence fence{device};
+	queue.submit({}, {cmdBuffer}, {}, fence);
+	fence.wait();
+	release(cmdBuffer);
+}
+
+CommandPoolManager::ThreadPool& CommandPoolManager::getThreadPool(uint32_t queueFamilyIndex)
+{
+	lock_guard<mutex> lock(poolsMutex);
+	auto key = make_pair(this_thread::get_id(), queueFamilyIndex);
+	auto found = pools.find(key);
+	if (found != pools.end())
+	{
+		/*
+		 * The id of an exited thread may be reused, and its pool then belongs to the new
+		 * thread.
+		 */
+		if (found->second->thread.expired()) found->second->thread = getThreadToken();
+		return *found->second;
+	}
+	destroyExitedPools();
+
+	VkCommandPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	info.queueFamilyIndex = queueFamilyIndex;
+
+	VkCommandPool handle;
+	VkResult result = vkCreateCommandPool(device, &info, nullptr, &handle);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to create command pool.");
+
+	unique_ptr<ThreadPool>& pool = pools[key];
+	pool.reset(new ThreadPool);
+	pool->handle = handle;
+	pool->thread = getThreadToken();
+	return *pool;
+}
+
+/*
+ * Called with poolsMutex locked. Pools with command buffers that are still acquired are kept
+ * until a later call, as the device may be executing them.
+ */
+void CommandPoolManager::destroyExitedPools()
+{
+	for (auto it = pools.begin(); it != pools.end();)
+	{
+		ThreadPool& pool = *it->second;
+		{
+			lock_guard<mutex> lock(pool.mutex);
+			if (!pool.thread.expired() || pool.acquiredCount > 0)
+			{
+				++it;
+				continue;
+			}
+			for (auto& available : pool.available)
+			{
+				for (VkCommandBuffer cmdBuffer : available)
+					owners.erase(cmdBuffer);
+			}
+			for (auto& r : pool.released)
+				owners.erase(r.first);
+		}
+
+		CommandPool::unregisterPool(pool.handle);
+		vkDestroyCommandPool(device, pool.handle, nullptr);
+		it = pools.erase(it);
+	}
+}
+
+void CommandPoolManager::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Command pool manager not ready. Must initialize before use.");
+}
+
+}
@@ -0,0 +1,303 @@
+#include <bp/CompressedImage.h>
+#include <bp/Util.h>
+#include <stdexcept>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cctype>
+
+using namespace std;
+
+namespace bp
+{
+
+static const uint32_t DDS_MAGIC = 0x20534444;
+static const size_t DDS_HEADER_SIZE = 128;
+static const size_t DDS_DX10_HEADER_SIZE = 20;
+static const uint32_t DDS_MIPMAPCOUNT_FLAG = 0x20000;
+static const uint32_t DDS_FOURCC_FLAG = 0x4;
+static const uint32_t DDS_CUBEMAP_FLAG = 0x200;
+static const uint32_t DDS_DIMENSION_TEXTURE2D = 3;
+static const uint32_t DDS_RESOURCE_MISC_TEXTURECUBE = 0x4;
+
+static const uint8_t KTX2_IDENTIFIER[12] = {
+	0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+static const size_t KTX2_HEADER_SIZE = 80;
+static const size_t KTX2_LEVEL_INDEX_ENTRY_SIZE = 24;
+
+static const VkDeviceSize LEVEL_ALIGNMENT = 16;
+
+struct ContainerInfo
+{
+	VkFormat format;
+	uint32_t width, height, levelCount;
+	vector<pair<uint64_t, uint64_t>> levels;
+};
+
+static uint32_t readU32(const uint8_t* p)
+{
+	uint32_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint64_t readU64(const uint8_t* p)
+{
+	uint64_t value;
+	memcpy(&value, p, sizeof(value));
+	return value;
+}
+
+static uint32_t fourCC(char a, char b, char c, char d)
+{
+	return static_cast<uint32_t>(a) | static_cast<uint32_t>(b) << 8
+	       | static_cast<uint32_t>(c) << 16 | static_cast<uint32_t>(d) << 24;
+}
+
+/*
+ * Size in bytes of a 4x4 block of a BCn format, or 0 if the format is not block compressed.
+ */
+static VkDeviceSize getBlockSize(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	case VK_FORMAT_BC4_UNORM_BLOCK:
+	case VK_FORMAT_BC4_SNORM_BLOCK:
+		return 8;
+	case VK_FORMAT_BC2_UNORM_BLOCK:
+	case VK_FORMAT_BC2_SRGB_BLOCK:
+	case VK_FORMAT_BC3_UNORM_BLOCK:
+	case VK_FORMAT_BC3_SRGB_BLOCK:
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+	case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+static VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+{
+	VkDeviceSize blocksX = max((width + 3) / 4, 1u);
+	VkDeviceSize blocksY = max((height + 3) / 4, 1u);
+	return blocksX * blocksY * getBlockSize(format);
+}
+
+static VkFormat getDxgiFormat(uint32_t dxgiFormat)
+{
+	switch (dxgiFormat)
+	{
+	case 71: return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	case 72: return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+	case 74: return VK_FORMAT_BC2_UNORM_BLOCK;
+	case 75: return VK_FORMAT_BC2_SRGB_BLOCK;
+	case 77: return VK_FORMAT_BC3_UNORM_BLOCK;
+	case 78: return VK_FORMAT_BC3_SRGB_BLOCK;
+	case 80: return VK_FORMAT_BC4_UNORM_BLOCK;
+	case 81: return VK_FORMAT_BC4_SNORM_BLOCK;
+	case 83: return VK_FORMAT_BC5_UNORM_BLOCK;
+	case 84: return VK_FORMAT_BC5_SNORM_BLOCK;
+	case 95: return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+	case 96: return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+	case 98: return VK_FORMAT_BC7_UNORM_BLOCK;
+	case 99: return VK_FORMAT_BC7_SRGB_BLOCK;
+	default: return VK_FORMAT_UNDEFINED;
+	}
+}
+
+static VkFormat getFourCCFormat(uint32_t code)
+{
+	if (code == fourCC('D', 'X', 'T', '1')) return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+	if (code == fourCC('D', 'X', 'T', '3')) return VK_FORMAT_BC2_UNORM_BLOCK;
+	if (code == fourCC('D', 'X', 'T', '5')) return VK_FORMAT_BC3_UNORM_BLOCK;
+	if (code == fourCC('A', 'T', 'I', '1')) return VK_FORMAT_BC4_UNORM_BLOCK;
+	if (code == fourCC('B', 'C', '4', 'U')) return VK_FORMAT_BC4_UNORM_BLOCK;
+	if (code == fourCC('A', 'T', 'I', '2')) return VK_FORMAT_BC5_UNORM_BLOCK;
+	if (code == fourCC('B', 'C', '5', 'U')) return VK_FORMAT_BC5_UNORM_BLOCK;
+	return VK_FORMAT_UNDEFINED;
+}
+
+static bool parseDds(const uint8_t* file, size_t size, ContainerInfo& info)
+{
+	if (size < DDS_HEADER_SIZE || readU32(file) != DDS_MAGIC) return false;
+	if (!(readU32(file + 80) & DDS_FOURCC_FLAG)) return false;
+	if (readU32(file + 112) & DDS_CUBEMAP_FLAG) return false;
+
+	size_t dataOffset = DDS_HEADER_SIZE;
+	uint32_t code = readU32(file + 84);
+	if (code == fourCC('D', 'X', '1', '0'))
+	{
+		if (size < DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE) return false;
+		/*
+		 * Only single 2D textures are supported, not cubemaps or arrays.
+		 */
+		if (readU32(file + 132) != DDS_DIMENSION_TEXTURE2D) return false;
+		if (readU32(file + 136) & DDS_RESOURCE_MISC_TEXTURECUBE) return false;
+		if (readU32(file + 140) > 1) return false;
+		info.format = getDxgiFormat(readU32(file + 128));
+		dataOffset += DDS_DX10_HEADER_SIZE;
+	} else
+	{
+		info.format = getFourCCFormat(code);
+	}
+	if (info.format == VK_FORMAT_UNDEFINED) return false;
+
+	info.height = readU32(file + 12);
+	info.width = readU32(file + 16);
+	info.levelCount = 1;
+	if (readU32(file + 8) & DDS_MIPMAPCOUNT_FLAG)
+		info.levelCount = max(readU32(file + 28), 1u);
+
+	uint64_t offset = dataOffset;
+	for (uint32_t i = 0; i < info.levelCount; i++)
+	{
+		uint64_t levelSize = getLevelSize(info.format, max(info.width >> i, 1u),
+						  max(info.height >> i, 1u));
+		info.levels.push_back({offset, levelSize});
+		offset += levelSize;
+	}
+	return true;
+}
+
+static bool parseKtx2(const uint8_t* file, size_t size, ContainerInfo& info)
+{
+	if (size < KTX2_HEADER_SIZE || memcmp(file, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)))
+		return false;
+
+	info.format = static_cast<VkFormat>(readU32(file + 12));
+	if (getBlockSize(info.format) == 0) return false;
+	info.width = readU32(file + 20);
+	info.height = readU32(file + 24);
+	if (readU32(file + 28) > 1 || readU32(file + 32) > 1 || readU32(file + 36) != 1)
+		return false;
+	if (readU32(file + 44) != 0) return false;
+	info.levelCount = max(readU32(file + 40), 1u);
+
+	if (size < KTX2_HEADER_SIZE + info.levelCount * KTX2_LEVEL_INDEX_ENTRY_SIZE) return true;
+	for (uint32_t i = 0; i < info.levelCount; i++)
+	{
+		const uint8_t* entry = file + KTX2_HEADER_SIZE + i * KTX2_LEVEL_INDEX_ENTRY_SIZE;
+		info.levels.push_back({readU64(entry), readU64(entry + 8)});
+	}
+	return true;
+}
+
+/*
+ * Parse the headers of a DDS or KTX2 file. The file offsets of the levels are left out if the
+ * given data is too short to contain them.
+ */
+static bool parseContainer(const uint8_t* file, size_t size, ContainerInfo& info)
+{
+	return parseKtx2(file, size, info) || parseDds(file, size, info);
+}
+
+void CompressedImage::load(const string& path)
+{
+	vector<char> file = readBinaryFile(path);
+	const uint8_t* fileData = reinterpret_cast<const uint8_t*>(file.data());
+
+	ContainerInfo info;
+	if (!parseContainer(fileData, file.size(), info))
+		throw runtime_error("Unsupported compressed image file \"" + path + "\".");
+	if (info.width == 0 || info.height == 0
+	    || info.levelCount > calculateMipLevels(info.width, info.height))
+		throw runtime_error("Invalid compressed image file \"" + path + "\".");
+
+	/*
+	 * Levels are stored largest first, each aligned so that it can be used as the buffer
+	 * offset of a copy.
+	 */
+	format = info.format;
+	width = info.width;
+	height = info.height;
+	levels.clear();
+	VkDeviceSize offset = 0;
+	for (uint32_t i = 0; i < info.levelCount; i++)
+	{
+		Level level;
+		level.width = max(width >> i, 1u);
+		level.height = max(height >> i, 1u);
+		level.size = getLevelSize(format, level.width, level.height);
+		level.offset = offset;
+		offset = (offset + level.size + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT
+			 * LEVEL_ALIGNMENT;
+		levels.push_back(level);
+	}
+
+	if (info.levels.size() < info.levelCount)
+		throw runtime_error("Truncated compressed image file \"" + path + "\".");
+
+	data.assign(offset, 0);
+	for (uint32_t i = 0; i < info.levelCount; i++)
+	{
+		auto& source = info.levels[i];
+		if (source.second < levels[i].size || source.first > file.size()
+		    || levels[i].size > file.size() - source.first)
+			throw runtime_error("Truncated compressed image file \"" + path + "\".");
+		memcpy(data.data() + levels[i].offset, fileData + source.first, levels[i].size);
+	}
+}
+
+VkFormat CompressedImage::queryFormat(const string& path)
+{
+	ifstream file(path, ios::binary);
+	if (!file.is_open()) return VK_FORMAT_UNDEFINED;
+
+	char header[DDS_HEADER_SIZE + DDS_DX10_HEADER_SIZE];
+	file.read(header, sizeof(header));
+
+	ContainerInfo info;
+	if (!parseContainer(reinterpret_cast<const uint8_t*>(header),
+			    static_cast<size_t>(file.gcount()), info))
+		return VK_FORMAT_UNDEFINED;
+	return info.format;
+}
+
+bool CompressedImage::isCompressedImagePath(const string& path)
+{
+	string::size_type dot = path.find_last_of('.');
+	if (dot == string::npos) return false;
+	string extension = path.substr(dot);
+	transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension == ".ktx2" || extension == ".dds";
+}
+
+string CompressedImage::findVariant(const string& path)
+{
+	string::size_type dot = path.find_last_of('.');
+	string::size_type slash = path.find_last_of("/\\");
+	string base = dot != string::npos && (slash == string::npos || dot > slash)
+		      ? path.substr(0, dot) : path;
+
+	for (const char* extension : {".ktx2", ".dds"})
+	{
+		string variant = base + extension;
+		if (variant != path && ifstream(variant).good()) return variant;
+	}
+	return "";
+}
+
+vector<VkBufferImageCopy> CompressedImage::getCopyRegions() const
+{
+	vector<VkBufferImageCopy> regions;
+	for (uint32_t i = 0; i < levels.size(); i++)
+	{
+		VkBufferImageCopy region = {};
+		region.bufferOffset = levels[i].offset;
+		region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+		region.imageExtent = {levels[i].width, levels[i].height, 1};
+		regions.push_back(region);
+	}
+	return regions;
+}
+
+}
@@ -13,11 +13,11 @@ void ComputePipeline::create()
 
 	VkComputePipelineCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-	info.stage = shaderStageInfos[0];
+	info.stage = getShaderStageInfos()[0];
 	info.layout = layout;
 
-	VkResult result = vkCreateComputePipelines(*device, VK_NULL_HANDLE, 1, &info, nullptr,
-						   &handle);
+	VkResult result = vkCreateComputePipelines(*device, device->getPipelineCache().getHandle(),
+						   1, &info, nullptr, &handle);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create compute pipeline.");
 }
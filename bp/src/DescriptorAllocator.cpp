@@ -0,0 +1,161 @@
+#include <bp/DescriptorAllocator.h>
+#include <stdexcept>
+#include <atomic>
+
+using namespace std;
+
+namespace bp
+{
+
+static atomic<uint64_t> nextAllocatorId{1};
+
+/*
+ * The pools of the allocator the calling thread used last, so that they are found without
+ * locking. Allocators are told apart by a unique ID, as an address may be reused.
+ */
+struct ThreadPoolsCache
+{
+	uint64_t allocatorId;
+	void* pools;
+};
+static thread_local ThreadPoolsCache threadPoolsCache = {0, nullptr};
+
+DescriptorAllocator::~DescriptorAllocator()
+{
+	if (!isReady()) return;
+	for (auto& t : threadPools)
+	{
+		for (auto& chain : t.second->frames)
+		{
+			for (VkDescriptorPool pool : chain.pools)
+				vkDestroyDescriptorPool(*device, pool, nullptr);
+		}
+	}
+}
+
+void DescriptorAllocator::init(Device& device, uint32_t frameCount, uint32_t setsPerPool,
+			       const vector<VkDescriptorPoolSize>& setSizes)
+{
+	if (isReady()) throw runtime_error("Descriptor allocator already initialized.");
+	if (frameCount == 0 || setsPerPool == 0)
+		throw invalid_argument("Frame count and sets per pool must be greater than zero.");
+	DescriptorAllocator::device = &device;
+	DescriptorAllocator::frameCount = frameCount;
+	DescriptorAllocator::setsPerPool = setsPerPool;
+	id = nextAllocatorId++;
+
+	vector<VkDescriptorPoolSize> sizes = setSizes;
+	if (sizes.empty())
+	{
+		sizes = {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2},
+			 {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2},
+			 {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+			 {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1},
+			 {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}};
+	}
+	poolSizes.clear();
+	for (auto& size : sizes)
+		poolSizes.push_back({size.type, size.descriptorCount * setsPerPool});
+}
+
+void DescriptorAllocator::beginFrame(uint32_t frameIndex)
+{
+	assertReady();
+	if (frameIndex >= frameCount) throw out_of_range("Invalid frame index.");
+	DescriptorAllocator::frameIndex = frameIndex;
+
+	lock_guard<mutex> lock(threadPoolsMutex);
+	for (auto& t : threadPools)
+	{
+		Chain& chain = t.second->frames[frameIndex];
+		for (size_t i = 0; i <= chain.current && i < chain.pools.size(); i++)
+			vkResetDescriptorPool(*device, chain.pools[i], 0);
+		chain.current = 0;
+	}
+}
+
+VkDescriptorSet DescriptorAllocator::allocate(VkDescriptorSetLayout layout)
+{
+	assertReady();
+	Chain& chain = getThreadPools().frames[frameIndex];
+
+	VkDescriptorSetAllocateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	info.descriptorSetCount = 1;
+	info.pSetLayouts = &layout;
+
+	/*
+	 * Depending on the driver, a full pool fails with out of pool memory or a fragmented
+	 * pool error, so any failure moves on to the next pool. Only a failure in a pool that has
+	 * not been allocated from is an error.
+	 */
+	bool fresh = false;
+	while (true)
+	{
+		if (chain.current == chain.pools.size())
+		{
+			chain.pools.push_back(createPool());
+			fresh = true;
+		}
+
+		VkDescriptorSet set;
+		info.descriptorPool = chain.pools[chain.current];
+		VkResult result = vkAllocateDescriptorSets(*device, &info, &set);
+		if (result == VK_SUCCESS) return set;
+		if (fresh || result == VK_ERROR_OUT_OF_HOST_MEMORY
+		    || result == VK_ERROR_OUT_OF_DEVICE_MEMORY)
+			throw runtime_error("Failed to allocate descriptor set.");
+		chain.current++;
+	}
+}
+
+size_t DescriptorAllocator::getPoolCount()
+{
+	lock_guard<mutex> lock(threadPoolsMutex);
+	size_t count = 0;
+	for (auto& t : threadPools)
+	{
+		for (auto& chain : t.second->frames)
+			count += chain.pools.size();
+	}
+	return count;
+}
+
+DescriptorAllocator::ThreadPools& DescriptorAllocator::getThreadPools()
+{
+	if (threadPoolsCache.allocatorId == id)
+		return *static_cast<ThreadPools*>(threadPoolsCache.pools);
+
+	lock_guard<mutex> lock(threadPoolsMutex);
+	unique_ptr<ThreadPools>& pools = threadPools[this_thread::get_id()];
+	if (!pools)
+	{
+		pools.reset(new ThreadPools);
+		pools->frames.resize(frameCount, Chain{{}, 0});
+	}
+	threadPoolsCache = {id, pools.get()};
+	return *pools;
+}
+
+VkDescriptorPool DescriptorAllocator::createPool()
+{
+	VkDescriptorPoolCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	info.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+	info.pPoolSizes = poolSizes.data();
+	info.maxSets = setsPerPool;
+
+	VkDescriptorPool pool;
+	VkResult result = vkCreateDescriptorPool(*device, &info, nullptr, &pool);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to create descriptor pool.");
+	return pool;
+}
+
+void DescriptorAllocator::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Descriptor allocator not ready. Must initialize before use.");
+}
+
+}
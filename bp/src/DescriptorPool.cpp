@@ -7,13 +7,13 @@ namespace bp
 {
 
 void DescriptorPool::init(Device& device, const std::vector<VkDescriptorPoolSize>& poolSizes,
-			  uint32_t maxSets)
+			  uint32_t maxSets, VkDescriptorPoolCreateFlags flags)
 {
 	if (isReady()) throw runtime_error("Descriptor pool is already initialized.");
 	this->device = &device;
 	VkDescriptorPoolCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-	info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+	info.flags = flags | VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
 	info.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	info.pPoolSizes = poolSizes.data();
 	info.maxSets = maxSets;
@@ -25,7 +25,7 @@ void DescriptorPool::init(Device& device, const std::vector<VkDescriptorPoolSize
 
 DescriptorPool::~DescriptorPool()
 {
-	vkDestroyDescriptorPool(*device, handle, nullptr);
+	if (isReady()) vkDestroyDescriptorPool(*device, handle, nullptr);
 }
 
 }
\ No newline at end of file
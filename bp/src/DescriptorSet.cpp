@@ -1,5 +1,6 @@
 #include <bp/DescriptorSet.h>
 #include <stdexcept>
+#include <cstring>
 #include <bp/ImageDescriptor.h>
 #include <bp/BufferDescriptor.h>
 
@@ -14,6 +15,7 @@ void DescriptorSet::init(Device& device, DescriptorPool& pool,
 	if (isReady()) throw runtime_error("Descriptor set already initialized.");
 	DescriptorSet::device = &device;
 	DescriptorSet::pool = &pool;
+	DescriptorSet::layout = layout;
 
 	VkDescriptorSetLayout layoutHandle = layout;
 
@@ -28,21 +30,118 @@ void DescriptorSet::init(Device& device, DescriptorPool& pool,
 		throw runtime_error("Failed to allocate descriptor set.");
 }
 
+void DescriptorSet::init(Device& device, DescriptorAllocator& allocator,
+			 DescriptorSetLayout& layout)
+{
+	if (isReady()) throw runtime_error("Descriptor set already initialized.");
+	DescriptorSet::device = &device;
+	DescriptorSet::layout = layout;
+	handle = allocator.allocate(layout);
+}
+
+void DescriptorSet::init(Device& device, DescriptorSetLayout& layout,
+			 VkPipelineLayout pipelineLayout, uint32_t set, VkPipelineBindPoint bindPoint)
+{
+	if (isReady()) throw runtime_error("Descriptor set already initialized.");
+	if (!layout.isPushDescriptorsEnabled())
+		throw invalid_argument("Descriptor set layout must have push descriptors enabled.");
+	DescriptorSet::device = &device;
+	DescriptorSet::layout = layout;
+	templatePipelineLayout = pipelineLayout;
+	templateSet = set;
+	templateBindPoint = bindPoint;
+	createPushTemplate();
+}
+
 DescriptorSet::~DescriptorSet()
 {
-	vkFreeDescriptorSets(*device, *pool, 1, &handle);
+	destroyUpdateTemplate();
+	if (handle != VK_NULL_HANDLE && pool != nullptr)
+		vkFreeDescriptorSets(*device, *pool, 1, &handle);
 }
 
 void DescriptorSet::bind(const Descriptor& descriptor)
 {
 	descriptors.push_back(&descriptor);
+	destroyUpdateTemplate();
+	if (isPushSet()) createPushTemplate();
 }
 
 void DescriptorSet::update()
 {
+	if (isPushSet())
+	{
+		if (!isTemplateValid()) createPushTemplate();
+		return;
+	}
+	if (descriptors.empty()) return;
+
+	const DeviceFunctions& functions = device->getFunctions();
+	if (functions.updateDescriptorSetWithTemplate != nullptr)
+	{
+		if (!isTemplateValid()) createUpdateTemplate();
+		if (templateEntries.empty()) return;
+		packTemplateData(templateData.data());
+		functions.updateDescriptorSetWithTemplate(*device, handle, updateTemplate,
+							  templateData.data());
+		return;
+	}
+
+	auto writes = getWrites();
+	vkUpdateDescriptorSets(*device, static_cast<uint32_t>(writes.size()),
+			       writes.data(), 0, nullptr);
+}
+
+void DescriptorSet::update(const Descriptor& descriptor)
+{
+	if (isPushSet() || descriptor.getInfoCount() == 0) return;
+	VkWriteDescriptorSet write = descriptor.getWriteInfo();
+	write.dstSet = handle;
+	vkUpdateDescriptorSets(*device, 1, &write, 0, nullptr);
+}
+
+void DescriptorSet::bind(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout,
+			 uint32_t set, VkPipelineBindPoint bindPoint)
+{
+	if (isPushSet())
+	{
+		push(cmdBuffer, pipelineLayout, set, bindPoint);
+		return;
+	}
+	vkCmdBindDescriptorSets(cmdBuffer, bindPoint, pipelineLayout, set, 1, &handle, 0, nullptr);
+}
+
+void DescriptorSet::push(VkCommandBuffer cmdBuffer, VkPipelineLayout pipelineLayout,
+			 uint32_t set, VkPipelineBindPoint bindPoint)
+{
+	const DeviceFunctions& functions = device->getFunctions();
+	if (functions.cmdPushDescriptorSet == nullptr)
+		throw runtime_error("Push descriptors are not enabled on the device.");
 	if (descriptors.empty()) return;
 
-	std::vector<VkWriteDescriptorSet> writes;
+	/*
+	 * The template is only read here, and the infos are packed into a blob of the calling
+	 * thread, so pushing the set from several recording threads is safe.
+	 */
+	if (updateTemplate != VK_NULL_HANDLE && templatePipelineLayout == pipelineLayout
+	    && templateSet == set && templateBindPoint == bindPoint && isTemplateValid())
+	{
+		static thread_local vector<uint8_t> data;
+		data.resize(templateDataSize);
+		packTemplateData(data.data());
+		functions.cmdPushDescriptorSetWithTemplate(cmdBuffer, updateTemplate, pipelineLayout,
+							   set, data.data());
+		return;
+	}
+
+	auto writes = getWrites();
+	functions.cmdPushDescriptorSet(cmdBuffer, bindPoint, pipelineLayout, set,
+				       static_cast<uint32_t>(writes.size()), writes.data());
+}
+
+vector<VkWriteDescriptorSet> DescriptorSet::getWrites()
+{
+	vector<VkWriteDescriptorSet> writes;
 	writes.reserve(descriptors.size());
 	for (auto d : descriptors)
 	{
@@ -50,10 +149,107 @@ void DescriptorSet::update()
 		write.dstSet = handle;
 		writes.push_back(write);
 	}
+	return writes;
+}
 
-	vkUpdateDescriptorSets(*device, static_cast<uint32_t>(writes.size()),
-			       writes.data(), 0, nullptr);
-	writes.clear();
+void DescriptorSet::packTemplateData(uint8_t* data) const
+{
+	for (size_t i = 0; i < templateDescriptors.size(); i++)
+	{
+		const Descriptor* d = templateDescriptors[i];
+		memcpy(data + templateEntries[i].offset, d->getInfoData(),
+		       d->getInfoCount() * d->getInfoStride());
+	}
+}
+
+bool DescriptorSet::isTemplateValid() const
+{
+	size_t i = 0;
+	for (auto d : descriptors)
+	{
+		if (d->getInfoCount() == 0) continue;
+		if (i == templateEntries.size() || templateDescriptors[i] != d) return false;
+		const VkDescriptorUpdateTemplateEntry& entry = templateEntries[i++];
+		if (d->getInfoCount() != entry.descriptorCount || d->getType() != entry.descriptorType
+		    || d->getBinding() != entry.dstBinding
+		    || d->getFirstIndex() != entry.dstArrayElement)
+			return false;
+	}
+	return i == templateEntries.size() && (i == 0 || updateTemplate != VK_NULL_HANDLE);
 }
 
-}
\ No newline at end of file
+/*
+ * Descriptors without infos are left out, as template entries must have at least one
+ * descriptor. The infos of each descriptor are packed one after another in the blob.
+ */
+void DescriptorSet::createUpdateTemplate()
+{
+	destroyUpdateTemplate();
+
+	size_t offset = 0;
+	for (auto d : descriptors)
+	{
+		if (d->getInfoCount() == 0) continue;
+		VkDescriptorUpdateTemplateEntry entry = {};
+		entry.dstBinding = d->getBinding();
+		entry.dstArrayElement = d->getFirstIndex();
+		entry.descriptorCount = d->getInfoCount();
+		entry.descriptorType = d->getType();
+		entry.offset = offset;
+		entry.stride = d->getInfoStride();
+		templateEntries.push_back(entry);
+		templateDescriptors.push_back(d);
+		offset += d->getInfoCount() * d->getInfoStride();
+	}
+	templateDataSize = offset;
+	if (!isPushSet()) templateData.resize(offset);
+	if (templateEntries.empty()) return;
+
+	VkDescriptorUpdateTemplateCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO_KHR;
+	info.descriptorUpdateEntryCount = static_cast<uint32_t>(templateEntries.size());
+	info.pDescriptorUpdateEntries = templateEntries.data();
+	if (isPushSet())
+	{
+		info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_PUSH_DESCRIPTORS_KHR;
+		info.pipelineBindPoint = templateBindPoint;
+		info.pipelineLayout = templatePipelineLayout;
+		info.set = templateSet;
+	} else
+	{
+		info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET_KHR;
+	}
+	info.descriptorSetLayout = layout;
+
+	VkResult result = device->getFunctions().createDescriptorUpdateTemplate(*device, &info,
+										 nullptr,
+										 &updateTemplate);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to create descriptor update template.");
+}
+
+/*
+ * Push templates are only created when the pipeline layout they are made for is known, and
+ * outside of push, which must not modify the set.
+ */
+void DescriptorSet::createPushTemplate()
+{
+	if (templatePipelineLayout == VK_NULL_HANDLE
+	    || device->getFunctions().cmdPushDescriptorSetWithTemplate == nullptr)
+		return;
+	createUpdateTemplate();
+}
+
+void DescriptorSet::destroyUpdateTemplate()
+{
+	if (updateTemplate != VK_NULL_HANDLE)
+	{
+		device->getFunctions().destroyDescriptorUpdateTemplate(*device, updateTemplate,
+									nullptr);
+		updateTemplate = VK_NULL_HANDLE;
+	}
+	templateEntries.clear();
+	templateDescriptors.clear();
+}
+
+}
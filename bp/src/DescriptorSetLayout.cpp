@@ -10,11 +10,26 @@ void DescriptorSetLayout::addLayoutBinding(const VkDescriptorSetLayoutBinding& b
 {
 	if (isReady()) throw runtime_error("Descriptor set layout already initialized.");
 	bindings.push_back(binding);
+	if (!bindingFlags.empty()) bindingFlags.push_back(0);
+}
+
+void DescriptorSetLayout::addLayoutBinding(const VkDescriptorSetLayoutBinding& binding,
+					   VkDescriptorBindingFlagsEXT flags)
+{
+	if (isReady()) throw runtime_error("Descriptor set layout already initialized.");
+	bindingFlags.resize(bindings.size(), 0);
+	bindings.push_back(binding);
+	bindingFlags.push_back(flags);
 }
 
 void DescriptorSetLayout::init(Device& device, VkDescriptorSetLayoutCreateFlags createFlags)
 {
 	if (isReady()) throw runtime_error("Descriptor set layout already initialized.");
+	for (auto flags : bindingFlags)
+	{
+		if (flags & VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT)
+			createFlags |= VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT;
+	}
 	DescriptorSetLayout::device = &device;
 	DescriptorSetLayout::createFlags = createFlags;
 
@@ -24,6 +39,17 @@ void DescriptorSetLayout::init(Device& device, VkDescriptorSetLayoutCreateFlags
 	info.bindingCount = static_cast<uint32_t>(bindings.size());
 	info.pBindings = bindings.data();
 
+	VkDescriptorSetLayoutBindingFlagsCreateInfoEXT flagsInfo = {};
+	if (!bindingFlags.empty())
+	{
+		bindingFlags.resize(bindings.size(), 0);
+		flagsInfo.sType =
+			VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT;
+		flagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+		flagsInfo.pBindingFlags = bindingFlags.data();
+		info.pNext = &flagsInfo;
+	}
+
 	VkResult result = vkCreateDescriptorSetLayout(device, &info, nullptr, &handle);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create descriptor set layout.");
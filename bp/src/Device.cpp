@@ -1,4 +1,7 @@
 #include <bp/Device.h>
+#include <bp/UploadContext.h>
+#include <bp/StagingRing.h>
+#include <bp/ShaderCompiler.h>
 #include <bp/Util.h>
 #include <stdexcept>
 #include <cstring>
@@ -97,13 +100,11 @@ void Device::init(const Instance& instance, const DeviceRequirements& requiremen
 	auto result = queryDevices(instance, requirements);
 	if (result.empty())
 		throw runtime_error("No suitable physical device found.");
-	physical = result[0];
-
-	createLogicalDevice(requirements);
-	createQueues();
+	init(result[0], requirements, instance.getHandle(), instance.getApiVersion());
 }
 
-void Device::init(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements)
+void Device::init(VkPhysicalDevice physicalDevice, const DeviceRequirements& requirements,
+		  VkInstance instance, uint32_t instanceApiVersion)
 {
 	if (physicalDevice == VK_NULL_HANDLE)
 		throw invalid_argument("Physical device must be a valid handle.");
@@ -111,9 +112,18 @@ void Device::init(VkPhysicalDevice physicalDevice, const DeviceRequirements& req
 	bool suitable = queryDevice(physicalDevice, requirements);
 	if (!suitable)
 		throw runtime_error("Given physical device is not suitable.");
+	Device::instance = instance;
+	Device::instanceApiVersion = instanceApiVersion;
 	physical = physicalDevice;
 	vkGetPhysicalDeviceProperties(physical, &properties);
 
+	uint32_t familyCount = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, nullptr);
+	vector<VkQueueFamilyProperties> families(familyCount);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical, &familyCount, families.data());
+	queueFamilyFlags.clear();
+	for (auto& f : families) queueFamilyFlags.push_back(f.queueFlags);
+
 	try
 	{
 		createLogicalDevice(requirements);
@@ -134,6 +144,12 @@ void Device::init(VkPhysicalDevice physicalDevice, const DeviceRequirements& req
 
 Device::~Device()
 {
+	retireQueue.flush();
+	delete uploadContext;
+	delete stagingRing;
+	delete shaderCompiler;
+	delete cmdPoolManager;
+	delete pipelineCache;
 	queues.clear();
 	delete allocator;
 	vkDestroyDevice(logical, nullptr);
@@ -147,6 +163,86 @@ Queue& Device::getQueue(uint32_t index)
 	return queues[index];
 }
 
+UploadContext& Device::getUploadContext()
+{
+	assertReady();
+	lock_guard<mutex> lock(uploadContextMutex);
+	if (uploadContext != nullptr) return *uploadContext;
+
+	/*
+	 * Uploaded resources are mostly used on the graphics queue, so ownership is handed over to
+	 * it when the transfer queue is of a dedicated family.
+	 */
+	Queue& transferQueue = getTransferQueue();
+	Queue* dstQueue = &transferQueue;
+	for (auto i = 0; i < getQueueCount(); i++)
+	{
+		if (queueInfos[i].flags & VK_QUEUE_GRAPHICS_BIT)
+		{
+			dstQueue = &queues[i];
+			break;
+		}
+	}
+
+	uploadContext = new UploadContext(*this, transferQueue, *dstQueue);
+	return *uploadContext;
+}
+
+StagingRing& Device::getStagingRing()
+{
+	assertReady();
+	lock_guard<mutex> lock(stagingRingMutex);
+	if (stagingRing == nullptr)
+		stagingRing = new StagingRing(*this, stagingRingSize);
+	return *stagingRing;
+}
+
+void Device::setStagingRingSize(VkDeviceSize size)
+{
+	lock_guard<mutex> lock(stagingRingMutex);
+	if (stagingRing != nullptr)
+		throw runtime_error("Staging ring size must be set before the ring is used.");
+	stagingRingSize = size;
+}
+
+ShaderCompiler& Device::getShaderCompiler()
+{
+	lock_guard<mutex> lock(shaderCompilerMutex);
+	if (shaderCompiler == nullptr) shaderCompiler = new ShaderCompiler();
+	return *shaderCompiler;
+}
+
+VkPipelineStageFlags Device::getSupportedStages(uint32_t queueFamilyIndex) const
+{
+	if (queueFamilyIndex >= queueFamilyFlags.size()) return ~VkPipelineStageFlags{0};
+
+	VkQueueFlags flags = queueFamilyFlags[queueFamilyIndex];
+	VkPipelineStageFlags stages = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+				      | VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+				      | VK_PIPELINE_STAGE_HOST_BIT
+				      | VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+	if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT))
+		stages |= VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+		stages |= VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+	if (flags & VK_QUEUE_COMPUTE_BIT)
+		stages |= VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	if (flags & VK_QUEUE_GRAPHICS_BIT)
+	{
+		stages |= VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			  | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT
+			  | VK_PIPELINE_STAGE_TESSELLATION_CONTROL_SHADER_BIT
+			  | VK_PIPELINE_STAGE_TESSELLATION_EVALUATION_SHADER_BIT
+			  | VK_PIPELINE_STAGE_GEOMETRY_SHADER_BIT
+			  | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT
+			  | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+			  | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT
+			  | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT
+			  | VK_PIPELINE_STAGE_ALL_GRAPHICS_BIT;
+	}
+	return stages;
+}
+
 Queue& Device::getGraphicsQueue()
 {
 	assertReady();
@@ -195,12 +291,100 @@ void Device::createLogicalDevice(const DeviceRequirements& requirements)
 	info.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
 	info.ppEnabledExtensionNames = enabledExtensions.data();
 	info.pEnabledFeatures = &requirements.features;
+	info.pNext = requirements.next;
 
 	VkResult result = vkCreateDevice(physical, &info, nullptr, &logical);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create logical device.");
 
-	allocator = new MemoryAllocator(physical, logical);
+	extensions.assign(requirements.extensions.begin(), requirements.extensions.end());
+	loadFunctions();
+
+	auto next = static_cast<const VkBaseInStructure*>(requirements.next);
+	for (; next != nullptr; next = next->pNext)
+	{
+		if (next->sType != VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES_EXT)
+			continue;
+		descriptorIndexingFeatures =
+			*reinterpret_cast<const VkPhysicalDeviceDescriptorIndexingFeaturesEXT*>(next);
+		descriptorIndexingFeatures.pNext = nullptr;
+	}
+
+	bool memoryBudget = false;
+#ifdef VK_EXT_memory_budget
+	for (auto ext : requirements.extensions)
+		if (strcmp(ext, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) memoryBudget = true;
+#endif
+
+	allocator = new MemoryAllocator(physical, logical, memoryBudget, instance,
+					instanceApiVersion);
+	cmdPoolManager = new CommandPoolManager(logical);
+	pipelineCache = new PipelineCache(physical, logical);
+}
+
+template <typename T>
+static T getFunction(VkDevice device, const char* name)
+{
+	return reinterpret_cast<T>(vkGetDeviceProcAddr(device, name));
+}
+
+void Device::loadFunctions()
+{
+	functions = DeviceFunctions{};
+	if (isExtensionEnabled(VK_KHR_DESCRIPTOR_UPDATE_TEMPLATE_EXTENSION_NAME))
+	{
+		functions.createDescriptorUpdateTemplate =
+			getFunction<PFN_vkCreateDescriptorUpdateTemplateKHR>(
+				logical, "vkCreateDescriptorUpdateTemplateKHR");
+		functions.destroyDescriptorUpdateTemplate =
+			getFunction<PFN_vkDestroyDescriptorUpdateTemplateKHR>(
+				logical, "vkDestroyDescriptorUpdateTemplateKHR");
+		functions.updateDescriptorSetWithTemplate =
+			getFunction<PFN_vkUpdateDescriptorSetWithTemplateKHR>(
+				logical, "vkUpdateDescriptorSetWithTemplateKHR");
+	}
+	if (isExtensionEnabled(VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME))
+	{
+		functions.cmdPushDescriptorSet = getFunction<PFN_vkCmdPushDescriptorSetKHR>(
+			logical, "vkCmdPushDescriptorSetKHR");
+		if (functions.createDescriptorUpdateTemplate != nullptr)
+			functions.cmdPushDescriptorSetWithTemplate =
+				getFunction<PFN_vkCmdPushDescriptorSetWithTemplateKHR>(
+					logical, "vkCmdPushDescriptorSetWithTemplateKHR");
+	}
+#ifdef VK_KHR_synchronization2
+	if (isExtensionEnabled(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME))
+	{
+		functions.cmdPipelineBarrier2 = getFunction<PFN_vkCmdPipelineBarrier2KHR>(
+			logical, "vkCmdPipelineBarrier2KHR");
+	}
+#endif
+}
+
+bool Device::isExtensionEnabled(const string& name) const
+{
+	for (auto& extension : extensions)
+		if (extension == name) return true;
+	return false;
+}
+
+unsigned Device::addDestroyListener(const function<void(uint64_t)>& listener)
+{
+	lock_guard<mutex> lock(destroyListenersMutex);
+	destroyListeners[nextDestroyListener] = listener;
+	return nextDestroyListener++;
+}
+
+void Device::removeDestroyListener(unsigned id)
+{
+	lock_guard<mutex> lock(destroyListenersMutex);
+	destroyListeners.erase(id);
+}
+
+void Device::notifyDestroyed(uint64_t handle)
+{
+	lock_guard<mutex> lock(destroyListenersMutex);
+	for (auto& listener : destroyListeners) listener.second(handle);
 }
 
 void Device::createQueues()
@@ -11,10 +11,11 @@ Fence::~Fence()
 	if (isReady()) vkDestroyFence(device, handle, nullptr);
 }
 
-void Fence::init(VkDevice device)
+void Fence::init(VkDevice device, VkFenceCreateFlags flags)
 {
 	VkFenceCreateInfo info = {};
 	info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	info.flags = flags;
 
 	VkResult result = vkCreateFence(device, &info, nullptr, &handle);
 	if (result != VK_SUCCESS)
@@ -34,4 +35,9 @@ bool Fence::wait(uint64_t timeout)
 	return result == VK_TIMEOUT;
 }
 
+bool Fence::isSignaled()
+{
+	return vkGetFenceStatus(device, handle) == VK_SUCCESS;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,82 @@
+#include <bp/FrameArena.h>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+namespace bp
+{
+
+void FrameArena::init(Device& device, VkDeviceSize frameSize, uint32_t frameCount,
+		      VkBufferUsageFlags usage)
+{
+	if (isReady()) throw runtime_error("Frame arena already initialized.");
+	if (frameCount == 0) throw invalid_argument("Frame arena needs at least one frame.");
+
+	const VkPhysicalDeviceLimits& limits = device.getProperties().limits;
+	alignment = 4;
+	if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+		alignment = max(alignment, limits.minUniformBufferOffsetAlignment);
+	if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+		alignment = max(alignment, limits.minStorageBufferOffsetAlignment);
+	if (usage & (VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT
+		     | VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT))
+		alignment = max(alignment, limits.minTexelBufferOffsetAlignment);
+
+	buffers.resize(frameCount);
+	for (Buffer& buffer : buffers)
+		buffer.init(device, frameSize, usage, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryPool::FRAME);
+
+	FrameArena::device = &device;
+	FrameArena::frameSize = frameSize;
+	FrameArena::usage = usage;
+	frameIndex = 0;
+	offset = 0;
+}
+
+void FrameArena::beginFrame(uint32_t frameIndex, Fence* frameFence)
+{
+	assertReady();
+	if (frameIndex >= buffers.size())
+		throw out_of_range("Invalid frame index.");
+
+	/*
+	 * The memory of the frame can only be reused when the device is done reading from it.
+	 */
+	if (frameFence != nullptr) frameFence->wait();
+
+	FrameArena::frameIndex = frameIndex;
+	offset = 0;
+}
+
+FrameArena::Allocation FrameArena::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	assertReady();
+	if (alignment < FrameArena::alignment) alignment = FrameArena::alignment;
+
+	VkDeviceSize current = offset.load();
+	VkDeviceSize aligned;
+	do
+	{
+		aligned = (current + alignment - 1) / alignment * alignment;
+		if (aligned + size > frameSize)
+			throw runtime_error("Frame arena is out of memory.");
+	} while (!offset.compare_exchange_weak(current, aligned + size));
+
+	Buffer& buffer = buffers[frameIndex];
+	return {buffer.getHandle(), aligned, buffer.map() + aligned};
+}
+
+void FrameArena::flush()
+{
+	assertReady();
+	buffers[frameIndex].flushMapped();
+}
+
+void FrameArena::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Frame arena not ready. Must initialize before use.");
+}
+
+}
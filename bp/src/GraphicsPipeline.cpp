@@ -8,6 +8,8 @@ namespace bp
 
 void GraphicsPipeline::create()
 {
+	vector<VkPipelineShaderStageCreateInfo> stageInfos = getShaderStageInfos();
+
 	VkPipelineVertexInputStateCreateInfo vertexInputStateCreateInfo = {};
 	vertexInputStateCreateInfo.sType =
 		VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -117,8 +119,8 @@ void GraphicsPipeline::create()
 
 	VkGraphicsPipelineCreateInfo pipelineCreateInfo = {};
 	pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
-	pipelineCreateInfo.stageCount = static_cast<uint32_t>(shaderStageInfos.size());
-	pipelineCreateInfo.pStages = shaderStageInfos.data();
+	pipelineCreateInfo.stageCount = static_cast<uint32_t>(stageInfos.size());
+	pipelineCreateInfo.pStages = stageInfos.data();
 	pipelineCreateInfo.pVertexInputState = &vertexInputStateCreateInfo;
 	pipelineCreateInfo.pInputAssemblyState = &inputAssemblyStateCreateInfo;
 	pipelineCreateInfo.pTessellationState = nullptr;
@@ -130,12 +132,13 @@ void GraphicsPipeline::create()
 	pipelineCreateInfo.pDynamicState = &dynamicStateCreateInfo;
 	pipelineCreateInfo.layout = layout;
 	pipelineCreateInfo.renderPass = *renderPass;
-	pipelineCreateInfo.subpass = 0;
+	pipelineCreateInfo.subpass = subpass;
 	pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
 	pipelineCreateInfo.basePipelineIndex = 0;
 
-	VkResult result = vkCreateGraphicsPipelines(*device, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
-						    nullptr, &handle);
+	VkResult result = vkCreateGraphicsPipelines(*device,
+						    device->getPipelineCache().getHandle(), 1,
+						    &pipelineCreateInfo, nullptr, &handle);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create graphics pipeline.");
 }
@@ -1,7 +1,10 @@
 #include <bp/Image.h>
 #include <bp/Buffer.h>
+#include <bp/UploadContext.h>
 #include <stdexcept>
 #include <bp/Util.h>
+#include <algorithm>
+#include <vector>
 
 using namespace std;
 
@@ -10,39 +13,70 @@ namespace bp
 
 void Image::init(Device& device, uint32_t width, uint32_t height, VkFormat format,
 		 VkImageTiling tiling, VkImageUsageFlags usage, VmaMemoryUsage memoryUsage,
-		 VkImageLayout initialLayout)
+		 VkImageLayout initialLayout, uint32_t mipLevels, MemoryPool memoryPool)
 {
 	if (isReady()) throw runtime_error("Image already initialized.");
+	setup(device, width, height, format, tiling, usage, initialLayout, mipLevels);
 
-	usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	VkImageCreateInfo info = createInfo(initialLayout);
+	auto allocation = device.getMemoryAllocator().createImage(info, memoryUsage, handle,
+								  memoryPool);
+	memory = allocation;
+	memorySize = allocation->getSize();
+}
 
-	Image::device = &device;
-	Image::width = width;
-	Image::height = height;
-	Image::format = format;
-	Image::tiling = tiling;
-	Image::usage = usage;
-	Image::layout = initialLayout;
+void Image::init(Device& device, uint32_t width, uint32_t height, VkFormat format,
+		 VkImageTiling tiling, VkImageUsageFlags usage,
+		 const shared_ptr<Allocation>& memory, VkDeviceSize offset,
+		 VkImageLayout initialLayout, uint32_t mipLevels)
+{
+	if (isReady()) throw runtime_error("Image already initialized.");
+	if (memory->isMapped())
+		throw invalid_argument("Images can not be bound to mapped memory.");
+	setup(device, width, height, format, tiling, usage, initialLayout, mipLevels);
+
+	VkImageCreateInfo info = createInfo(initialLayout);
+	VkResult result = vkCreateImage(device, &info, nullptr, &handle);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to create image.");
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, handle, &requirements);
+	if (offset % requirements.alignment != 0 || offset + requirements.size > memory->getSize()
+	    || !(requirements.memoryTypeBits & (1u << memory->getMemoryType())))
+	{
+		vkDestroyImage(device, handle, nullptr);
+		handle = VK_NULL_HANDLE;
+		throw invalid_argument("Image does not fit in the given memory.");
+	}
 
-	VkImageCreateInfo info = {};
-	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	info.imageType = VK_IMAGE_TYPE_2D;
-	info.extent.width = width;
-	info.extent.height = height;
-	info.extent.depth = 1;
-	info.mipLevels = 1;
-	info.arrayLayers = 1;
-	info.format = format;
-	info.tiling = tiling;
-	info.initialLayout = layout;
-	info.usage = usage;
-	info.samples = VK_SAMPLE_COUNT_1_BIT;
-	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	result = vkBindImageMemory(device, handle, memory->getDeviceMemory(),
+				   memory->getOffset() + offset);
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(device, handle, nullptr);
+		handle = VK_NULL_HANDLE;
+		throw runtime_error("Failed to bind image memory.");
+	}
 
-	memory = device.getMemoryAllocator().createImage(info, memoryUsage, handle);
+	Image::memory = memory;
+	memorySize = requirements.size;
+}
 
-	transferCmdPool.init(device.getTransferQueue(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-	graphicsCmdPool.init(device.getGraphicsQueue(), VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+VkMemoryRequirements Image::getMemoryRequirements(Device& device, uint32_t width,
+						  uint32_t height, VkFormat format,
+						  VkImageTiling tiling, VkImageUsageFlags usage,
+						  uint32_t mipLevels)
+{
+	VkImageCreateInfo info = createInfo(width, height, format, tiling, getImageUsage(usage),
+					    VK_IMAGE_LAYOUT_UNDEFINED, mipLevels);
+	VkImage image;
+	VkResult result = vkCreateImage(device, &info, nullptr, &image);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to create image.");
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(device, image, &requirements);
+	vkDestroyImage(device, image, nullptr);
+	return requirements;
 }
 
 Image::~Image()
@@ -95,59 +129,177 @@ void Image::transition(VkImageLayout dstLayout, VkAccessFlags dstAccess,
 		       VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer)
 {
 	assertReady();
-	if (dstLayout == layout) return;
+	bool transitioned = true;
+	for (auto& state : levelStates)
+		if (state.layout != dstLayout) transitioned = false;
+	if (transitioned) return;
 
-	bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-	if (useOwnBuffer)
+	if (cmdBuffer == VK_NULL_HANDLE)
 	{
-		cmdBuffer = graphicsCmdPool.allocateCommandBuffer();
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+		device->getCommandPoolManager().execute(
+			device->getGraphicsQueue(), [&](VkCommandBuffer cmdBuffer) {
+				transition(dstLayout, dstAccess, dstStage, cmdBuffer);
+			});
+		return;
 	}
 
-	VkImageMemoryBarrier barrier = {};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = layout;
-	barrier.newLayout = dstLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = handle;
-	barrier.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-	barrier.srcAccessMask = accessFlags;
-	barrier.dstAccessMask = dstAccess;
+	BarrierBatch batch(*device);
+	transition(dstLayout, dstAccess, dstStage, batch);
+	batch.record(cmdBuffer);
+}
+
+void Image::transition(VkImageLayout dstLayout, VkAccessFlags dstAccess,
+		       VkPipelineStageFlags dstStage, BarrierBatch& batch)
+{
+	assertReady();
+	for (auto& run : getLevelRuns())
+	{
+		if (levelStates[run.first].layout == dstLayout) continue;
+		batch.addImageBarrier(createBarrier(run.first, run.second, dstLayout, dstAccess),
+				      levelStates[run.first].stage, dstStage);
+		setLevelStates(run.first, run.second, dstLayout, dstAccess, dstStage);
+	}
+}
+
+void Image::transitionMipLevels(uint32_t baseMipLevel, uint32_t levelCount,
+				VkImageLayout srcLayout, VkImageLayout dstLayout,
+				VkAccessFlags srcAccess, VkAccessFlags dstAccess,
+				VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage,
+				VkCommandBuffer cmdBuffer, uint32_t srcQueueFamilyIndex,
+				uint32_t dstQueueFamilyIndex)
+{
+	assertReady();
+	VkImageMemoryBarrier barrier = createBarrier(baseMipLevel, levelCount, srcLayout, dstLayout,
+						     srcAccess, dstAccess);
+	barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+	barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
 
-	if (format == VK_FORMAT_D16_UNORM)
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	BarrierBatch batch(*device);
+	batch.addImageBarrier(barrier, srcStage, dstStage);
+	batch.record(cmdBuffer);
 
-	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStage, 0, 0, nullptr,
-			     0, nullptr, 1, &barrier);
+	setLevelStates(baseMipLevel, levelCount, dstLayout, dstAccess, dstStage);
+}
 
-	if (useOwnBuffer)
+/*
+ * The release has no destination stage or access, as they are ignored on the source queue.
+ */
+void Image::releaseOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			     VkImageLayout dstLayout, VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	BarrierBatch batch(*device);
+	for (auto& run : getLevelRuns())
 	{
-		vkEndCommandBuffer(cmdBuffer);
-		Queue& queue = device->getGraphicsQueue();
-		queue.submit({}, {cmdBuffer}, {});
-		queue.waitIdle();
-		graphicsCmdPool.freeCommandBuffer(cmdBuffer);
+		VkImageMemoryBarrier barrier = createBarrier(run.first, run.second, dstLayout, 0);
+		barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		batch.addImageBarrier(barrier, levelStates[run.first].stage, 0);
 	}
+	batch.record(cmdBuffer);
+}
 
-	layout = dstLayout;
-	accessFlags = dstAccess;
+/*
+ * The barriers must match the ones of the release, so they are created from the same tracked
+ * state, which the release left untouched.
+ */
+void Image::acquireOwnership(uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex,
+			     VkImageLayout dstLayout, VkAccessFlags dstAccess,
+			     VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	BarrierBatch batch(*device);
+	for (auto& run : getLevelRuns())
+	{
+		VkImageMemoryBarrier barrier = createBarrier(run.first, run.second, dstLayout,
+							     dstAccess);
+		barrier.srcQueueFamilyIndex = srcQueueFamilyIndex;
+		barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+		barrier.srcAccessMask = 0;
+		batch.addImageBarrier(barrier, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, dstStage);
+	}
+	batch.record(cmdBuffer);
+
+	setLevelStates(0, mipLevels, dstLayout, dstAccess, dstStage);
+}
+
+void Image::generateMipmaps(VkImageLayout dstLayout, VkAccessFlags dstAccess,
+			    VkPipelineStageFlags dstStage, VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	if (cmdBuffer == VK_NULL_HANDLE)
+	{
+		device->getCommandPoolManager().execute(
+			device->getGraphicsQueue(), [&](VkCommandBuffer cmdBuffer) {
+				generateMipmaps(dstLayout, dstAccess, dstStage, cmdBuffer);
+			});
+		return;
+	}
+
+	VkFormatProperties formatProperties;
+	vkGetPhysicalDeviceFormatProperties(*device, format, &formatProperties);
+	if (!(formatProperties.optimalTilingFeatures
+	      & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+		throw runtime_error("Image format does not support linear blitting.");
+
+	transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+
+	/*
+	 * Each level is written as a transfer destination, then turned into the source of the blit
+	 * to the next level. At the end, all levels but the last one are transfer sources.
+	 */
+	BarrierBatch batch(*device);
+	int32_t levelWidth = static_cast<int32_t>(width);
+	int32_t levelHeight = static_cast<int32_t>(height);
+	for (uint32_t i = 1; i < mipLevels; i++)
+	{
+		VkImageMemoryBarrier barrier = createBarrier(i - 1, 1,
+							     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+							     VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+							     VK_ACCESS_TRANSFER_WRITE_BIT,
+							     VK_ACCESS_TRANSFER_READ_BIT);
+		batch.addImageBarrier(barrier, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				      VK_PIPELINE_STAGE_TRANSFER_BIT);
+		batch.record(cmdBuffer);
+
+		VkImageBlit blit = {};
+		blit.srcSubresource = {barrier.subresourceRange.aspectMask, i - 1, 0, 1};
+		blit.srcOffsets[1] = {levelWidth, levelHeight, 1};
+		levelWidth = max(levelWidth / 2, 1);
+		levelHeight = max(levelHeight / 2, 1);
+		blit.dstSubresource = {barrier.subresourceRange.aspectMask, i, 0, 1};
+		blit.dstOffsets[1] = {levelWidth, levelHeight, 1};
+
+		vkCmdBlitImage(cmdBuffer, handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, handle,
+			       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+	}
+
+	if (mipLevels > 1)
+	{
+		batch.addImageBarrier(createBarrier(0, mipLevels - 1,
+						    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstLayout,
+						    VK_ACCESS_TRANSFER_READ_BIT, dstAccess),
+				      VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage);
+	}
+	batch.addImageBarrier(createBarrier(mipLevels - 1, 1, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+					    dstLayout, VK_ACCESS_TRANSFER_WRITE_BIT, dstAccess),
+			      VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage);
+	batch.record(cmdBuffer);
+
+	setLevelStates(0, mipLevels, dstLayout, dstAccess, dstStage);
 }
 
 void Image::transfer(Image& fromImage, VkCommandBuffer cmdBuffer)
 {
 	assertReady();
-	bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-	if (useOwnBuffer)
+	if (cmdBuffer == VK_NULL_HANDLE)
 	{
-		cmdBuffer = transferCmdPool.allocateCommandBuffer();
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+		device->getCommandPoolManager().execute(
+			device->getGraphicsQueue(), [&](VkCommandBuffer cmdBuffer) {
+				transfer(fromImage, cmdBuffer);
+			});
+		return;
 	}
 
 	fromImage.transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
@@ -156,8 +308,8 @@ void Image::transfer(Image& fromImage, VkCommandBuffer cmdBuffer)
 		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
 
 	VkImageSubresourceLayers subResource = {};
-	subResource.aspectMask = format == VK_FORMAT_D16_UNORM ?
-				    VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	subResource.aspectMask = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+						       : VK_IMAGE_ASPECT_COLOR_BIT;
 	subResource.baseArrayLayer = 0;
 	subResource.mipLevel = 0;
 	subResource.layerCount = 1;
@@ -173,36 +325,18 @@ void Image::transfer(Image& fromImage, VkCommandBuffer cmdBuffer)
 
 	vkCmdCopyImage(cmdBuffer, fromImage.getHandle(), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
 		       handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	if (useOwnBuffer)
-	{
-		vkEndCommandBuffer(cmdBuffer);
-		Queue& queue = device->getTransferQueue();
-		queue.submit({}, {cmdBuffer}, {});
-		queue.waitIdle();
-		transferCmdPool.freeCommandBuffer(cmdBuffer);
-	}
 }
 
 void Image::transfer(Buffer& src, VkCommandBuffer cmdBuffer)
 {
-	assertReady();
-	bool useOwnBuffer = cmdBuffer == VK_NULL_HANDLE;
-	if (useOwnBuffer)
-	{
-		cmdBuffer = transferCmdPool.allocateCommandBuffer();
-		VkCommandBufferBeginInfo beginInfo = {};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		vkBeginCommandBuffer(cmdBuffer, &beginInfo);
-	}
-
-	transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
-		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+	transfer(src, 0, cmdBuffer);
+}
 
+void Image::transfer(Buffer& src, VkDeviceSize srcOffset, VkCommandBuffer cmdBuffer)
+{
 	VkImageSubresourceLayers subResource = {};
-	subResource.aspectMask = format == VK_FORMAT_D16_UNORM ? VK_IMAGE_ASPECT_DEPTH_BIT
-							       : VK_IMAGE_ASPECT_COLOR_BIT;
+	subResource.aspectMask = isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT
+						       : VK_IMAGE_ASPECT_COLOR_BIT;
 	subResource.baseArrayLayer = 0;
 	subResource.mipLevel = 0;
 	subResource.layerCount = 1;
@@ -211,17 +345,224 @@ void Image::transfer(Buffer& src, VkCommandBuffer cmdBuffer)
 	region.imageSubresource = subResource;
 	region.imageExtent = {width, height, 1};
 
-	vkCmdCopyBufferToImage(cmdBuffer, src, handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1,
-			       &region);
+	transfer(src, srcOffset, {region}, cmdBuffer);
+}
 
-	if (useOwnBuffer)
+/*
+ * The buffer offsets of the regions are relative to srcOffset.
+ */
+void Image::transfer(Buffer& src, VkDeviceSize srcOffset, const vector<VkBufferImageCopy>& regions,
+		     VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	if (cmdBuffer == VK_NULL_HANDLE)
 	{
-		vkEndCommandBuffer(cmdBuffer);
-		Queue& queue = device->getTransferQueue();
-		queue.submit({}, {cmdBuffer}, {});
-		queue.waitIdle();
-		transferCmdPool.freeCommandBuffer(cmdBuffer);
+		UploadContext& uploadContext = device->getUploadContext();
+		uploadContext.record([&](VkCommandBuffer cmdBuffer) {
+			transfer(src, srcOffset, regions, cmdBuffer);
+		});
+		uploadContext.transferOwnership(*this, getLayout());
+		uploadContext.submit().wait();
+		return;
 	}
+
+	transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+
+	vector<VkBufferImageCopy> offsetRegions = regions;
+	for (auto& region : offsetRegions)
+		region.bufferOffset += srcOffset;
+
+	vkCmdCopyBufferToImage(cmdBuffer, src, handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			       static_cast<uint32_t>(offsetRegions.size()), offsetRegions.data());
+}
+
+VkImageMemoryBarrier Image::createBarrier(uint32_t baseMipLevel, uint32_t levelCount,
+					  VkImageLayout srcLayout, VkImageLayout dstLayout,
+					  VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+{
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = srcLayout;
+	barrier.newLayout = dstLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = handle;
+	barrier.subresourceRange = {getAspectFlags(format), baseMipLevel, levelCount, 0, 1};
+
+	return barrier;
+}
+
+/*
+ * The source of the barrier is the tracked state of the first level, so the levels should be
+ * a run of levels in the same state. The source stage is the tracked stage of that level.
+ */
+VkImageMemoryBarrier Image::createBarrier(uint32_t baseMipLevel, uint32_t levelCount,
+					  VkImageLayout dstLayout, VkAccessFlags dstAccess)
+{
+	const LevelState& state = levelStates[baseMipLevel];
+	return createBarrier(baseMipLevel, levelCount, state.layout, dstLayout, state.access,
+			     dstAccess);
+}
+
+/*
+ * Consecutive levels in the same state, as pairs of base level and level count.
+ */
+vector<pair<uint32_t, uint32_t>> Image::getLevelRuns() const
+{
+	vector<pair<uint32_t, uint32_t>> runs;
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		if (!runs.empty() && levelStates[i] == levelStates[runs.back().first])
+			runs.back().second++;
+		else
+			runs.emplace_back(i, 1);
+	}
+	return runs;
+}
+
+void Image::setLevelStates(uint32_t baseMipLevel, uint32_t levelCount, VkImageLayout layout,
+			   VkAccessFlags access, VkPipelineStageFlags stage)
+{
+	for (uint32_t i = baseMipLevel; i < baseMipLevel + levelCount && i < mipLevels; i++)
+		levelStates[i] = {layout, access, stage};
+}
+
+void Image::setup(Device& device, uint32_t width, uint32_t height, VkFormat format,
+		  VkImageTiling tiling, VkImageUsageFlags usage, VkImageLayout initialLayout,
+		  uint32_t mipLevels)
+{
+	if (mipLevels == 0 || mipLevels > calculateMipLevels(width, height))
+		throw invalid_argument("Invalid mip level count.");
+
+	Image::device = &device;
+	Image::width = width;
+	Image::height = height;
+	Image::mipLevels = mipLevels;
+	Image::format = format;
+	Image::tiling = tiling;
+	Image::usage = getImageUsage(usage);
+	levelStates.assign(mipLevels, {initialLayout, 0, 0});
+}
+
+VkImageCreateInfo Image::createInfo(VkImageLayout initialLayout)
+{
+	return createInfo(width, height, format, tiling, usage, initialLayout, mipLevels);
+}
+
+/*
+ * Transient images can only be used as attachments.
+ */
+VkImageUsageFlags Image::getImageUsage(VkImageUsageFlags usage)
+{
+	if (!(usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT))
+		usage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	return usage;
+}
+
+VkImageCreateInfo Image::createInfo(uint32_t width, uint32_t height, VkFormat format,
+				    VkImageTiling tiling, VkImageUsageFlags usage,
+				    VkImageLayout initialLayout, uint32_t mipLevels)
+{
+	VkImageCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	info.imageType = VK_IMAGE_TYPE_2D;
+	info.extent.width = width;
+	info.extent.height = height;
+	info.extent.depth = 1;
+	info.mipLevels = mipLevels;
+	info.arrayLayers = 1;
+	info.format = format;
+	info.tiling = tiling;
+	info.initialLayout = initialLayout;
+	info.usage = usage;
+	info.samples = VK_SAMPLE_COUNT_1_BIT;
+	info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	return info;
+}
+
+void Image::enableRelocation()
+{
+	assertReady();
+	auto allocation = static_pointer_cast<Allocation>(memory);
+	if (usage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT || !allocation->isRelocatable())
+		throw invalid_argument("Only images with memory of their own can be relocated.");
+	allocation->setRelocationHandler(
+		[this](VkCommandBuffer cmdBuffer, const shared_ptr<Allocation>& oldMemory) {
+			relocate(cmdBuffer, oldMemory);
+		});
+}
+
+void Image::relocate(VkCommandBuffer cmdBuffer, const shared_ptr<Allocation>& oldMemory)
+{
+	VkImageCreateInfo info = createInfo(VK_IMAGE_LAYOUT_UNDEFINED);
+	VkImage newHandle;
+	VkResult result = vkCreateImage(*device, &info, nullptr, &newHandle);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to recreate relocated image.");
+
+	Allocation& allocation = static_cast<Allocation&>(*memory);
+	result = vkBindImageMemory(*device, newHandle, allocation.getDeviceMemory(),
+				   allocation.getOffset());
+	if (result != VK_SUCCESS)
+	{
+		vkDestroyImage(*device, newHandle, nullptr);
+		throw runtime_error("Failed to bind relocated image memory.");
+	}
+
+	auto runs = getLevelRuns();
+	vector<LevelState> states = levelStates;
+	transition(VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_TRANSFER_READ_BIT,
+		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+
+	VkImage oldHandle = handle;
+	handle = newHandle;
+	levelStates.assign(mipLevels, {VK_IMAGE_LAYOUT_UNDEFINED, 0, 0});
+	transition(VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT,
+		   VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+
+	vector<VkImageCopy> regions(mipLevels);
+	for (uint32_t i = 0; i < mipLevels; i++)
+	{
+		VkImageCopy& region = regions[i];
+		region = {};
+		region.srcSubresource.aspectMask = getAspectFlags(format);
+		region.srcSubresource.mipLevel = i;
+		region.srcSubresource.baseArrayLayer = 0;
+		region.srcSubresource.layerCount = 1;
+		region.dstSubresource = region.srcSubresource;
+		region.extent.width = max(width >> i, 1u);
+		region.extent.height = max(height >> i, 1u);
+		region.extent.depth = 1;
+	}
+	vkCmdCopyImage(cmdBuffer, oldHandle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, handle,
+		       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, regions.data());
+
+	/*
+	 * Levels can not be transitioned back to undefined or preinitialized, so those stay
+	 * transfer destinations.
+	 */
+	for (auto& run : runs)
+	{
+		const LevelState& state = states[run.first];
+		if (state.layout == VK_IMAGE_LAYOUT_UNDEFINED
+		    || state.layout == VK_IMAGE_LAYOUT_PREINITIALIZED)
+			continue;
+		transitionMipLevels(run.first, run.second, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				    state.layout, VK_ACCESS_TRANSFER_WRITE_BIT, state.access,
+				    VK_PIPELINE_STAGE_TRANSFER_BIT,
+				    state.stage != 0 ? state.stage
+						     : VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				    cmdBuffer);
+	}
+
+	VkDevice logical = *device;
+	device->getRetireQueue().retire([logical, oldHandle, oldMemory] {
+		vkDestroyImage(logical, oldHandle, nullptr);
+	});
+
+	relocateEvent();
 }
 
 void Image::assertReady()
@@ -90,6 +90,8 @@ void Instance::init(bool enableDebug, const VkApplicationInfo* applicationInfo)
 
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create instance.");
+	if (applicationInfo != nullptr && applicationInfo->apiVersion != 0)
+		apiVersion = applicationInfo->apiVersion;
 
 	uint32_t n = 0;
 	vkEnumeratePhysicalDevices(handle, &n, nullptr);
@@ -2,31 +2,66 @@
 #define VMA_STATIC_VULKAN_FUNCTIONS 1
 #include <bp/MemoryAllocator.h>
 #include <stdexcept>
+#include <unordered_map>
+#include <algorithm>
 
 using namespace std;
 
 namespace bp
 {
 
-Allocation::Allocation(Allocation&& other)
+/*
+ * The device memory callbacks of VMA carry no user data, so allocators are looked up by handle.
+ */
+static mutex registryMutex;
+static unordered_map<VmaAllocator, MemoryAllocator*> registry;
+
+static MemoryAllocator* findAllocator(VmaAllocator allocator)
+{
+	lock_guard<mutex> lock(registryMutex);
+	auto it = registry.find(allocator);
+	return it == registry.end() ? nullptr : it->second;
+}
+
+Allocation::Allocation(Allocation&& other) :
+	owner{nullptr}
 {
-	if (isReady()) vmaFreeMemory(allocator, handle);
 	device = other.device;
 	allocator = other.allocator;
 	handle = other.handle;
 	info = other.info;
+	createInfo = other.createInfo;
+	requirements = other.requirements;
 	coherent = other.coherent;
+	if (other.owner != nullptr)
+	{
+		other.owner->removeRelocatable(&other);
+		owner = other.owner;
+		relocationHandler = move(other.relocationHandler);
+		if (relocationHandler) owner->addRelocatable(this);
+	}
 	other.device = VK_NULL_HANDLE;
 	other.allocator = VMA_NULL;
 	other.handle = VMA_NULL;
 	other.info = {};
+	other.owner = nullptr;
 }
 
 Allocation::~Allocation()
 {
+	if (owner != nullptr) owner->removeRelocatable(this);
 	if (isReady()) vmaFreeMemory(allocator, handle);
 }
 
+void Allocation::setRelocationHandler(
+	const function<void(VkCommandBuffer, const shared_ptr<Allocation>&)>& handler)
+{
+	relocationHandler = handler;
+	if (owner == nullptr) return;
+	if (relocationHandler) owner->addRelocatable(this);
+	else owner->removeRelocatable(this);
+}
+
 void Allocation::flushMapped()
 {
 	if (coherent) return;
@@ -41,57 +76,472 @@ void Allocation::flushMapped()
 MemoryAllocator::~MemoryAllocator()
 {
 	if (isReady())
+	{
+		{
+			lock_guard<mutex> lock(registryMutex);
+			registry.erase(handle);
+		}
+		for (auto& p : pools)
+			vmaDestroyPool(handle, p.second);
 		vmaDestroyAllocator(handle);
+	}
 }
 
-void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice)
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice logicalDevice,
+			   bool memoryBudget, VkInstance instance, uint32_t instanceApiVersion)
 {
+	if (isReady()) throw runtime_error("Memory allocator already initialized.");
+
 	MemoryAllocator::physicalDevice = physicalDevice;
 	MemoryAllocator::logicalDevice = logicalDevice;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+
+#if defined(VK_KHR_get_physical_device_properties2) && defined(VK_EXT_memory_budget)
+	if (memoryBudget && instance != VK_NULL_HANDLE)
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		bool core = instanceApiVersion >= VK_MAKE_VERSION(1, 1, 0)
+			    && properties.apiVersion >= VK_MAKE_VERSION(1, 1, 0);
+		getMemoryProperties2 = vkGetInstanceProcAddr(
+			instance, core ? "vkGetPhysicalDeviceMemoryProperties2"
+				       : "vkGetPhysicalDeviceMemoryProperties2KHR");
+	}
+#endif
+
+	poolSettings[static_cast<size_t>(MemoryPool::DEFAULT)] = {0, 0, false};
+	poolSettings[static_cast<size_t>(MemoryPool::ATTACHMENT)] = {0, 0, true};
+	poolSettings[static_cast<size_t>(MemoryPool::STATIC_GEOMETRY)] = {64 * 1024 * 1024, 0, false};
+	poolSettings[static_cast<size_t>(MemoryPool::FRAME)] = {16 * 1024 * 1024, 0, false};
+	poolSettings[static_cast<size_t>(MemoryPool::STREAMING)] = {128 * 1024 * 1024, 0, false};
+
+	VmaDeviceMemoryCallbacks callbacks = {};
+	callbacks.pfnAllocate = onBlockAllocate;
+	callbacks.pfnFree = onBlockFree;
 
 	VmaAllocatorCreateInfo info = {};
 	info.physicalDevice = physicalDevice;
 	info.device = logicalDevice;
+	info.pDeviceMemoryCallbacks = &callbacks;
 
 	VkResult result = vmaCreateAllocator(&info, &handle);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create memory allocator.");
+
+	lock_guard<mutex> lock(registryMutex);
+	registry[handle] = this;
 }
 
+/*
+ * The buffer is created before its memory is allocated, as its requirements decide whether it
+ * is allocated from the pool.
+ */
 shared_ptr<Allocation> MemoryAllocator::createBuffer(const VkBufferCreateInfo& bufferInfo,
-						     VmaMemoryUsage usage, VkBuffer& buffer)
+						     VmaMemoryUsage usage, VkBuffer& buffer,
+						     MemoryPool pool)
 {
-	VmaAllocationCreateInfo createInfo = {};
-	createInfo.usage = usage;
+	VkResult result = vkCreateBuffer(logicalDevice, &bufferInfo, nullptr, &buffer);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to create buffer.");
 
-	if (usage != VMA_MEMORY_USAGE_GPU_ONLY) createInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(logicalDevice, buffer, &requirements);
 
 	VmaAllocation allocation = VMA_NULL;
 	VmaAllocationInfo allocationInfo = {};
-	VkResult result = vmaCreateBuffer(handle, &bufferInfo, &createInfo, &buffer, &allocation,
-					  &allocationInfo);
+	VmaAllocationCreateInfo createInfo;
+	try
+	{
+		createInfo = createAllocationInfo(usage, pool, requirements);
+		result = vmaAllocateMemoryForBuffer(handle, buffer, &createInfo, &allocation,
+						    &allocationInfo);
+		if (result != VK_SUCCESS)
+			throw runtime_error("Failed to allocate buffer memory.");
+	} catch (...)
+	{
+		vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+		throw;
+	}
+
+	result = vmaBindBufferMemory(handle, allocation, buffer);
 	if (result != VK_SUCCESS)
-		throw runtime_error("Failed to allocate buffer memory.");
+	{
+		vmaFreeMemory(handle, allocation);
+		vkDestroyBuffer(logicalDevice, buffer, nullptr);
+		buffer = VK_NULL_HANDLE;
+		throw runtime_error("Failed to bind buffer memory.");
+	}
+
+	auto memory = make_shared<Allocation>(logicalDevice, handle, allocation, allocationInfo);
+	memory->createInfo = createInfo;
+	memory->requirements = requirements;
+	memory->owner = this;
+	return memory;
+}
+
+/*
+ * Images are created first for the same reason as buffers.
+ */
+shared_ptr<Allocation> MemoryAllocator::createImage(const VkImageCreateInfo& imageInfo,
+						    VmaMemoryUsage usage, VkImage& image,
+						    MemoryPool pool)
+{
+	VkResult result = vkCreateImage(logicalDevice, &imageInfo, nullptr, &image);
+	if (result != VK_SUCCESS) throw runtime_error("Failed to create image.");
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(logicalDevice, image, &requirements);
+
+	VmaAllocation allocation = VMA_NULL;
+	VmaAllocationInfo allocationInfo = {};
+	VmaAllocationCreateInfo createInfo;
+	try
+	{
+		createInfo = createAllocationInfo(usage, pool, requirements, imageInfo.usage);
+		result = vmaAllocateMemoryForImage(handle, image, &createInfo, &allocation,
+						   &allocationInfo);
+		if (result != VK_SUCCESS)
+			throw runtime_error("Failed to allocate image memory.");
+	} catch (...)
+	{
+		vkDestroyImage(logicalDevice, image, nullptr);
+		image = VK_NULL_HANDLE;
+		throw;
+	}
+
+	result = vmaBindImageMemory(handle, allocation, image);
+	if (result != VK_SUCCESS)
+	{
+		vmaFreeMemory(handle, allocation);
+		vkDestroyImage(logicalDevice, image, nullptr);
+		image = VK_NULL_HANDLE;
+		throw runtime_error("Failed to bind image memory.");
+	}
+
+	auto memory = make_shared<Allocation>(logicalDevice, handle, allocation, allocationInfo);
+	memory->createInfo = createInfo;
+	memory->requirements = requirements;
+	memory->owner = this;
+	return memory;
+}
+
+shared_ptr<Allocation> MemoryAllocator::allocateMemory(const VkMemoryRequirements& requirements,
+						       VmaMemoryUsage usage, MemoryPool pool,
+						       VkMemoryPropertyFlags preferredFlags)
+{
+	VmaAllocationCreateInfo createInfo = createAllocationInfo(usage, pool, requirements, 0,
+								  preferredFlags);
+
+	VmaAllocation allocation = VMA_NULL;
+	VmaAllocationInfo allocationInfo = {};
+	VkResult result = vmaAllocateMemory(handle, &requirements, &createInfo, &allocation,
+					    &allocationInfo);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to allocate memory.");
 
 	return make_shared<Allocation>(logicalDevice, handle, allocation, allocationInfo);
 }
 
-shared_ptr<Allocation> MemoryAllocator::createImage(const VkImageCreateInfo& bufferInfo,
-						    VmaMemoryUsage usage, VkImage& image)
+void MemoryAllocator::setPoolSettings(MemoryPool pool, const MemoryPoolSettings& settings)
+{
+	lock_guard<mutex> lock(poolMutex);
+	for (auto& p : pools)
+	{
+		if (p.first.first == pool)
+			throw runtime_error("Memory pool settings can not change after first use.");
+	}
+	poolSettings[static_cast<size_t>(pool)] = settings;
+}
+
+MemoryPoolSettings MemoryAllocator::getPoolSettings(MemoryPool pool)
+{
+	lock_guard<mutex> lock(poolMutex);
+	return poolSettings[static_cast<size_t>(pool)];
+}
+
+DefragmentationStats MemoryAllocator::defragment(VkCommandBuffer cmdBuffer,
+						 VkDeviceSize maxBytes, uint32_t maxAllocations)
+{
+	assertReady();
+	DefragmentationStats stats = {};
+	stats.complete = true;
+
+	vector<pair<Allocation*, shared_ptr<Allocation>>> moved;
+	{
+		lock_guard<mutex> lock(relocatableMutex);
+
+		/*
+		 * Blocks are ranked by the bytes of the relocatable allocations in them, as those
+		 * are the only ones known here. Allocations are taken from the emptiest blocks
+		 * first, and only moved to blocks holding at least as much, so that nothing moves
+		 * back and forth.
+		 */
+		unordered_map<VkDeviceMemory, VkDeviceSize> blockBytes;
+		vector<Allocation*> candidates;
+		for (Allocation* allocation : relocatable)
+		{
+			blockBytes[allocation->info.deviceMemory] += allocation->info.size;
+			VmaAllocationCreateFlags flags = allocation->createInfo.flags;
+			if (!(flags & VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT))
+				candidates.push_back(allocation);
+		}
+		sort(candidates.begin(), candidates.end(),
+		     [&blockBytes](Allocation* a, Allocation* b) {
+			     return blockBytes[a->info.deviceMemory]
+				    < blockBytes[b->info.deviceMemory];
+		     });
+
+		for (Allocation* allocation : candidates)
+		{
+			if (stats.allocationsMoved >= maxAllocations)
+			{
+				stats.complete = false;
+				break;
+			}
+			VkDeviceSize size = allocation->info.size;
+			if (size > maxBytes - stats.bytesMoved)
+			{
+				stats.complete = false;
+				continue;
+			}
+
+			/*
+			 * The new place is only taken from free space of existing blocks, of the
+			 * memory type the allocation is already in.
+			 */
+			VkMemoryRequirements requirements = allocation->requirements;
+			requirements.memoryTypeBits = 1u << allocation->info.memoryType;
+			VmaAllocationCreateInfo createInfo = allocation->createInfo;
+			createInfo.flags |= VMA_ALLOCATION_CREATE_NEVER_ALLOCATE_BIT;
+
+			VmaAllocation newHandle = VMA_NULL;
+			VmaAllocationInfo newInfo = {};
+			VkResult result = vmaAllocateMemory(handle, &requirements, &createInfo,
+							    &newHandle, &newInfo);
+			if (result != VK_SUCCESS) continue;
+
+			VkDeviceMemory oldBlock = allocation->info.deviceMemory;
+			if (newInfo.deviceMemory == oldBlock
+			    || blockBytes[newInfo.deviceMemory] < blockBytes[oldBlock])
+			{
+				vmaFreeMemory(handle, newHandle);
+				continue;
+			}
+
+			auto old = make_shared<Allocation>(logicalDevice, handle,
+							   allocation->handle, allocation->info);
+			allocation->handle = newHandle;
+			allocation->info = newInfo;
+			blockBytes[oldBlock] -= size;
+			blockBytes[newInfo.deviceMemory] += size;
+			stats.bytesMoved += size;
+			stats.allocationsMoved++;
+			moved.emplace_back(allocation, old);
+		}
+	}
+	if (moved.empty()) return stats;
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+			     VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0,
+			     nullptr);
+
+	for (auto& relocation : moved)
+		relocation.first->relocationHandler(cmdBuffer, relocation.second);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, nullptr, 0,
+			     nullptr);
+
+	return stats;
+}
+
+vector<MemoryHeapBudget> MemoryAllocator::getHeapBudgets()
+{
+	assertReady();
+
+	VmaStats stats = calculateStats();
+	vector<MemoryHeapBudget> budgets(memoryProperties.memoryHeapCount);
+	for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+	{
+		const VmaStatInfo& info = stats.memoryHeap[i];
+		MemoryHeapBudget& budget = budgets[i];
+		budget.size = memoryProperties.memoryHeaps[i].size;
+		budget.budget = budget.size / 5 * 4;
+		budget.blockCount = info.blockCount;
+		budget.allocationCount = info.allocationCount;
+		budget.allocationBytes = info.usedBytes;
+		budget.unusedBytes = info.unusedBytes;
+		budget.blockBytes = info.usedBytes + info.unusedBytes;
+		budget.unusedRangeSizeMax = info.unusedBytes > 0 ? info.unusedRangeSizeMax : 0;
+		budget.usage = budget.blockBytes;
+		budget.fragmentation = info.unusedBytes > 0
+				       ? 1.f - static_cast<float>(budget.unusedRangeSizeMax)
+					       / static_cast<float>(info.unusedBytes)
+				       : 0.f;
+	}
+
+#if defined(VK_KHR_get_physical_device_properties2) && defined(VK_EXT_memory_budget)
+	if (getMemoryProperties2 != nullptr)
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+		budgetProperties.sType =
+			VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2KHR properties2 = {};
+		properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+		properties2.pNext = &budgetProperties;
+		reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(getMemoryProperties2)(
+			physicalDevice, &properties2);
+
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+		{
+			budgets[i].budget = budgetProperties.heapBudget[i];
+			budgets[i].usage = budgetProperties.heapUsage[i];
+		}
+	}
+#endif
+
+	return budgets;
+}
+
+VmaStats MemoryAllocator::calculateStats()
+{
+	assertReady();
+	VmaStats stats;
+	vmaCalculateStats(handle, &stats);
+	return stats;
+}
+
+string MemoryAllocator::buildStatsString(bool detailedMap)
+{
+	assertReady();
+	char* statsString = nullptr;
+	vmaBuildStatsString(handle, &statsString, detailedMap ? VK_TRUE : VK_FALSE);
+	string result = statsString;
+	vmaFreeStatsString(handle, statsString);
+	return result;
+}
+
+void VKAPI_PTR MemoryAllocator::onBlockAllocate(VmaAllocator allocator, uint32_t memoryType,
+						VkDeviceMemory, VkDeviceSize size)
+{
+	MemoryAllocator* memoryAllocator = findAllocator(allocator);
+	if (memoryAllocator == nullptr) return;
+	uint32_t heap = memoryAllocator->memoryProperties.memoryTypes[memoryType].heapIndex;
+	memoryAllocator->blockAllocateEvent(heap, size);
+}
+
+void VKAPI_PTR MemoryAllocator::onBlockFree(VmaAllocator allocator, uint32_t memoryType,
+					    VkDeviceMemory, VkDeviceSize size)
+{
+	MemoryAllocator* memoryAllocator = findAllocator(allocator);
+	if (memoryAllocator == nullptr) return;
+	uint32_t heap = memoryAllocator->memoryProperties.memoryTypes[memoryType].heapIndex;
+	memoryAllocator->blockFreeEvent(heap, size);
+}
+
+/*
+ * Takes the requirements of the created resource, so that the pool of a resource is chosen
+ * without VMA creating a temporary resource to find its memory type.
+ */
+VmaAllocationCreateInfo MemoryAllocator::createAllocationInfo(VmaMemoryUsage usage,
+							     MemoryPool pool,
+							     const VkMemoryRequirements& requirements,
+							     VkImageUsageFlags imageUsage,
+							     VkMemoryPropertyFlags preferredFlags)
 {
 	VmaAllocationCreateInfo createInfo = {};
 	createInfo.usage = usage;
+	createInfo.preferredFlags = preferredFlags;
 
 	if (usage != VMA_MEMORY_USAGE_GPU_ONLY) createInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	if (imageUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+		createInfo.preferredFlags |= VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT;
 
-	VmaAllocation allocation = VMA_NULL;
-	VmaAllocationInfo allocationInfo = {};
-	VkResult result = vmaCreateImage(handle, &bufferInfo, &createInfo, &image, &allocation,
-					 &allocationInfo);
+	MemoryPoolSettings settings = getPoolSettings(pool);
+	if (settings.dedicated)
+	{
+		createInfo.flags |= VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT;
+		return createInfo;
+	}
+	if (pool == MemoryPool::DEFAULT) return createInfo;
+
+	/*
+	 * VMA pools are bound to a memory type, so there is one for each memory type a pool is
+	 * used with.
+	 */
+	uint32_t memoryTypeIndex;
+	VkResult result = vmaFindMemoryTypeIndex(handle, requirements.memoryTypeBits, &createInfo,
+						 &memoryTypeIndex);
 	if (result != VK_SUCCESS)
-		throw runtime_error("Failed to allocate image memory.");
+		throw runtime_error("Failed to find a suitable memory type.");
 
-	return make_shared<Allocation>(logicalDevice, handle, allocation, allocationInfo);
+	/*
+	 * Pool blocks have a fixed size, so large resources go through the default path instead,
+	 * which gives them dedicated memory when they would fill most of a default block.
+	 */
+	if (requirements.size > getBlockSize(settings, memoryTypeIndex) / 2) return createInfo;
+
+	createInfo.pool = getPool(pool, memoryTypeIndex);
+	return createInfo;
+}
+
+/*
+ * The block size VMA uses for a pool, where the default is an eighth of heaps of up to 1 GB and
+ * 256 MB for larger heaps.
+ */
+VkDeviceSize MemoryAllocator::getBlockSize(const MemoryPoolSettings& settings,
+					   uint32_t memoryTypeIndex)
+{
+	if (settings.blockSize != 0) return settings.blockSize;
+	uint32_t heap = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+	VkDeviceSize heapSize = memoryProperties.memoryHeaps[heap].size;
+	return heapSize <= VMA_SMALL_HEAP_MAX_SIZE ? heapSize / 8
+						   : VMA_DEFAULT_LARGE_HEAP_BLOCK_SIZE;
+}
+
+VmaPool MemoryAllocator::getPool(MemoryPool pool, uint32_t memoryTypeIndex)
+{
+	lock_guard<mutex> lock(poolMutex);
+	auto key = make_pair(pool, memoryTypeIndex);
+	auto it = pools.find(key);
+	if (it != pools.end()) return it->second;
+
+	const MemoryPoolSettings& settings = poolSettings[static_cast<size_t>(pool)];
+	VmaPoolCreateInfo info = {};
+	info.memoryTypeIndex = memoryTypeIndex;
+	info.blockSize = settings.blockSize;
+	info.maxBlockCount = settings.maxBlockCount;
+
+	VmaPool vmaPool;
+	VkResult result = vmaCreatePool(handle, &info, &vmaPool);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to create memory pool.");
+	pools[key] = vmaPool;
+	return vmaPool;
+}
+
+void MemoryAllocator::addRelocatable(Allocation* allocation)
+{
+	lock_guard<mutex> lock(relocatableMutex);
+	relocatable.insert(allocation);
+}
+
+void MemoryAllocator::removeRelocatable(Allocation* allocation)
+{
+	lock_guard<mutex> lock(relocatableMutex);
+	relocatable.erase(allocation);
+}
+
+void MemoryAllocator::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Memory allocator not ready. Must initialize before use.");
 }
 
-}
\ No newline at end of file
+}
@@ -14,7 +14,9 @@ void OffscreenFramebuffer::init(RenderPass& renderPass, uint32_t width, uint32_t
 			     width, height);
 	depthAttachment.init(device, VK_FORMAT_D16_UNORM,
 			     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT
-			     | VK_IMAGE_USAGE_SAMPLED_BIT, width, height);
+			     | (depthAttachmentSlot.isTransient()
+				? VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT
+				: VK_IMAGE_USAGE_SAMPLED_BIT), width, height);
 	depthAttachment.setClearValue({1.f, 0.f});
 
 	setAttachment(colorAttachmentSlot, colorAttachment);
@@ -0,0 +1,104 @@
+#include <bp/PipelineBuilder.h>
+#include <stdexcept>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+namespace bp
+{
+
+void PipelineBuilder::init(Device& device)
+{
+	if (isReady()) throw runtime_error("Pipeline builder already initialized.");
+	PipelineBuilder::device = &device;
+}
+
+void PipelineBuilder::add(GraphicsPipeline& pipeline, RenderPass& renderPass,
+			  VkPipelineLayout layout)
+{
+	assertReady();
+	if (pipeline.isReady()) throw runtime_error("Pipeline already initialized.");
+	pipeline.device = device;
+	pipeline.layout = layout;
+	pipeline.renderPass = &renderPass;
+	graphicsPipelines.push_back(&pipeline);
+}
+
+void PipelineBuilder::add(ComputePipeline& pipeline, VkPipelineLayout layout)
+{
+	assertReady();
+	if (pipeline.isReady()) throw runtime_error("Pipeline already initialized.");
+	pipeline.device = device;
+	pipeline.layout = layout;
+	computePipelines.push_back(&pipeline);
+}
+
+void PipelineBuilder::build(unsigned workerCount)
+{
+	assertReady();
+	vector<GraphicsPipeline*> graphics;
+	vector<ComputePipeline*> compute;
+	graphics.swap(graphicsPipelines);
+	compute.swap(computePipelines);
+
+	size_t count = graphics.size() + compute.size();
+	if (count == 0) return;
+	if (workerCount == 0) workerCount = max(thread::hardware_concurrency(), 1u);
+	workerCount = static_cast<unsigned>(min(static_cast<size_t>(workerCount), count));
+
+	/*
+	 * Pipelines are handed out one at a time, as creation times vary a lot between pipelines.
+	 * The calling thread works as well, and keeps its thread cache.
+	 */
+	atomic<size_t> next{0};
+	exception_ptr error;
+	mutex errorMutex;
+	PipelineCache& cache = device->getPipelineCache();
+
+	auto work = [&] {
+		for (size_t i = next++; i < count; i = next++)
+		{
+			try
+			{
+				if (i < graphics.size()) graphics[i]->create();
+				else compute[i - graphics.size()]->create();
+			} catch (...)
+			{
+				lock_guard<mutex> lock(errorMutex);
+				if (!error) error = current_exception();
+			}
+		}
+	};
+
+	vector<thread> workers;
+	for (unsigned i = 1; i < workerCount; i++)
+	{
+		workers.emplace_back([&] {
+			work();
+			try
+			{
+				cache.releaseThreadCache();
+			} catch (...)
+			{
+				lock_guard<mutex> lock(errorMutex);
+				if (!error) error = current_exception();
+			}
+		});
+	}
+	work();
+	for (auto& worker : workers) worker.join();
+
+	if (error) rethrow_exception(error);
+}
+
+void PipelineBuilder::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Pipeline builder not ready. Must initialize before use.");
+}
+
+}
@@ -0,0 +1,250 @@
+#include <bp/PipelineCache.h>
+#include <bp/Util.h>
+#include <stdexcept>
+#include <fstream>
+#include <cstring>
+
+using namespace std;
+
+namespace bp
+{
+
+static const uint32_t FILE_MAGIC = 0x43504250;
+static const uint32_t FILE_VERSION = 1;
+
+/*
+ * Header written in front of the cache data. The driver version is not part of the header
+ * Vulkan puts in the data, so it is checked here along with the device identity.
+ */
+struct FileHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint32_t driverVersion;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+	uint64_t dataSize;
+};
+
+PipelineCache::~PipelineCache()
+{
+	if (!isReady()) return;
+
+	if (!file.empty())
+	{
+		try
+		{
+			save();
+		} catch (exception&)
+		{
+		}
+	}
+
+	for (auto& c : threadCaches)
+		vkDestroyPipelineCache(device, c.second.cache, nullptr);
+	vkDestroyPipelineCache(device, handle, nullptr);
+}
+
+void PipelineCache::init(VkPhysicalDevice physical, VkDevice device)
+{
+	if (isReady()) throw runtime_error("Pipeline cache already initialized.");
+
+	PipelineCache::physical = physical;
+	PipelineCache::device = device;
+	vkGetPhysicalDeviceProperties(physical, &properties);
+	handle = createCache(nullptr, 0);
+}
+
+void PipelineCache::setFile(const string& path)
+{
+	assertReady();
+	load(path);
+	file = path;
+}
+
+bool PipelineCache::load(const string& path)
+{
+	assertReady();
+
+	ifstream in(path, ios::binary);
+	if (!in.is_open()) return false;
+
+	FileHeader header;
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	if (!in || header.magic != FILE_MAGIC || header.version != FILE_VERSION
+	    || header.vendorID != properties.vendorID || header.deviceID != properties.deviceID
+	    || header.driverVersion != properties.driverVersion
+	    || memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		return false;
+
+	/*
+	 * The size in the header is not trusted, so that a corrupt file cannot make us allocate
+	 * more than the file holds.
+	 */
+	streampos dataBegin = in.tellg();
+	in.seekg(0, ios::end);
+	streampos fileEnd = in.tellg();
+	if (!in || fileEnd < dataBegin) return false;
+	uint64_t remaining = static_cast<uint64_t>(fileEnd - dataBegin);
+	if (header.dataSize > remaining) return false;
+	in.seekg(dataBegin);
+
+	vector<char> data(static_cast<size_t>(header.dataSize));
+	in.read(data.data(), data.size());
+	if (!in) return false;
+
+	VkPipelineCache loaded = createCache(data.data(), data.size());
+	lock_guard<mutex> lock(cacheMutex);
+	VkResult result = vkMergePipelineCaches(device, handle, 1, &loaded);
+	vkDestroyPipelineCache(device, loaded, nullptr);
+	return result == VK_SUCCESS;
+}
+
+void PipelineCache::save(const string& path)
+{
+	assertReady();
+
+	vector<uint8_t> data;
+	{
+		lock_guard<mutex> lock(cacheMutex);
+		mergeThreadCaches();
+		data = getData(handle);
+	}
+
+	FileHeader header = {};
+	header.magic = FILE_MAGIC;
+	header.version = FILE_VERSION;
+	header.vendorID = properties.vendorID;
+	header.deviceID = properties.deviceID;
+	header.driverVersion = properties.driverVersion;
+	memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	header.dataSize = data.size();
+
+	/*
+	 * Write to a temporary file first, so that an interrupted save does not leave a truncated
+	 * cache behind.
+	 */
+	string tmpPath = path + ".tmp";
+	{
+		ofstream out(tmpPath, ios::binary | ios::trunc);
+		if (!out.is_open())
+			throw runtime_error("Failed to open file \"" + tmpPath + "\".");
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(data.data()), data.size());
+		if (!out) throw runtime_error("Failed to write file \"" + tmpPath + "\".");
+	}
+	remove(path.c_str());
+	if (rename(tmpPath.c_str(), path.c_str()) != 0)
+		throw runtime_error("Failed to write file \"" + path + "\".");
+}
+
+void PipelineCache::save()
+{
+	if (file.empty()) throw runtime_error("No pipeline cache file set.");
+	save(file);
+}
+
+VkPipelineCache PipelineCache::getHandle()
+{
+	assertReady();
+	lock_guard<mutex> lock(cacheMutex);
+
+	auto id = this_thread::get_id();
+	auto found = threadCaches.find(id);
+	if (found != threadCaches.end())
+	{
+		/*
+		 * The id of an exited thread may be reused, and its cache then belongs to the new
+		 * thread.
+		 */
+		if (found->second.thread.expired()) found->second.thread = getThreadToken();
+		return found->second.cache;
+	}
+
+	vector<uint8_t> data = getData(handle);
+	VkPipelineCache cache = createCache(data.data(), data.size());
+	threadCaches[id] = ThreadCache{cache, getThreadToken()};
+	return cache;
+}
+
+void PipelineCache::releaseThreadCache()
+{
+	assertReady();
+	lock_guard<mutex> lock(cacheMutex);
+
+	auto found = threadCaches.find(this_thread::get_id());
+	if (found == threadCaches.end()) return;
+
+	VkPipelineCache cache = found->second.cache;
+	threadCaches.erase(found);
+	VkResult result = vkMergePipelineCaches(device, handle, 1, &cache);
+	vkDestroyPipelineCache(device, cache, nullptr);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to merge pipeline caches.");
+}
+
+VkPipelineCache PipelineCache::createCache(const void* data, size_t size)
+{
+	VkPipelineCacheCreateInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+	info.initialDataSize = size;
+	info.pInitialData = data;
+
+	VkPipelineCache cache;
+	VkResult result = vkCreatePipelineCache(device, &info, nullptr, &cache);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to create pipeline cache.");
+	return cache;
+}
+
+vector<uint8_t> PipelineCache::getData(VkPipelineCache cache)
+{
+	size_t size = 0;
+	VkResult result = vkGetPipelineCacheData(device, cache, &size, nullptr);
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to get pipeline cache data.");
+
+	vector<uint8_t> data(size);
+	result = vkGetPipelineCacheData(device, cache, &size, data.data());
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to get pipeline cache data.");
+	data.resize(size);
+	return data;
+}
+
+void PipelineCache::mergeThreadCaches()
+{
+	if (threadCaches.empty()) return;
+
+	vector<VkPipelineCache> caches;
+	for (auto& c : threadCaches) caches.push_back(c.second.cache);
+	VkResult result = vkMergePipelineCaches(device, handle, static_cast<uint32_t>(caches.size()),
+						caches.data());
+	if (result != VK_SUCCESS)
+		throw runtime_error("Failed to merge pipeline caches.");
+
+	/*
+	 * Threads that are still running may be creating pipelines with their caches, so only the
+	 * caches of exited threads can be destroyed.
+	 */
+	for (auto it = threadCaches.begin(); it != threadCaches.end();)
+	{
+		if (it->second.thread.expired())
+		{
+			vkDestroyPipelineCache(device, it->second.cache, nullptr);
+			it = threadCaches.erase(it);
+		} else
+		{
+			it++;
+		}
+	}
+}
+
+void PipelineCache::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Pipeline cache not ready. Must initialize before use.");
+}
+
+}
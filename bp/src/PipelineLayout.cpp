@@ -8,7 +8,11 @@ namespace bp
 
 PipelineLayout::~PipelineLayout()
 {
-	if (handle != VK_NULL_HANDLE) vkDestroyPipelineLayout(*device, handle, nullptr);
+	if (handle != VK_NULL_HANDLE)
+	{
+		device->notifyDestroyed(handle);
+		vkDestroyPipelineLayout(*device, handle, nullptr);
+	}
 }
 
 void PipelineLayout::init(Device& device)
@@ -0,0 +1,182 @@
+#include <bp/PipelineRegistry.h>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace bp
+{
+
+template <typename T>
+static void appendKey(string& key, const T& value)
+{
+	key.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+static void appendKey(string& key, const void* data, size_t size)
+{
+	appendKey(key, size);
+	key.append(static_cast<const char*>(data), size);
+}
+
+static void appendKey(string& key, const VkSpecializationInfo* info)
+{
+	if (info == nullptr)
+	{
+		appendKey(key, uint32_t{0});
+		return;
+	}
+	appendKey(key, info->mapEntryCount);
+	appendKey(key, info->pMapEntries, info->mapEntryCount * sizeof(VkSpecializationMapEntry));
+	appendKey(key, info->pData, info->dataSize);
+}
+
+PipelineRegistry::~PipelineRegistry()
+{
+	if (isReady()) device->removeDestroyListener(destroyListener);
+}
+
+void PipelineRegistry::init(Device& device)
+{
+	if (isReady()) throw runtime_error("Pipeline registry already initialized.");
+	PipelineRegistry::device = &device;
+	destroyListener = device.addDestroyListener([this](uint64_t handle) { evict(handle); });
+}
+
+GraphicsPipeline& PipelineRegistry::get(const GraphicsPipeline& description,
+					RenderPass& renderPass, VkPipelineLayout layout)
+{
+	assertReady();
+	if (description.isReady())
+		throw invalid_argument("Pipeline description must not be initialized.");
+
+	string key = createKey(description, renderPass, layout);
+	{
+		lock_guard<mutex> lock(pipelinesMutex);
+		auto found = pipelines.find(key);
+		if (found != pipelines.end())
+		{
+			hitCount++;
+			return *found->second.pipeline;
+		}
+	}
+
+	/*
+	 * The pipeline is created without holding the lock, so that threads creating other
+	 * pipelines are not blocked. If another thread registered the same pipeline meanwhile, its
+	 * pipeline is returned and this one is destroyed.
+	 */
+	unique_ptr<GraphicsPipeline> pipeline(new GraphicsPipeline(description));
+	pipeline->init(*device, renderPass, layout);
+
+	lock_guard<mutex> lock(pipelinesMutex);
+	auto found = pipelines.find(key);
+	if (found != pipelines.end())
+	{
+		hitCount++;
+		return *found->second.pipeline;
+	}
+
+	missCount++;
+	Entry& entry = pipelines[key];
+	entry.handles.push_back(reinterpret_cast<uint64_t>(static_cast<VkRenderPass>(renderPass)));
+	entry.handles.push_back(reinterpret_cast<uint64_t>(layout));
+	for (auto& info : description.shaderStageInfos)
+		entry.handles.push_back(reinterpret_cast<uint64_t>(info.module));
+	entry.pipeline = move(pipeline);
+	return *entry.pipeline;
+}
+
+void PipelineRegistry::clear()
+{
+	lock_guard<mutex> lock(pipelinesMutex);
+	pipelines.clear();
+	evicted.clear();
+	hitCount = 0;
+	missCount = 0;
+}
+
+/*
+ * The key is the raw pipeline state, so that equal keys mean equal pipelines. Structs that may
+ * contain padding are appended member by member.
+ */
+string PipelineRegistry::createKey(const GraphicsPipeline& description, RenderPass& renderPass,
+				   VkPipelineLayout layout)
+{
+	string key;
+	appendKey(key, static_cast<VkRenderPass>(renderPass));
+	appendKey(key, description.subpass);
+	appendKey(key, layout);
+
+	appendKey(key, description.shaderStageInfos.size());
+	for (auto& info : description.shaderStageInfos)
+	{
+		appendKey(key, info.flags);
+		appendKey(key, info.stage);
+		appendKey(key, info.module);
+		appendKey(key, info.pName, strlen(info.pName));
+
+		auto specialization = description.specializations.find(info.stage);
+		if (specialization != description.specializations.end())
+		{
+			appendKey(key, uint32_t{1});
+			auto& entries = specialization->second.getEntries();
+			auto& data = specialization->second.getData();
+			appendKey(key, entries.data(), entries.size() * sizeof(VkSpecializationMapEntry));
+			appendKey(key, data.data(), data.size());
+		} else
+		{
+			appendKey(key, uint32_t{0});
+			appendKey(key, info.pSpecializationInfo);
+		}
+	}
+
+	appendKey(key, description.vertexBindingDescriptions.size());
+	for (auto& binding : description.vertexBindingDescriptions)
+	{
+		appendKey(key, binding.binding);
+		appendKey(key, binding.stride);
+		appendKey(key, binding.inputRate);
+	}
+	appendKey(key, description.vertexAttributeDescriptions.size());
+	for (auto& attribute : description.vertexAttributeDescriptions)
+	{
+		appendKey(key, attribute.location);
+		appendKey(key, attribute.binding);
+		appendKey(key, attribute.format);
+		appendKey(key, attribute.offset);
+	}
+
+	appendKey(key, description.primitiveTopology);
+	appendKey(key, description.polygonMode);
+	appendKey(key, description.cullMode);
+	appendKey(key, description.frontFace);
+	appendKey(key, description.depthEnabled);
+	return key;
+}
+
+void PipelineRegistry::evict(uint64_t handle)
+{
+	lock_guard<mutex> lock(pipelinesMutex);
+	for (auto it = pipelines.begin(); it != pipelines.end();)
+	{
+		auto& handles = it->second.handles;
+		if (find(handles.begin(), handles.end(), handle) != handles.end())
+		{
+			evicted.push_back(move(it->second.pipeline));
+			it = pipelines.erase(it);
+		} else
+		{
+			it++;
+		}
+	}
+}
+
+void PipelineRegistry::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Pipeline registry not ready. Must initialize before use.");
+}
+
+}
@@ -9,7 +9,8 @@ namespace bp
 Queue::Queue(VkDevice device, uint32_t queueFamilyIndex, uint32_t queueIndex) :
 	device{device},
 	queueFamilyIndex{queueFamilyIndex},
-	queueIndex{queueIndex}
+	queueIndex{queueIndex},
+	submitMutex{new mutex}
 {
 	vkGetDeviceQueue(device, queueFamilyIndex, queueIndex, &handle);
 }
@@ -39,11 +40,19 @@ void Queue::submit(const vector<pair<VkSemaphore, VkPipelineStageFlags>>& waitSe
 	submitInfo.signalSemaphoreCount = static_cast<uint32_t>(signalSemaphores.size());
 	submitInfo.pSignalSemaphores = signalSemaphores.data();
 
+	lock_guard<mutex> lock(*submitMutex);
 	vkQueueSubmit(handle, 1, &submitInfo, fence);
 }
 
+VkResult Queue::present(const VkPresentInfoKHR& presentInfo)
+{
+	lock_guard<mutex> lock(*submitMutex);
+	return vkQueuePresentKHR(handle, &presentInfo);
+}
+
 void Queue::waitIdle()
 {
+	lock_guard<mutex> lock(*submitMutex);
 	vkQueueWaitIdle(handle);
 }
 
@@ -0,0 +1,806 @@
+#include <bp/RenderGraph.h>
+#include <bp/Swapchain.h>
+#include <bp/Util.h>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+namespace bp
+{
+
+static const VkAccessFlags WRITE_ACCESS = VK_ACCESS_SHADER_WRITE_BIT
+					  | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT
+					  | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT
+					  | VK_ACCESS_TRANSFER_WRITE_BIT
+					  | VK_ACCESS_HOST_WRITE_BIT
+					  | VK_ACCESS_MEMORY_WRITE_BIT;
+
+/*
+ * Transient textures are transitioned by the graph, not before each render pass.
+ */
+class TransientTexture : public Texture
+{
+public:
+	void before(VkCommandBuffer cmdBuffer) override {}
+};
+
+void RenderGraph::Resource::setClearValue(const VkClearValue& clearValue)
+{
+	Resource::clearValue = clearValue;
+	if (attachment != nullptr) attachment->setClearValue(clearValue);
+	if (transientTexture) transientTexture->setClearValue(clearValue);
+}
+
+void RenderGraph::Pass::writeColor(Resource& image)
+{
+	if (!isGraphics())
+		throw invalid_argument("Attachments can only be used by graphics passes.");
+	if (isDepthFormat(image.format))
+		throw invalid_argument("Color attachments must have a color format.");
+	addAccess(image, AccessType::COLOR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		  VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+		  VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, true);
+}
+
+void RenderGraph::Pass::writeDepth(Resource& image)
+{
+	if (!isGraphics())
+		throw invalid_argument("Attachments can only be used by graphics passes.");
+	if (!isDepthFormat(image.format))
+		throw invalid_argument("Depth attachments must have a depth format.");
+	addAccess(image, AccessType::DEPTH, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		  VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT
+		  | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
+		  VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
+		  | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, true);
+}
+
+void RenderGraph::Pass::readInputAttachment(Resource& image)
+{
+	if (!isGraphics())
+		throw invalid_argument("Attachments can only be used by graphics passes.");
+	addAccess(image, AccessType::INPUT, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+		  VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_INPUT_ATTACHMENT_READ_BIT, false);
+}
+
+void RenderGraph::Pass::readSampled(Resource& image, VkPipelineStageFlags stage)
+{
+	addAccess(image, AccessType::SAMPLED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, stage,
+		  VK_ACCESS_SHADER_READ_BIT, false);
+}
+
+void RenderGraph::Pass::readStorage(Resource& image, VkPipelineStageFlags stage)
+{
+	addAccess(image, AccessType::STORAGE, VK_IMAGE_LAYOUT_GENERAL, stage,
+		  VK_ACCESS_SHADER_READ_BIT, false);
+}
+
+void RenderGraph::Pass::writeStorage(Resource& image, VkPipelineStageFlags stage)
+{
+	addAccess(image, AccessType::STORAGE, VK_IMAGE_LAYOUT_GENERAL, stage,
+		  VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT, true);
+}
+
+void RenderGraph::Pass::readBuffer(Resource& buffer, VkPipelineStageFlags stage,
+				   VkAccessFlags access)
+{
+	addAccess(buffer, AccessType::BUFFER, VK_IMAGE_LAYOUT_UNDEFINED, stage, access, false);
+}
+
+void RenderGraph::Pass::writeBuffer(Resource& buffer, VkPipelineStageFlags stage,
+				    VkAccessFlags access)
+{
+	addAccess(buffer, AccessType::BUFFER, VK_IMAGE_LAYOUT_UNDEFINED, stage, access, true);
+}
+
+RenderPass& RenderGraph::Pass::getRenderPass()
+{
+	graph->assertReady();
+	if (!isGraphics()) throw runtime_error("Only graphics passes have a render pass.");
+	return *graph->steps[step].renderPass;
+}
+
+/*
+ * Imported attachments stay in the layout they are rendered in, so that their own tracking of
+ * the layout remains valid.
+ */
+void RenderGraph::Pass::addAccess(Resource& resource, AccessType type, VkImageLayout layout,
+				  VkPipelineStageFlags stage, VkAccessFlags access, bool write)
+{
+	if (graph->isReady())
+		throw runtime_error("Cannot add resource accesses after initialization of render "
+				    "graph.");
+	if (resource.image && type == AccessType::BUFFER)
+		throw invalid_argument("Resource is not a buffer.");
+	if (!resource.image && type != AccessType::BUFFER)
+		throw invalid_argument("Resource is not an image.");
+	if (resource.attachment != nullptr
+	    && (!(type == AccessType::COLOR || type == AccessType::DEPTH)
+		|| resource.attachment->getInitialLayout() != layout
+		|| resource.attachment->getFinalLayout() != layout))
+		throw invalid_argument("Imported attachments can only be used as color or depth "
+				       "attachments in the layout they are rendered in.");
+	for (auto& a : accesses)
+		if (a.resource == &resource)
+			throw invalid_argument("Resource is already accessed by the pass.");
+
+	accesses.push_back({&resource, type, layout, stage, access, write});
+}
+
+RenderGraph::~RenderGraph()
+{
+	if (isReady()) destroyBuffers();
+}
+
+RenderGraph::Resource& RenderGraph::addImage(VkFormat format, bool clear)
+{
+	if (isReady())
+		throw runtime_error("Cannot add resources after initialization of render graph.");
+	unique_ptr<Resource> resource{new Resource()};
+	resource->format = format;
+	resource->clear = clear;
+	if (isDepthFormat(format)) resource->clearValue.depthStencil = {1.f, 0};
+	resources.push_back(move(resource));
+	return *resources.back();
+}
+
+RenderGraph::Resource& RenderGraph::addBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	if (isReady())
+		throw runtime_error("Cannot add resources after initialization of render graph.");
+	unique_ptr<Resource> resource{new Resource()};
+	resource->image = false;
+	resource->size = size;
+	resource->bufferUsage = usage;
+	resources.push_back(move(resource));
+	return *resources.back();
+}
+
+RenderGraph::Resource& RenderGraph::importAttachment(Attachment& attachment, bool clear)
+{
+	if (isReady())
+		throw runtime_error("Cannot add resources after initialization of render graph.");
+	Texture* texture = dynamic_cast<Texture*>(&attachment);
+	if (texture == nullptr && dynamic_cast<Swapchain*>(&attachment) == nullptr)
+		throw invalid_argument("Unsupported attachment implementation.");
+
+	unique_ptr<Resource> resource{new Resource()};
+	resource->format = attachment.getFormat();
+	resource->clear = clear;
+	resource->clearValue = attachment.getClearValue();
+	resource->attachment = &attachment;
+	resource->texture = texture;
+	resources.push_back(move(resource));
+	return *resources.back();
+}
+
+RenderGraph::Resource& RenderGraph::importBuffer(Buffer& buffer)
+{
+	if (isReady())
+		throw runtime_error("Cannot add resources after initialization of render graph.");
+	unique_ptr<Resource> resource{new Resource()};
+	resource->image = false;
+	resource->size = buffer.getSize();
+	resource->importedBuffer = &buffer;
+	resource->buffer = buffer.getHandle();
+	resources.push_back(move(resource));
+	return *resources.back();
+}
+
+RenderGraph::Pass& RenderGraph::addGraphicsPass(Subpass& subpass)
+{
+	if (isReady())
+		throw runtime_error("Cannot add passes after initialization of render graph.");
+	unique_ptr<Pass> pass{new Pass()};
+	pass->graph = this;
+	pass->subpass = &subpass;
+	passes.push_back(move(pass));
+	return *passes.back();
+}
+
+RenderGraph::Pass& RenderGraph::addPass(const function<void(VkCommandBuffer)>& callback)
+{
+	if (isReady())
+		throw runtime_error("Cannot add passes after initialization of render graph.");
+	unique_ptr<Pass> pass{new Pass()};
+	pass->graph = this;
+	pass->callback = callback;
+	passes.push_back(move(pass));
+	return *passes.back();
+}
+
+void RenderGraph::init(Device& device, uint32_t width, uint32_t height)
+{
+	if (isReady()) throw runtime_error("Render graph already initialized.");
+	if (passes.empty()) throw runtime_error("No passes added to render graph.");
+
+	RenderGraph::width = width;
+	RenderGraph::height = height;
+
+	schedule();
+	computeLifetimes();
+
+	RenderGraph::device = &device;
+	barrierBatch.init(device);
+	allocateMemory();
+	createSteps();
+}
+
+/*
+ * Imported attachments may have been recreated at the same size, e.g. when the swapchain is
+ * recreated, so framebuffers using them are always recreated.
+ */
+void RenderGraph::resize(uint32_t width, uint32_t height)
+{
+	assertReady();
+	bool sizeChanged = width != RenderGraph::width || height != RenderGraph::height;
+	RenderGraph::width = width;
+	RenderGraph::height = height;
+
+	if (sizeChanged) allocateMemory();
+
+	for (auto& step : steps)
+	{
+		if (!step.renderPass) continue;
+		bool imported = any_of(step.attachments.begin(), step.attachments.end(),
+				       [](const AttachmentUse& u) { return !u.resource->isTransient(); });
+		if (!sizeChanged && !imported) continue;
+		step.renderPass->setRenderArea({{0, 0}, {width, height}});
+		step.framebuffer->resize(width, height);
+	}
+}
+
+void RenderGraph::render(VkCommandBuffer cmdBuffer)
+{
+	assertReady();
+	for (auto& r : resources) r->used = false;
+
+	for (auto& step : steps)
+	{
+		for (auto& use : step.attachments)
+			addBarrier(*use.resource, use.layout, use.stages, use.access, use.write);
+		for (auto pass : step.passes)
+		{
+			for (auto& a : pass->accesses)
+			{
+				if (a.isAttachment()) continue;
+				addBarrier(*a.resource, a.layout, a.stage, a.access, a.write);
+			}
+		}
+		barrierBatch.record(cmdBuffer);
+
+		if (step.renderPass) step.renderPass->render(*step.framebuffer, cmdBuffer);
+		else step.passes[0]->callback(cmdBuffer);
+
+		for (auto& use : step.attachments) use.resource->state.layout = use.finalLayout;
+	}
+}
+
+uint32_t RenderGraph::getRenderPassCount() const
+{
+	uint32_t count = 0;
+	for (auto& step : steps)
+		if (step.renderPass) count++;
+	return count;
+}
+
+/*
+ * A pass depends on the passes added before it that access the same resources in conflicting
+ * ways. Ready graphics passes are merged into the open render pass when possible, otherwise the
+ * first ready pass in the order they were added starts a new step.
+ */
+void RenderGraph::schedule()
+{
+	size_t count = passes.size();
+	vector<vector<size_t>> dependents(count);
+	vector<size_t> dependencyCounts(count, 0);
+	for (size_t i = 0; i < count; i++)
+	{
+		for (size_t j = i + 1; j < count; j++)
+		{
+			bool dependent = false;
+			for (auto& a : passes[i]->accesses)
+				for (auto& b : passes[j]->accesses)
+					if (a.conflicts(b)) dependent = true;
+			if (!dependent) continue;
+			dependents[i].push_back(j);
+			dependencyCounts[j]++;
+		}
+	}
+
+	vector<bool> scheduled(count, false);
+	bool open = false;
+	for (size_t n = 0; n < count; n++)
+	{
+		size_t next = count;
+		for (size_t i = 0; open && i < count; i++)
+		{
+			if (scheduled[i] || dependencyCounts[i] > 0) continue;
+			if (canMerge(steps.back(), *passes[i]))
+			{
+				next = i;
+				break;
+			}
+		}
+		if (next == count)
+		{
+			for (size_t i = 0; i < count; i++)
+			{
+				if (scheduled[i] || dependencyCounts[i] > 0) continue;
+				next = i;
+				break;
+			}
+			steps.emplace_back();
+		}
+
+		Pass& pass = *passes[next];
+		pass.step = steps.size() - 1;
+		pass.subpassIndex = static_cast<uint32_t>(steps.back().passes.size());
+		steps.back().passes.push_back(&pass);
+		scheduled[next] = true;
+		open = pass.isGraphics();
+		for (auto d : dependents[next]) dependencyCounts[d]--;
+	}
+}
+
+/*
+ * Subpasses can only depend on each other through attachments, as other accesses would need
+ * barriers within the render pass.
+ */
+bool RenderGraph::canMerge(const Step& step, const Pass& pass) const
+{
+	if (!pass.isGraphics()) return false;
+	for (auto p : step.passes)
+	{
+		for (auto& a : p->accesses)
+		{
+			for (auto& b : pass.accesses)
+			{
+				if (a.resource == b.resource && !(a.isAttachment() && b.isAttachment()))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+/*
+ * Transient images only used as attachments within one render pass never need to be stored, and
+ * can be kept in tile memory on tiled GPUs.
+ */
+void RenderGraph::computeLifetimes()
+{
+	for (size_t i = 0; i < steps.size(); i++)
+	{
+		int step = static_cast<int>(i);
+		for (auto pass : steps[i].passes)
+		{
+			for (auto& a : pass->accesses)
+			{
+				Resource& r = *a.resource;
+				if (r.lastStep >= 0 && r.lastStep != step
+				    && dynamic_cast<Swapchain*>(r.attachment) != nullptr)
+					throw runtime_error("A swapchain can only be used in one render pass "
+							    "of the graph.");
+				if (r.firstStep < 0) r.firstStep = step;
+				r.lastStep = step;
+			}
+		}
+	}
+
+	for (auto& r : resources)
+	{
+		if (!r->image || !r->isTransient() || r->firstStep < 0) continue;
+
+		bool attachmentsOnly = true;
+		r->imageUsage = 0;
+		for (auto& pass : passes)
+		{
+			for (auto& a : pass->accesses)
+			{
+				if (a.resource != r.get()) continue;
+				switch (a.type)
+				{
+				case Pass::AccessType::COLOR:
+					r->imageUsage |= VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+					break;
+				case Pass::AccessType::DEPTH:
+					r->imageUsage |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+					break;
+				case Pass::AccessType::INPUT:
+					r->imageUsage |= VK_IMAGE_USAGE_INPUT_ATTACHMENT_BIT;
+					break;
+				case Pass::AccessType::SAMPLED:
+					r->imageUsage |= VK_IMAGE_USAGE_SAMPLED_BIT;
+					break;
+				case Pass::AccessType::STORAGE:
+					r->imageUsage |= VK_IMAGE_USAGE_STORAGE_BIT;
+					break;
+				default:
+					break;
+				}
+				if (!a.isAttachment()) attachmentsOnly = false;
+			}
+		}
+		if (attachmentsOnly && r->firstStep == r->lastStep)
+			r->imageUsage |= VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+	}
+}
+
+/*
+ * Create the transient resources in newly allocated memory. Textures keep the memory they were
+ * bound to alive until they are recreated.
+ */
+void RenderGraph::allocateMemory()
+{
+	destroyBuffers();
+	for (auto& r : resources)
+	{
+		if (!r->isTransient() || r->firstStep < 0) continue;
+		r->state = {};
+		r->used = false;
+		if (r->image)
+		{
+			r->requirements = Image::getMemoryRequirements(*device, width, height, r->format,
+								       VK_IMAGE_TILING_OPTIMAL,
+								       r->imageUsage);
+			continue;
+		}
+
+		VkBufferCreateInfo info = {};
+		info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		info.size = r->size;
+		info.usage = r->bufferUsage;
+		info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VkResult result = vkCreateBuffer(*device, &info, nullptr, &r->buffer);
+		if (result != VK_SUCCESS) throw runtime_error("Failed to create buffer.");
+		vkGetBufferMemoryRequirements(*device, r->buffer, &r->requirements);
+	}
+
+	placeResources();
+	for (auto& heap : heaps)
+	{
+		VkMemoryPropertyFlags preferredFlags =
+			heap.lazy ? VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT : 0;
+		heap.memory = device->getMemoryAllocator().allocateMemory(heap.requirements,
+									  VMA_MEMORY_USAGE_GPU_ONLY,
+									  MemoryPool::ATTACHMENT,
+									  preferredFlags);
+	}
+
+	for (auto& r : resources)
+	{
+		if (!r->isTransient() || r->firstStep < 0) continue;
+		Heap& heap = heaps[r->heap];
+		if (!r->image)
+		{
+			VkResult result = vkBindBufferMemory(*device, r->buffer,
+							     heap.memory->getDeviceMemory(),
+							     heap.memory->getOffset() + r->offset);
+			if (result != VK_SUCCESS) throw runtime_error("Failed to bind buffer memory.");
+			continue;
+		}
+
+		if (!r->transientTexture)
+		{
+			r->transientTexture.reset(new TransientTexture());
+			r->texture = r->transientTexture.get();
+			r->transientTexture->setMemory(heap.memory, r->offset);
+			r->transientTexture->init(*device, r->format, r->imageUsage, width, height);
+			r->transientTexture->setClearValue(r->clearValue);
+		} else
+		{
+			r->transientTexture->setMemory(heap.memory, r->offset);
+			r->transientTexture->resize(width, height);
+		}
+	}
+}
+
+/*
+ * Largest first, each resource is placed at the lowest offset where it does not overlap the
+ * resources with overlapping lifetimes, in a heap with memory types it can use. Images and
+ * buffers get separate heaps, so that linear and optimal resources never need to be kept
+ * bufferImageGranularity apart, and so do transient attachments, so that their heaps can be
+ * lazily allocated.
+ */
+void RenderGraph::placeResources()
+{
+	heaps.clear();
+	transientMemorySize = 0;
+
+	vector<Resource*> sorted;
+	for (auto& r : resources)
+	{
+		if (!r->isTransient() || r->firstStep < 0) continue;
+		r->aliases.clear();
+		sorted.push_back(r.get());
+	}
+	stable_sort(sorted.begin(), sorted.end(), [](const Resource* a, const Resource* b) {
+		return a->requirements.size > b->requirements.size;
+	});
+
+	vector<Resource*> placed;
+	for (auto r : sorted)
+	{
+		bool lazy = r->image && r->imageUsage & VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT;
+		size_t h = 0;
+		for (; h < heaps.size(); h++)
+		{
+			if (heaps[h].images == r->image && heaps[h].lazy == lazy
+			    && (heaps[h].requirements.memoryTypeBits & r->requirements.memoryTypeBits))
+				break;
+		}
+		if (h == heaps.size())
+			heaps.push_back({r->image, lazy, {0, 1, r->requirements.memoryTypeBits},
+					 nullptr});
+		Heap& heap = heaps[h];
+		heap.requirements.memoryTypeBits &= r->requirements.memoryTypeBits;
+		heap.requirements.alignment = max(heap.requirements.alignment,
+						  r->requirements.alignment);
+
+		vector<pair<VkDeviceSize, VkDeviceSize>> ranges;
+		for (auto other : placed)
+		{
+			if (other->heap == h && other->firstStep <= r->lastStep
+			    && r->firstStep <= other->lastStep)
+				ranges.emplace_back(other->offset, other->offset + other->requirements.size);
+		}
+		sort(ranges.begin(), ranges.end());
+
+		VkDeviceSize alignment = r->requirements.alignment;
+		VkDeviceSize offset = 0;
+		for (auto& range : ranges)
+		{
+			if (offset + r->requirements.size <= range.first) break;
+			offset = max(offset, (range.second + alignment - 1) / alignment * alignment);
+		}
+
+		r->heap = h;
+		r->offset = offset;
+		heap.requirements.size = max(heap.requirements.size, offset + r->requirements.size);
+		placed.push_back(r);
+	}
+
+	for (auto a : placed)
+	{
+		for (auto b : placed)
+		{
+			if (a != b && a->heap == b->heap && a->offset < b->offset + b->requirements.size
+			    && b->offset < a->offset + a->requirements.size)
+				a->aliases.push_back(b);
+		}
+	}
+	for (auto& heap : heaps) transientMemorySize += heap.requirements.size;
+}
+
+void RenderGraph::createSteps()
+{
+	for (size_t i = 0; i < steps.size(); i++)
+		if (steps[i].passes[0]->isGraphics()) createRenderPass(steps[i], i);
+}
+
+/*
+ * Each resource used as an attachment gets one slot in the render pass. Transient attachments
+ * start in the layout of their first use and end in the layout of their last, leaving the
+ * transitions between them to the subpass dependencies.
+ */
+void RenderGraph::createRenderPass(Step& step, size_t index)
+{
+	int stepIndex = static_cast<int>(index);
+	for (auto pass : step.passes)
+	{
+		for (auto& a : pass->accesses)
+		{
+			if (!a.isAttachment()) continue;
+			auto use = find_if(step.attachments.begin(), step.attachments.end(),
+					   [&a](const AttachmentUse& u) { return u.resource == a.resource; });
+			if (use == step.attachments.end())
+			{
+				step.slots.emplace_back(new AttachmentSlot());
+				step.attachments.push_back({a.resource, step.slots.back().get(), a.layout,
+							    a.layout, 0, 0, false});
+				use = step.attachments.end() - 1;
+			}
+			use->finalLayout = a.layout;
+			use->stages |= a.stage;
+			use->access |= a.access;
+			use->write = use->write || a.write;
+
+			switch (a.type)
+			{
+			case Pass::AccessType::COLOR:
+				pass->subpass->addColorAttachment(*use->slot);
+				break;
+			case Pass::AccessType::DEPTH:
+				pass->subpass->setDepthAttachment(*use->slot);
+				break;
+			default:
+				pass->subpass->addInputAttachment(*use->slot, a.layout);
+				break;
+			}
+		}
+	}
+
+	for (auto& use : step.attachments)
+	{
+		Resource& r = *use.resource;
+		bool first = r.firstStep == stepIndex;
+		VkAttachmentLoadOp loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		if (first && r.clear) loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		else if (first && r.isTransient()) loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+
+		if (r.isTransient())
+		{
+			use.slot->init(r.format, VK_SAMPLE_COUNT_1_BIT, loadOp,
+				       VK_ATTACHMENT_STORE_OP_STORE, use.layout, use.finalLayout);
+			use.slot->setUsedAfterPass(r.lastStep > stepIndex);
+		} else
+		{
+			use.slot->init(r.format, VK_SAMPLE_COUNT_1_BIT, loadOp,
+				       VK_ATTACHMENT_STORE_OP_STORE, r.attachment->getInitialLayout(),
+				       r.attachment->getFinalLayout());
+		}
+	}
+
+	/*
+	 * The passes only share attachments, so the dependencies between them are by region.
+	 */
+	for (size_t i = 0; i < step.passes.size(); i++)
+	{
+		for (size_t j = i + 1; j < step.passes.size(); j++)
+		{
+			Subpass::DependencyInfo info = {};
+			for (auto& a : step.passes[i]->accesses)
+			{
+				for (auto& b : step.passes[j]->accesses)
+				{
+					if (!a.conflicts(b)) continue;
+					info.srcStageMask |= a.stage;
+					info.dstStageMask |= b.stage;
+					info.srcAccessMask |= a.access & WRITE_ACCESS;
+					info.dstAccessMask |= b.access;
+				}
+			}
+			if (info.srcStageMask == 0) continue;
+			info.dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			step.passes[i]->subpass->addDependency(*step.passes[j]->subpass, info);
+		}
+	}
+
+	step.renderPass.reset(new RenderPass());
+	for (auto pass : step.passes) step.renderPass->addSubpass(*pass->subpass);
+	step.renderPass->setRenderArea({{0, 0}, {width, height}});
+	step.renderPass->init(*device);
+
+	step.framebuffer.reset(new Framebuffer());
+	for (auto& use : step.attachments)
+	{
+		Resource& r = *use.resource;
+		Attachment* attachment = r.attachment != nullptr ? r.attachment : r.texture;
+		step.framebuffer->setAttachment(*use.slot, *attachment);
+	}
+	step.framebuffer->init(*step.renderPass, width, height);
+}
+
+/*
+ * Reads of a resource in the layout it is already in only wait for the writes they have not
+ * seen yet. Anything else waits for all earlier accesses. Transient resources are discarded on
+ * their first use in a frame, which must also wait for the resources sharing their memory.
+ * Imported attachments are transitioned by the attachment itself on their first use.
+ */
+void RenderGraph::addBarrier(Resource& resource, VkImageLayout layout,
+			     VkPipelineStageFlags stage, VkAccessFlags access, bool write)
+{
+	Resource::State& state = resource.state;
+	bool discard = resource.isTransient() && !resource.used;
+	bool transition = resource.image && (discard || state.layout != layout);
+	bool record = resource.attachment == nullptr || resource.used;
+	resource.used = true;
+
+	if (!write && !transition)
+	{
+		bool visible = (state.visibleStages & stage) == stage
+			       && (state.visibleAccess & access) == access;
+		if (record && state.writeStages != 0 && !visible)
+		{
+			addResourceBarrier(resource, layout, layout, state.writeStages,
+					   state.writeAccess, stage, access);
+		}
+		state.readStages |= stage;
+		state.visibleStages |= stage;
+		state.visibleAccess |= access;
+		return;
+	}
+
+	VkPipelineStageFlags srcStage = state.writeStages | state.readStages;
+	VkAccessFlags srcAccess = state.writeAccess;
+	if (discard)
+	{
+		VkPipelineStageFlags aliasStages = 0;
+		VkAccessFlags aliasAccess = 0;
+		for (auto alias : resource.aliases)
+		{
+			aliasStages |= alias->state.writeStages | alias->state.readStages;
+			aliasAccess |= alias->state.writeAccess;
+		}
+		srcStage |= aliasStages;
+
+		if (aliasAccess != 0)
+		{
+			VkMemoryBarrier barrier = {};
+			barrier.srcAccessMask = aliasAccess;
+			barrier.dstAccessMask = access;
+			barrierBatch.addMemoryBarrier(barrier, aliasStages, stage);
+		}
+	}
+
+	if (record && (transition || srcStage != 0))
+	{
+		addResourceBarrier(resource, discard ? VK_IMAGE_LAYOUT_UNDEFINED : state.layout,
+				   layout, srcStage, srcAccess, stage, access);
+	}
+
+	/*
+	 * A layout transition counts as a write, which later reads in other stages must wait for.
+	 */
+	state.layout = layout;
+	state.writeStages = stage;
+	state.writeAccess = write ? access & WRITE_ACCESS : 0;
+	state.readStages = write ? 0 : stage;
+	state.visibleStages = write ? 0 : stage;
+	state.visibleAccess = write ? 0 : access;
+}
+
+void RenderGraph::addResourceBarrier(Resource& resource, VkImageLayout oldLayout,
+				     VkImageLayout newLayout, VkPipelineStageFlags srcStage,
+				     VkAccessFlags srcAccess, VkPipelineStageFlags dstStage,
+				     VkAccessFlags dstAccess)
+{
+	if (!resource.image)
+	{
+		VkBufferMemoryBarrier barrier = {};
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = resource.buffer;
+		barrier.offset = 0;
+		barrier.size = VK_WHOLE_SIZE;
+		barrierBatch.addBufferBarrier(barrier, srcStage, dstStage);
+		return;
+	}
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.srcAccessMask = srcAccess;
+	barrier.dstAccessMask = dstAccess;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = resource.texture->getImage().getHandle();
+	barrier.subresourceRange.aspectMask = getAspectFlags(resource.format);
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrierBatch.addImageBarrier(barrier, srcStage, dstStage);
+}
+
+void RenderGraph::destroyBuffers()
+{
+	for (auto& r : resources)
+	{
+		if (r->image || !r->isTransient() || r->buffer == VK_NULL_HANDLE) continue;
+		vkDestroyBuffer(*device, r->buffer, nullptr);
+		r->buffer = VK_NULL_HANDLE;
+	}
+}
+
+void RenderGraph::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Render graph not ready. Must initialize before use.");
+}
+
+}
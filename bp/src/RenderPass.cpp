@@ -12,11 +12,22 @@ RenderPass::~RenderPass()
 {
 	if (isReady())
 	{
+		device->notifyDestroyed(handle);
 		vkDestroyRenderPass(*device, handle, nullptr);
 	}
 }
 
 void RenderPass::addSubpassGraph(Subpass& subpass)
+{
+	addSubpass(subpass);
+
+	for (auto s : subpass.dependents)
+	{
+		addSubpassGraph(*s);
+	}
+}
+
+void RenderPass::addSubpass(Subpass& subpass)
 {
 	subpasses.push_back(&subpass);
 
@@ -24,11 +35,6 @@ void RenderPass::addSubpassGraph(Subpass& subpass)
 	for (auto a : subpass.colorAttachments) addAttachment(a);
 	for (auto a : subpass.resolveAttachments) addAttachment(a);
 	if (subpass.depthAttachment != nullptr) addAttachment(subpass.depthAttachment);
-
-	for (auto s : subpass.dependents)
-	{
-		addSubpassGraph(*s);
-	}
 }
 
 void RenderPass::init(Device& device)
@@ -43,7 +49,13 @@ void RenderPass::init(Device& device)
 
 	for (const AttachmentSlot* attachment : attachmentSlots)
 	{
-		attachmentDescriptions.push_back(attachment->getDescription());
+		VkAttachmentDescription description = attachment->getDescription();
+		if (!attachment->isUsedAfterPass())
+		{
+			description.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+			description.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		}
+		attachmentDescriptions.push_back(description);
 	}
 
 	for (Subpass* subpass : subpasses)
@@ -132,13 +144,22 @@ void RenderPass::render(Framebuffer& framebuffer, VkCommandBuffer cmdBuffer)
 	beginInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	beginInfo.pClearValues = clearValues.data();
 
-	vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+	for (uint32_t i = 0; i < subpasses.size(); i++)
+	{
+		VkCommandBufferInheritanceInfo& inheritanceInfo = subpasses[i]->inheritanceInfo;
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = handle;
+		inheritanceInfo.subpass = i;
+		inheritanceInfo.framebuffer = framebuffer;
+	}
+
+	vkCmdBeginRenderPass(cmdBuffer, &beginInfo, subpasses[0]->getContents());
 
 	subpasses[0]->render(renderArea, cmdBuffer);
 
 	for (auto i = 1; i < subpasses.size(); i++)
 	{
-		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdNextSubpass(cmdBuffer, subpasses[i]->getContents());
 		subpasses[i]->render(renderArea, cmdBuffer);
 	}
 
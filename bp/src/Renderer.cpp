@@ -20,6 +20,7 @@ void Renderer::init(Device& device, VkFormat colorFormat, uint32_t width, uint32
 				 VK_ATTACHMENT_LOAD_OP_CLEAR, VK_ATTACHMENT_STORE_OP_STORE,
 				 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
 				 VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+	depthAttachmentSlot.setUsedAfterPass(depthUsedAfterPass);
 
 	setupSubpasses();
 
@@ -36,6 +37,13 @@ void Renderer::resize(uint32_t width, uint32_t height)
 	renderPass.setRenderArea({{}, {width, height}});
 }
 
+void Renderer::setDepthUsedAfterPass(bool used)
+{
+	if (isReady())
+		throw runtime_error("Cannot change depth usage after initialization of renderer.");
+	depthUsedAfterPass = used;
+}
+
 void Renderer::render(Framebuffer& fbo, VkCommandBuffer cmdBuffer)
 {
 	renderPass.render(fbo, cmdBuffer);
@@ -0,0 +1,62 @@
+#include <bp/RetireQueue.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bp
+{
+
+RetireQueue::~RetireQueue()
+{
+	flush();
+}
+
+void RetireQueue::setFrameCount(uint32_t frameCount)
+{
+	flush();
+	lock_guard<mutex> lock(retiredMutex);
+	frames.clear();
+	frames.resize(frameCount);
+	frameIndex = 0;
+}
+
+void RetireQueue::beginFrame(uint32_t frameIndex)
+{
+	vector<function<void()>> retired;
+	{
+		lock_guard<mutex> lock(retiredMutex);
+		if (frameIndex >= frames.size()) throw out_of_range("Invalid frame index.");
+		RetireQueue::frameIndex = frameIndex;
+		retired.swap(frames[frameIndex]);
+	}
+	for (auto& destroy : retired) destroy();
+}
+
+void RetireQueue::retire(const function<void()>& destroy)
+{
+	{
+		lock_guard<mutex> lock(retiredMutex);
+		if (!frames.empty())
+		{
+			frames[frameIndex].push_back(destroy);
+			return;
+		}
+	}
+	destroy();
+}
+
+void RetireQueue::flush()
+{
+	vector<function<void()>> retired;
+	{
+		lock_guard<mutex> lock(retiredMutex);
+		for (auto& frame : frames)
+		{
+			for (auto& destroy : frame) retired.push_back(move(destroy));
+			frame.clear();
+		}
+	}
+	for (auto& destroy : retired) destroy();
+}
+
+}
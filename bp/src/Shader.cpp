@@ -1,5 +1,4 @@
 #include <bp/Shader.h>
-#include <shaderc/shaderc.hpp>
 #include <stdexcept>
 
 using namespace std;
@@ -28,55 +27,29 @@ void Shader::init(Device& device, VkShaderStageFlagBits stage, uint32_t codeSize
 	pipelineShaderStageInfo.stage = stage;
 	pipelineShaderStageInfo.module = handle;
 	pipelineShaderStageInfo.pName = "main";
-	pipelineShaderStageInfo.pSpecializationInfo = nullptr;
+	pipelineShaderStageInfo.pSpecializationInfo = specialization.getInfo();
 }
 
-void Shader::init(Device& device, VkShaderStageFlagBits stage,
-		  const std::string& glslSource)
+void Shader::init(Device& device, VkShaderStageFlagBits stage, const string& glslSource,
+		  const ShaderCompileOptions& options)
 {
-	shaderc::Compiler compiler;
-
-	shaderc_shader_kind kind;
-	switch (stage)
-	{
-	case VK_SHADER_STAGE_VERTEX_BIT:
-		kind = shaderc_vertex_shader;
-		break;
-	case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
-		kind = shaderc_tess_control_shader;
-		break;
-	case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
-		kind = shaderc_tess_evaluation_shader;
-		break;
-	case VK_SHADER_STAGE_GEOMETRY_BIT:
-		kind = shaderc_geometry_shader;
-		break;
-	case VK_SHADER_STAGE_FRAGMENT_BIT:
-		kind = shaderc_fragment_shader;
-		break;
-	case VK_SHADER_STAGE_COMPUTE_BIT:
-		kind = shaderc_compute_shader;
-		break;
-	default:
-		kind = shaderc_glsl_infer_from_source;
-		break;
-	}
-
-	auto result = compiler.CompileGlslToSpv(glslSource, kind, "bp Shader");
-
-	if (result.GetNumErrors() > 0)
-		throw runtime_error(result.GetErrorMessage());
+	vector<uint32_t> code = device.getShaderCompiler().compile({stage, glslSource}, options);
+	init(device, stage, static_cast<uint32_t>(code.size() * sizeof(uint32_t)), code.data());
+}
 
-	const uint32_t* code = result.begin();
-	uint32_t size = static_cast<uint32_t>(reinterpret_cast<uint64_t>(result.end())
-					      - reinterpret_cast<uint64_t>(code));
-	init(device, stage, size, code);
+void Shader::setSpecializationConstants(const SpecializationConstants& constants)
+{
+	specialization = constants;
+	pipelineShaderStageInfo.pSpecializationInfo = specialization.getInfo();
 }
 
 Shader::~Shader()
 {
 	if (isReady())
+	{
+		device->notifyDestroyed(handle);
 		vkDestroyShaderModule(*device, handle, nullptr);
+	}
 }
 
 }
\ No newline at end of file
@@ -0,0 +1,241 @@
+#include <bp/ShaderCompiler.h>
+#include <bp/Shader.h>
+#include <shaderc/shaderc.hpp>
+#include <stdexcept>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <algorithm>
+#include <cstdio>
+#include <functional>
+
+using namespace std;
+
+namespace bp
+{
+
+static const uint32_t SPIRV_MAGIC = 0x07230203;
+
+/*
+ * Bump when the way sources are compiled changes, to invalidate old cache entries.
+ */
+static const uint32_t CACHE_VERSION = 1;
+
+static shaderc_shader_kind getShaderKind(VkShaderStageFlagBits stage)
+{
+	switch (stage)
+	{
+	case VK_SHADER_STAGE_VERTEX_BIT: return shaderc_vertex_shader;
+	case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT: return shaderc_tess_control_shader;
+	case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT: return shaderc_tess_evaluation_shader;
+	case VK_SHADER_STAGE_GEOMETRY_BIT: return shaderc_geometry_shader;
+	case VK_SHADER_STAGE_FRAGMENT_BIT: return shaderc_fragment_shader;
+	case VK_SHADER_STAGE_COMPUTE_BIT: return shaderc_compute_shader;
+	default: return shaderc_glsl_infer_from_source;
+	}
+}
+
+static shaderc_optimization_level getOptimizationLevel(ShaderOptimization optimization)
+{
+	switch (optimization)
+	{
+	case ShaderOptimization::SIZE: return shaderc_optimization_level_size;
+	case ShaderOptimization::PERFORMANCE: return shaderc_optimization_level_performance;
+	default: return shaderc_optimization_level_zero;
+	}
+}
+
+static void hashBytes(uint64_t& hash, const void* data, size_t size)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ull;
+	}
+}
+
+static void hashString(uint64_t& hash, const string& s)
+{
+	uint64_t size = s.size();
+	hashBytes(hash, &size, sizeof(size));
+	hashBytes(hash, s.data(), s.size());
+}
+
+/*
+ * 128 bit key made of two FNV-1a hashes with different offset bases, over everything that
+ * affects the compiled code.
+ */
+static string createKey(const ShaderSource& source, const ShaderCompileOptions& options)
+{
+	uint64_t hashes[2] = {0xCBF29CE484222325ull, 0x84222325CBF29CE4ull};
+	for (uint64_t& hash : hashes)
+	{
+		uint32_t header[4] = {CACHE_VERSION, static_cast<uint32_t>(source.stage),
+				      static_cast<uint32_t>(options.optimization),
+				      options.debugInfo ? 1u : 0u};
+		hashBytes(hash, header, sizeof(header));
+		hashString(hash, source.glsl);
+		for (auto& macro : options.macros)
+		{
+			hashString(hash, macro.first);
+			hashString(hash, macro.second);
+		}
+	}
+
+	stringstream ss;
+	ss << hex << setfill('0') << setw(16) << hashes[0] << setw(16) << hashes[1];
+	return ss.str();
+}
+
+ShaderCompiler::ShaderCompiler() :
+	compiler{new shaderc::Compiler} {}
+
+ShaderCompiler::~ShaderCompiler() = default;
+
+void ShaderCompiler::setCacheDirectory(const string& path)
+{
+	lock_guard<mutex> lock(cacheMutex);
+	cacheDirectory = path;
+}
+
+vector<uint32_t> ShaderCompiler::compile(const ShaderSource& source,
+					 const ShaderCompileOptions& options)
+{
+	string key = createKey(source, options);
+	vector<uint32_t> code;
+	if (readCache(key, code)) return code;
+
+	shaderc::CompileOptions compileOptions;
+	compileOptions.SetOptimizationLevel(getOptimizationLevel(options.optimization));
+	if (options.debugInfo) compileOptions.SetGenerateDebugInfo();
+	for (auto& macro : options.macros)
+		compileOptions.AddMacroDefinition(macro.first, macro.second);
+
+	auto result = compiler->CompileGlslToSpv(source.glsl, getShaderKind(source.stage),
+						 "bp Shader", compileOptions);
+	if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+		throw runtime_error(result.GetErrorMessage());
+
+	code.assign(result.begin(), result.end());
+	writeCache(key, code);
+	return code;
+}
+
+vector<vector<uint32_t>> ShaderCompiler::compileBatch(const vector<ShaderSource>& sources,
+						      const ShaderCompileOptions& options,
+						      unsigned workerCount)
+{
+	if (workerCount == 0) workerCount = max(thread::hardware_concurrency(), 1u);
+	workerCount = min(workerCount, static_cast<unsigned>(sources.size()));
+
+	vector<vector<uint32_t>> results(sources.size());
+	atomic<size_t> next{0};
+	exception_ptr error;
+	mutex errorMutex;
+
+	auto work = [&] {
+		for (size_t i = next++; i < sources.size(); i = next++)
+		{
+			try
+			{
+				results[i] = compile(sources[i], options);
+			} catch (...)
+			{
+				lock_guard<mutex> lock(errorMutex);
+				if (!error) error = current_exception();
+			}
+		}
+	};
+
+	vector<thread> workers;
+	for (unsigned i = 1; i < workerCount; i++) workers.emplace_back(work);
+	work();
+	for (auto& worker : workers) worker.join();
+
+	if (error) rethrow_exception(error);
+	return results;
+}
+
+void ShaderCompiler::createShaders(Device& device, const vector<ShaderSource>& sources,
+				   const vector<Shader*>& shaders,
+				   const ShaderCompileOptions& options, unsigned workerCount)
+{
+	if (sources.size() != shaders.size())
+		throw invalid_argument("Shader and source counts do not match.");
+
+	auto results = compileBatch(sources, options, workerCount);
+	for (size_t i = 0; i < shaders.size(); i++)
+	{
+		shaders[i]->init(device, sources[i].stage,
+				 static_cast<uint32_t>(results[i].size() * sizeof(uint32_t)),
+				 results[i].data());
+	}
+}
+
+bool ShaderCompiler::readCache(const string& key, vector<uint32_t>& code)
+{
+	string directory;
+	{
+		lock_guard<mutex> lock(cacheMutex);
+		auto found = cache.find(key);
+		if (found != cache.end())
+		{
+			code = found->second;
+			return true;
+		}
+		directory = cacheDirectory;
+	}
+	if (directory.empty()) return false;
+
+	ifstream file(directory + "/" + key + ".spv", ios::ate | ios::binary);
+	if (!file.is_open()) return false;
+
+	size_t size = static_cast<size_t>(file.tellg());
+	if (size == 0 || size % sizeof(uint32_t) != 0) return false;
+	code.resize(size / sizeof(uint32_t));
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(code.data()), size);
+	if (!file || code[0] != SPIRV_MAGIC) return false;
+
+	lock_guard<mutex> lock(cacheMutex);
+	cache[key] = code;
+	return true;
+}
+
+void ShaderCompiler::writeCache(const string& key, const vector<uint32_t>& code)
+{
+	string directory;
+	{
+		lock_guard<mutex> lock(cacheMutex);
+		cache[key] = code;
+		directory = cacheDirectory;
+	}
+	if (directory.empty()) return;
+
+	/*
+	 * Several threads or processes may compile the same source, so each writes its own
+	 * temporary file and renames it into place. Failing to write the cache is not an error.
+	 */
+	stringstream tmpPath;
+	tmpPath << directory << "/" << key << "." << hash<thread::id>{}(this_thread::get_id())
+		<< ".tmp";
+	string path = directory + "/" + key + ".spv";
+	{
+		ofstream file(tmpPath.str(), ios::binary | ios::trunc);
+		if (!file.is_open()) return;
+		file.write(reinterpret_cast<const char*>(code.data()), code.size() * sizeof(uint32_t));
+		if (!file)
+		{
+			file.close();
+			remove(tmpPath.str().c_str());
+			return;
+		}
+	}
+	if (rename(tmpPath.str().c_str(), path.c_str()) != 0) remove(tmpPath.str().c_str());
+}
+
+}
@@ -0,0 +1,92 @@
+#include <bp/StagingRing.h>
+#include <stdexcept>
+
+using namespace std;
+
+namespace bp
+{
+
+void StagingRing::init(Device& device, VkDeviceSize size)
+{
+	if (isReady()) throw runtime_error("Staging ring already initialized.");
+	if (size == 0) throw invalid_argument("Staging ring size must be greater than zero.");
+
+	/*
+	 * Uploads may be recorded on the destination queue, so all queues read the ring.
+	 */
+	vector<uint32_t> queueFamilies;
+	for (uint32_t i = 0; i < device.getQueueCount(); i++)
+		queueFamilies.push_back(device.getQueue(i).getQueueFamilyIndex());
+	buffer.setConcurrentSharing(queueFamilies);
+	buffer.init(device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	StagingRing::size = size;
+}
+
+bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, Region& region)
+{
+	assertReady();
+	if (size == 0 || size > StagingRing::size) return false;
+
+	lock_guard<mutex> lock(allocationMutex);
+	reclaim();
+
+	VkDeviceSize offset = (head + alignment - 1) / alignment * alignment;
+	if (head >= tail)
+	{
+		/*
+		 * The free space is [head, size) followed by [0, tail). The allocation must not make
+		 * head catch up with tail, as that would make the ring look empty.
+		 */
+		if (offset + size > StagingRing::size)
+		{
+			if (spans.empty() || size < tail) offset = 0;
+			else return false;
+		}
+	} else if (offset + size >= tail)
+	{
+		return false;
+	}
+
+	head = offset + size;
+	spans.push_back({head, false, nullptr});
+
+	region.id = frontId + spans.size() - 1;
+	region.offset = offset;
+	region.mapped = buffer.map() + offset;
+	return true;
+}
+
+void StagingRing::release(const vector<uint64_t>& ids, const shared_ptr<Fence>& fence)
+{
+	assertReady();
+	lock_guard<mutex> lock(allocationMutex);
+	for (uint64_t id : ids)
+	{
+		Span& span = spans[id - frontId];
+		span.released = true;
+		span.fence = fence;
+	}
+	reclaim();
+}
+
+void StagingRing::reclaim()
+{
+	while (!spans.empty())
+	{
+		Span& span = spans.front();
+		if (!span.released || (span.fence != nullptr && !span.fence->isSignaled())) break;
+		tail = span.end;
+		spans.pop_front();
+		frontId++;
+	}
+
+	if (spans.empty()) head = tail = 0;
+}
+
+void StagingRing::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Staging ring not ready. Must initialize before use.");
+}
+
+}
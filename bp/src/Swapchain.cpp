@@ -8,7 +8,7 @@ namespace bp
 {
 
 void Swapchain::init(Device& device, VkSurfaceKHR surface, uint32_t width, uint32_t height,
-		     bool vsync)
+		     bool vsync, uint32_t imageCount)
 {
 	Attachment::device = &device;
 	Attachment::width = width;
@@ -16,9 +16,10 @@ void Swapchain::init(Device& device, VkSurfaceKHR surface, uint32_t width, uint3
 	Swapchain::surface = surface;
 	Swapchain::vsync = vsync;
 	format = VK_FORMAT_B8G8R8_UNORM;
-	framebufferImageCount = 2;
+	requestedImageCount = imageCount;
 
 	imageAvailableSemaphore.init(device);
+	acquireSemaphore = imageAvailableSemaphore;
 
 	create();
 }
@@ -49,7 +50,7 @@ void Swapchain::present(VkSemaphore waitSemaphore)
 	presentInfo.pSwapchains = &handle;
 	presentInfo.pImageIndices = &currentFramebufferIndex;
 	presentInfo.pResults = nullptr;
-	vkQueuePresentKHR(device->getGraphicsQueue(), &presentInfo);
+	device->getGraphicsQueue().present(presentInfo);
 	presentQueuedEvent();
 }
 
@@ -97,12 +98,6 @@ void Swapchain::create()
 	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(*device, surface,
 						  &surfaceCapabilities);
 
-	if (framebufferImageCount < surfaceCapabilities.minImageCount)
-		framebufferImageCount = surfaceCapabilities.minImageCount;
-	else if (surfaceCapabilities.maxImageCount != 0 &&
-		 framebufferImageCount > surfaceCapabilities.maxImageCount)
-		framebufferImageCount = surfaceCapabilities.maxImageCount;
-
 	VkExtent2D surfaceExtent = surfaceCapabilities.currentExtent;
 	if (surfaceExtent.width == 0xFFFFFFFF || surfaceExtent.width == 0)
 	{
@@ -125,7 +120,7 @@ void Swapchain::create()
 	vkGetPhysicalDeviceSurfacePresentModesKHR(*device, surface, &n,
 						  present_modes.data());
 
-	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	presentMode = VK_PRESENT_MODE_FIFO_KHR;
 	if (!vsync)
 	{
 		for (uint32_t i = 0; i < n; i++)
@@ -143,12 +138,24 @@ void Swapchain::create()
 		}
 	}
 
+	/*
+	 * Mailbox keeps one image queued for presentation in addition to the one being displayed,
+	 * so it needs a third image for rendering not to block on acquisition.
+	 */
+	uint32_t imageCount = requestedImageCount;
+	if (presentMode == VK_PRESENT_MODE_MAILBOX_KHR && imageCount < 3) imageCount = 3;
+	if (imageCount < surfaceCapabilities.minImageCount)
+		imageCount = surfaceCapabilities.minImageCount;
+	else if (surfaceCapabilities.maxImageCount != 0 &&
+		 imageCount > surfaceCapabilities.maxImageCount)
+		imageCount = surfaceCapabilities.maxImageCount;
+
 	VkSwapchainKHR oldSwapchain = handle;
 
 	VkSwapchainCreateInfoKHR createInfo = {};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	createInfo.surface = surface;
-	createInfo.minImageCount = framebufferImageCount;
+	createInfo.minImageCount = imageCount;
 	createInfo.imageFormat = format;
 	createInfo.imageColorSpace = colorSpace;
 	createInfo.imageExtent = surfaceExtent;
@@ -167,6 +174,7 @@ void Swapchain::create()
 
 	if (oldSwapchain != VK_NULL_HANDLE)
 	{
+		vkDeviceWaitIdle(*device);
 		for (VkImageView imageView : framebufferImageViews)
 			vkDestroyImageView(*device, imageView, nullptr);
 		vkDestroySwapchainKHR(*device, oldSwapchain, nullptr);
@@ -175,6 +183,7 @@ void Swapchain::create()
 	vkGetSwapchainImagesKHR(*device, handle, &n, nullptr);
 	framebufferImages.resize(n);
 	vkGetSwapchainImagesKHR(*device, handle, &n, framebufferImages.data());
+	framebufferImageCount = n;
 
 	transitionStatus = vector<bool>(n, false);
 
@@ -219,12 +228,12 @@ void Swapchain::destroy()
 void Swapchain::nextImage()
 {
 	VkResult result = vkAcquireNextImageKHR(*device, handle, UINT64_MAX,
-						imageAvailableSemaphore, VK_NULL_HANDLE,
+						acquireSemaphore, VK_NULL_HANDLE,
 						&currentFramebufferIndex);
 	if (result == VK_ERROR_OUT_OF_DATE_KHR)
 	{
 		create();
-		vkAcquireNextImageKHR(*device, handle, UINT64_MAX, imageAvailableSemaphore,
+		vkAcquireNextImageKHR(*device, handle, UINT64_MAX, acquireSemaphore,
 				      VK_NULL_HANDLE, &currentFramebufferIndex);
 		resizeEvent(width, height);
 	}
@@ -254,7 +263,7 @@ void Swapchain::transitionColor(VkCommandBuffer cmdBuffer)
 	VkImageSubresourceRange resourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
 	barrier.subresourceRange = resourceRange;
 
-	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+	vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
 			     VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 0, nullptr, 0,
 			     nullptr, 1, &barrier);
 }
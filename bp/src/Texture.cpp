@@ -1,5 +1,6 @@
 #include <bp/Texture.h>
 #include <bp/Util.h>
+#include <stdexcept>
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
@@ -19,13 +20,20 @@ Texture::~Texture()
 }
 
 void Texture::init(Device& device, VkFormat format, VkImageUsageFlags usage, uint32_t width,
-			   uint32_t height)
+			   uint32_t height, uint32_t mipLevels, MemoryPool memoryPool)
 {
+	if (isReady()) throw runtime_error("Texture already initialized.");
 	Attachment::device = &device;
 	Attachment::format = format;
 	Attachment::width = width;
 	Attachment::height = height;
 	imageUsage = usage;
+	Texture::mipLevels = mipLevels;
+	Texture::memoryPool = memoryPool;
+	if (memoryPool == MemoryPool::DEFAULT
+	    && usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+			| VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+		Texture::memoryPool = MemoryPool::ATTACHMENT;
 
 	if (usage & VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT)
 	{
@@ -61,28 +69,74 @@ void Texture::init(Device& device, VkFormat format, VkImageUsageFlags usage, uin
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = static_cast<float>(mipLevels);
 
 	VkResult result = vkCreateSampler(device, &samplerInfo, nullptr, &sampler);
 	if (result != VK_SUCCESS)
 		throw runtime_error("Failed to create sampler.");
 
 	descriptor.setType(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	descriptor.resetDescriptorInfos();
 	descriptor.addDescriptorInfo({sampler, imageView,
 				      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
 }
 
 void Texture::load(Device& device, VkImageUsageFlags usage, const string& path)
 {
+	UploadContext& uploadContext = device.getUploadContext();
+	load(uploadContext, usage, path);
+	uploadContext.submit().wait();
+}
+
+void Texture::load(UploadContext& uploadContext, VkImageUsageFlags usage, const string& path)
+{
+	if (CompressedImage::isCompressedImagePath(path))
+	{
+		load(uploadContext, usage, CompressedImage{path});
+		return;
+	}
+
 	int x, y, n;
 	unsigned char* raw = stbi_load(path.c_str(), &x, &y, &n, 4);
+	if (raw == nullptr)
+		throw runtime_error("Failed to load texture \"" + path + "\".");
 
-	init(device, VK_FORMAT_R8G8B8A8_UNORM, usage,
-	     static_cast<uint32_t>(x), static_cast<uint32_t>(y));
-	parallelCopy(image->map(), raw, static_cast<size_t>(x * y * 4));
-	image->flushStagingBuffer();
-
+	/*
+	 * Sampled textures get a full mip chain. The first level is uploaded, and the rest are
+	 * generated from it on the queue the texture will be used on.
+	 */
+	uint32_t width = static_cast<uint32_t>(x);
+	uint32_t height = static_cast<uint32_t>(y);
+	bool sampled = (usage & VK_IMAGE_USAGE_SAMPLED_BIT) != 0;
+	init(uploadContext.getDevice(), VK_FORMAT_R8G8B8A8_UNORM, usage, width, height,
+	     sampled ? calculateMipLevels(width, height) : 1);
+	uploadContext.upload(*image, raw, static_cast<VkDeviceSize>(x * y * 4),
+			     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 	stbi_image_free(raw);
+
+	if (!sampled) return;
+	uploadContext.recordOnDstQueue([this](VkCommandBuffer cmdBuffer) {
+		image->generateMipmaps(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+				       VK_ACCESS_SHADER_READ_BIT,
+				       VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, cmdBuffer);
+	});
+}
+
+/*
+ * Compressed images are uploaded as is, with the mip levels stored in the file. Missing levels
+ * are not generated, as blitting is not supported for block compressed formats.
+ */
+void Texture::load(UploadContext& uploadContext, VkImageUsageFlags usage,
+		   const CompressedImage& compressedImage)
+{
+	init(uploadContext.getDevice(), compressedImage.getFormat(), usage,
+	     compressedImage.getWidth(), compressedImage.getHeight(),
+	     compressedImage.getMipLevels());
+	uploadContext.upload(*image, compressedImage.getData(), compressedImage.getSize(),
+			     compressedImage.getCopyRegions(),
+			     (usage & VK_IMAGE_USAGE_SAMPLED_BIT)
+			     ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+			     : VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
 }
 
 void Texture::resize(uint32_t width, uint32_t height)
@@ -103,12 +157,61 @@ void Texture::resize(uint32_t width, uint32_t height)
 	}
 }
 
+/*
+ * Let the descriptor of this texture refer to the placeholder instead, e.g. while the image of
+ * this texture is being loaded. Descriptor sets must be updated for the change to take effect.
+ */
+void Texture::usePlaceholder(Texture& placeholder)
+{
+	descriptor.setType(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	descriptor.resetDescriptorInfos();
+	descriptor.addDescriptorInfo({placeholder.sampler, placeholder.imageView,
+				      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+}
+
+/*
+ * Restrict sampling to the mip levels from baseMipLevel and down, by recreating the image view.
+ * The old view is retired to the device, as frames in flight may still sample it.
+ */
+void Texture::setBaseMipLevel(uint32_t baseMipLevel)
+{
+	if (baseMipLevel >= mipLevels) throw out_of_range("Invalid base mip level.");
+	Texture::baseMipLevel = baseMipLevel;
+	VkDevice logical = *device;
+	VkImageView oldView = imageView;
+	device->getRetireQueue().retire([logical, oldView] {
+		vkDestroyImageView(logical, oldView, nullptr);
+	});
+	createImageView();
+
+	descriptor.resetDescriptorInfos();
+	descriptor.addDescriptorInfo({sampler, imageView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+}
+
+void Texture::setMemory(const shared_ptr<Allocation>& memory, VkDeviceSize offset)
+{
+	Texture::memory = memory;
+	memoryOffset = offset;
+}
+
+void Texture::enableRelocation()
+{
+	relocatable = true;
+	if (image != nullptr) enableImageRelocation();
+}
+
 void Texture::transitionShaderReadable(VkCommandBuffer cmdBuffer, VkPipelineStageFlags stage)
 {
 	image->transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
 			  stage, cmdBuffer);
 }
 
+void Texture::transitionShaderReadable(BarrierBatch& batch, VkPipelineStageFlags stage)
+{
+	image->transition(VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_SHADER_READ_BIT,
+			  stage, batch);
+}
+
 void Texture::before(VkCommandBuffer cmdBuffer)
 {
 	image->transition(renderLayout, renderAccessFlags, renderPipelineStage, cmdBuffer);
@@ -116,16 +219,31 @@ void Texture::before(VkCommandBuffer cmdBuffer)
 
 void Texture::create()
 {
-	image = new Image(*device, width, height, format, VK_IMAGE_TILING_OPTIMAL, imageUsage,
-			  VMA_MEMORY_USAGE_GPU_ONLY);
+	if (memory)
+	{
+		unique_ptr<Image> aliased{new Image()};
+		aliased->init(*device, width, height, format, VK_IMAGE_TILING_OPTIMAL, imageUsage,
+			      memory, memoryOffset, VK_IMAGE_LAYOUT_UNDEFINED, mipLevels);
+		image = aliased.release();
+	} else
+	{
+		image = new Image(*device, width, height, format, VK_IMAGE_TILING_OPTIMAL,
+				  imageUsage, VMA_MEMORY_USAGE_GPU_ONLY, VK_IMAGE_LAYOUT_UNDEFINED,
+				  mipLevels, memoryPool);
+	}
+	createImageView();
+	if (relocatable) enableImageRelocation();
+}
 
+void Texture::createImageView()
+{
 	VkImageViewCreateInfo imageViewInfo = {};
 	imageViewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	imageViewInfo.image = *image;
 	imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
 	imageViewInfo.format = format;
 
-	if (format == VK_FORMAT_D16_UNORM)
+	if (isDepthFormat(format))
 	{
 		imageViewInfo.components = {
 			VK_COMPONENT_SWIZZLE_IDENTITY,
@@ -142,11 +260,15 @@ void Texture::create()
 			VK_COMPONENT_SWIZZLE_A
 		};
 	}
-	imageViewInfo.subresourceRange.aspectMask = format != VK_FORMAT_D16_UNORM
-						    ? VK_IMAGE_ASPECT_COLOR_BIT
-						    : VK_IMAGE_ASPECT_DEPTH_BIT;
-	imageViewInfo.subresourceRange.baseMipLevel = 0;
-	imageViewInfo.subresourceRange.levelCount = 1;
+	/*
+	 * Depth stencil attachments need views of both aspects, while sampled views can only have
+	 * one.
+	 */
+	imageViewInfo.subresourceRange.aspectMask = getAspectFlags(format);
+	if (isDepthFormat(format) && !(imageUsage & VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT))
+		imageViewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+	imageViewInfo.subresourceRange.baseMipLevel = baseMipLevel;
+	imageViewInfo.subresourceRange.levelCount = mipLevels - baseMipLevel;
 	imageViewInfo.subresourceRange.baseArrayLayer = 0;
 	imageViewInfo.subresourceRange.layerCount = 1;
 
@@ -155,6 +277,36 @@ void Texture::create()
 		throw runtime_error("Failed to create image view.");
 }
 
+void Texture::enableImageRelocation()
+{
+	if (memory) return;
+	image->enableRelocation();
+	bpUtil::connect(image->relocateEvent, *this, &Texture::relocate);
+}
+
+/*
+ * The descriptor is only pointed to the new view if it referred to the old one, and not to a
+ * placeholder.
+ */
+void Texture::relocate()
+{
+	VkDevice logical = *device;
+	VkImageView oldView = imageView;
+	device->getRetireQueue().retire([logical, oldView] {
+		vkDestroyImageView(logical, oldView, nullptr);
+	});
+	createImageView();
+
+	auto& infos = descriptor.getDescriptorInfos();
+	if (!infos.empty() && infos[0].imageView == oldView)
+	{
+		descriptor.resetDescriptorInfos();
+		descriptor.addDescriptorInfo({sampler, imageView,
+					      VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL});
+	}
+	relocateEvent();
+}
+
 void Texture::destroy()
 {
 	vkDestroyImageView(*device, imageView, nullptr);
@@ -0,0 +1,276 @@
+#include <bp/TextureStreamer.h>
+#include <bp/CompressedImage.h>
+#include <bp/Util.h>
+#include <stb_image.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+namespace bp
+{
+
+static const VkDeviceSize LEVEL_ALIGNMENT = 16;
+
+/*
+ * Downsample an RGBA8 image to half its size with a 2x2 box filter. Odd edges are clamped.
+ */
+static void downsample(const uint8_t* src, uint32_t srcWidth, uint32_t srcHeight, uint8_t* dst,
+		       uint32_t dstWidth, uint32_t dstHeight)
+{
+	for (uint32_t y = 0; y < dstHeight; y++)
+	{
+		uint32_t y0 = min(2 * y, srcHeight - 1);
+		uint32_t y1 = min(2 * y + 1, srcHeight - 1);
+		for (uint32_t x = 0; x < dstWidth; x++)
+		{
+			uint32_t x0 = min(2 * x, srcWidth - 1);
+			uint32_t x1 = min(2 * x + 1, srcWidth - 1);
+			for (uint32_t c = 0; c < 4; c++)
+			{
+				uint32_t sum = src[(y0 * srcWidth + x0) * 4 + c]
+					       + src[(y0 * srcWidth + x1) * 4 + c]
+					       + src[(y1 * srcWidth + x0) * 4 + c]
+					       + src[(y1 * srcWidth + x1) * 4 + c];
+				dst[(y * dstWidth + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+			}
+		}
+	}
+}
+
+TextureStreamer::~TextureStreamer()
+{
+	if (!isReady()) return;
+	for (size_t i = 0; i < workers.size(); i++)
+		decodeQueue.enqueue(nullptr);
+	for (auto& worker : workers)
+		worker.join();
+	uploadContext.waitIdle();
+}
+
+void TextureStreamer::init(Device& device, VkDeviceSize byteBudget, unsigned workerCount)
+{
+	if (isReady()) throw runtime_error("Texture streamer already initialized.");
+	if (workerCount == 0) throw invalid_argument("Texture streamer needs at least one worker.");
+
+	TextureStreamer::device = &device;
+	TextureStreamer::byteBudget = byteBudget;
+	uploadContext.init(device, device.getTransferQueue(), device.getGraphicsQueue());
+
+	static const uint8_t white[4] = {255, 255, 255, 255};
+	placeholder.init(device, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, 1, 1);
+	uploadContext.upload(placeholder.getImage(), white, sizeof(white));
+	uploadContext.submit().wait();
+
+	for (unsigned i = 0; i < workerCount; i++)
+	{
+		workers.emplace_back([this] {
+			for (;;)
+			{
+				Request* request = decodeQueue.dequeue();
+				if (request == nullptr) return;
+				decode(*request);
+			}
+		});
+	}
+}
+
+void TextureStreamer::stream(Texture& texture, const string& path,
+			     const function<void()>& residencyChanged)
+{
+	assertReady();
+	texture.usePlaceholder(placeholder);
+
+	unique_ptr<Request> request{new Request};
+	request->texture = &texture;
+	request->path = path;
+	request->residencyChanged = residencyChanged;
+	request->decoded = false;
+	request->initialized = false;
+	request->format = VK_FORMAT_UNDEFINED;
+	request->uploadedLevel = 0;
+
+	decodeQueue.enqueue(request.get());
+	requests.push_back(move(request));
+}
+
+void TextureStreamer::update()
+{
+	assertReady();
+
+	VkDeviceSize budget = byteBudget;
+	vector<Request*> recorded;
+	for (auto it = requests.begin(); it != requests.end();)
+	{
+		Request& request = **it;
+		{
+			lock_guard<mutex> lock(decodeMutex);
+			if (!request.decoded)
+			{
+				++it;
+				continue;
+			}
+		}
+
+		if (!request.error.empty())
+		{
+			errorEvent(request.error);
+			it = requests.erase(it);
+			continue;
+		}
+
+		if (updateResidency(request))
+		{
+			it = requests.erase(it);
+			continue;
+		}
+
+		if (uploadLevels(request, budget)) recorded.push_back(&request);
+		++it;
+	}
+
+	if (recorded.empty()) return;
+	UploadHandle handle = uploadContext.submit();
+	for (Request* request : recorded)
+		request->uploads.emplace_back(request->uploadedLevel, handle);
+}
+
+void TextureStreamer::decode(Request& request)
+{
+	try
+	{
+		if (CompressedImage::isCompressedImagePath(request.path))
+		{
+			CompressedImage image(request.path);
+			request.format = image.getFormat();
+			for (uint32_t i = 0; i < image.getMipLevels(); i++)
+			{
+				const CompressedImage::Level& level = image.getLevel(i);
+				request.levels.push_back({level.offset, level.size, level.width,
+							  level.height});
+			}
+			request.data.assign(image.getData(), image.getData() + image.getSize());
+		} else
+		{
+			int width, height, channels;
+			stbi_uc* pixels = stbi_load(request.path.c_str(), &width, &height, &channels,
+						    STBI_rgb_alpha);
+			if (pixels == nullptr)
+				throw runtime_error("Failed to load texture \"" + request.path + "\".");
+
+			/*
+			 * The full mip chain is built here, so that the smallest levels can be uploaded
+			 * first without waiting for the largest.
+			 */
+			request.format = VK_FORMAT_R8G8B8A8_UNORM;
+			uint32_t levelCount = calculateMipLevels(static_cast<uint32_t>(width),
+								 static_cast<uint32_t>(height));
+			VkDeviceSize offset = 0;
+			for (uint32_t i = 0; i < levelCount; i++)
+			{
+				Level level;
+				level.width = max(static_cast<uint32_t>(width) >> i, 1u);
+				level.height = max(static_cast<uint32_t>(height) >> i, 1u);
+				level.size = VkDeviceSize{level.width} * level.height * 4;
+				level.offset = offset;
+				offset = (offset + level.size + LEVEL_ALIGNMENT - 1) / LEVEL_ALIGNMENT
+					 * LEVEL_ALIGNMENT;
+				request.levels.push_back(level);
+			}
+
+			request.data.assign(offset, 0);
+			memcpy(request.data.data(), pixels, request.levels[0].size);
+			stbi_image_free(pixels);
+			for (uint32_t i = 1; i < levelCount; i++)
+			{
+				const Level& src = request.levels[i - 1];
+				const Level& dst = request.levels[i];
+				downsample(request.data.data() + src.offset, src.width, src.height,
+					   request.data.data() + dst.offset, dst.width, dst.height);
+			}
+		}
+		request.uploadedLevel = static_cast<uint32_t>(request.levels.size());
+	} catch (exception& e)
+	{
+		request.error = e.what();
+	}
+
+	lock_guard<mutex> lock(decodeMutex);
+	request.decoded = true;
+}
+
+bool TextureStreamer::uploadLevels(Request& request, VkDeviceSize& budget)
+{
+	uint32_t levelCount = static_cast<uint32_t>(request.levels.size());
+	if (!request.initialized)
+	{
+		request.texture->init(*device, request.format, VK_IMAGE_USAGE_SAMPLED_BIT,
+				      request.levels[0].width, request.levels[0].height, levelCount,
+				      MemoryPool::STREAMING);
+		request.texture->usePlaceholder(placeholder);
+		request.initialized = true;
+	}
+	if (request.uploadedLevel == 0) return false;
+
+	/*
+	 * Take levels from the smallest not yet uploaded towards the largest. The first level of
+	 * an update is taken even when it exceeds the budget, so that large levels are not starved.
+	 */
+	uint32_t end = request.uploadedLevel;
+	uint32_t base = end;
+	VkDeviceSize size = 0;
+	while (base > 0)
+	{
+		VkDeviceSize levelSize = request.levels[base - 1].size;
+		if (size + levelSize > budget && (size > 0 || budget != byteBudget)) break;
+		size += levelSize;
+		base--;
+	}
+	if (base == end) return false;
+
+	vector<VkBufferImageCopy> regions;
+	VkDeviceSize start = request.levels[base].offset;
+	for (uint32_t i = base; i < end; i++)
+	{
+		VkBufferImageCopy region = {};
+		region.bufferOffset = request.levels[i].offset - start;
+		region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1};
+		region.imageExtent = {request.levels[i].width, request.levels[i].height, 1};
+		regions.push_back(region);
+	}
+	const Level& last = request.levels[end - 1];
+	uploadContext.uploadMipLevels(request.texture->getImage(), request.data.data() + start,
+				      last.offset + last.size - start, regions, base, end - base);
+
+	budget -= min(size, budget);
+	request.uploadedLevel = base;
+	return true;
+}
+
+bool TextureStreamer::updateResidency(Request& request)
+{
+	uint32_t residentLevel = 0;
+	bool changed = false;
+	while (!request.uploads.empty() && request.uploads.front().second.isComplete())
+	{
+		residentLevel = request.uploads.front().first;
+		request.uploads.erase(request.uploads.begin());
+		changed = true;
+	}
+
+	if (changed)
+	{
+		request.texture->setBaseMipLevel(residentLevel);
+		if (request.residencyChanged) request.residencyChanged();
+	}
+	return changed && residentLevel == 0 && request.uploadedLevel == 0;
+}
+
+void TextureStreamer::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Texture streamer not ready. Must initialize before use.");
+}
+
+}
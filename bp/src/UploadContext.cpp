@@ -0,0 +1,398 @@
+#include <bp/UploadContext.h>
+#include <bp/Util.h>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
+
+namespace bp
+{
+
+static const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+bool UploadHandle::isComplete() const
+{
+	return fence == nullptr || fence->isSignaled();
+}
+
+void UploadHandle::wait() const
+{
+	if (fence != nullptr) fence->wait();
+}
+
+UploadContext::~UploadContext()
+{
+	if (!isReady()) return;
+	if (current.cmdBuffer != VK_NULL_HANDLE)
+	{
+		vkEndCommandBuffer(current.cmdBuffer);
+		cmdPool.freeCommandBuffer(current.cmdBuffer);
+		device->getStagingRing().release(current.stagingRegions, nullptr);
+	}
+	if (current.acquireCmdBuffer != VK_NULL_HANDLE)
+	{
+		vkEndCommandBuffer(current.acquireCmdBuffer);
+		acquireCmdPool.freeCommandBuffer(current.acquireCmdBuffer);
+	}
+	waitIdle();
+}
+
+void UploadContext::init(Device& device, Queue& queue)
+{
+	init(device, queue, queue);
+}
+
+void UploadContext::init(Device& device, Queue& queue, Queue& dstQueue)
+{
+	if (isReady()) throw runtime_error("Upload context already initialized.");
+	cmdPool.init(queue, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+			    VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	if (queue.getQueueFamilyIndex() != dstQueue.getQueueFamilyIndex())
+	{
+		acquireCmdPool.init(dstQueue, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT |
+					      VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	}
+	UploadContext::device = &device;
+	UploadContext::queue = &queue;
+	UploadContext::dstQueue = &dstQueue;
+}
+
+void UploadContext::upload(Buffer& dst, VkDeviceSize offset, VkDeviceSize size,
+			   const void* data)
+{
+	assertReady();
+	if (size == VK_WHOLE_SIZE) size = dst.getSize() - offset;
+	if (size == 0) return;
+
+	if (dst.isMapped())
+	{
+		parallelCopy(dst.map() + offset, data, size);
+		return;
+	}
+
+	lock_guard<mutex> lock(recordMutex);
+	VkDeviceSize stagingOffset;
+	Buffer* staging = stage(data, size, stagingOffset);
+	VkCommandBuffer cmdBuffer = begin();
+	if (!needsOwnershipTransfer() || dst.isConcurrent())
+	{
+		dst.transfer(*staging, stagingOffset, offset, size, cmdBuffer);
+		return;
+	}
+
+	/*
+	 * Transferring a buffer the destination family owns back would need a release recorded on
+	 * the destination queue, while it may be using the buffer, so the copy is done there.
+	 */
+	bool released = find(current.releasedBuffers.begin(), current.releasedBuffers.end(),
+			     &dst) != current.releasedBuffers.end();
+	if (!released && dst.getOwnerQueueFamily() == dstQueue->getQueueFamilyIndex())
+	{
+		cmdBuffer = beginAcquire();
+		dst.transfer(*staging, stagingOffset, offset, size, cmdBuffer);
+
+		VkBufferMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = dst;
+		barrier.offset = offset;
+		barrier.size = size;
+		vkCmdPipelineBarrier(cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				     VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0,
+				     nullptr);
+		return;
+	}
+
+	dst.transfer(*staging, stagingOffset, offset, size, cmdBuffer);
+	transferBufferOwnership(dst);
+}
+
+void UploadContext::upload(Image& dst, const void* data, VkDeviceSize size,
+			   VkImageLayout dstLayout)
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	VkDeviceSize stagingOffset;
+	Buffer* staging = stage(data, size, stagingOffset);
+
+	VkCommandBuffer cmdBuffer = begin();
+	dst.transfer(*staging, stagingOffset, cmdBuffer);
+	finishImageUpload(dst, dstLayout, cmdBuffer);
+}
+
+void UploadContext::upload(Image& dst, const void* data, VkDeviceSize size,
+			   const vector<VkBufferImageCopy>& regions, VkImageLayout dstLayout)
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	VkDeviceSize stagingOffset;
+	Buffer* staging = stage(data, size, stagingOffset);
+
+	VkCommandBuffer cmdBuffer = begin();
+	dst.transfer(*staging, stagingOffset, regions, cmdBuffer);
+	finishImageUpload(dst, dstLayout, cmdBuffer);
+}
+
+void UploadContext::uploadMipLevels(Image& dst, const void* data, VkDeviceSize size,
+				    const vector<VkBufferImageCopy>& regions,
+				    uint32_t baseMipLevel, uint32_t levelCount,
+				    VkImageLayout dstLayout)
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	VkDeviceSize stagingOffset;
+	Buffer* staging = stage(data, size, stagingOffset);
+
+	VkCommandBuffer cmdBuffer = begin();
+	dst.transitionMipLevels(baseMipLevel, levelCount, VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0,
+				VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, cmdBuffer);
+
+	vector<VkBufferImageCopy> offsetRegions = regions;
+	for (auto& region : offsetRegions)
+		region.bufferOffset += stagingOffset;
+	vkCmdCopyBufferToImage(cmdBuffer, *staging, dst, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			       static_cast<uint32_t>(offsetRegions.size()), offsetRegions.data());
+
+	if (!needsOwnershipTransfer())
+	{
+		dst.transitionMipLevels(baseMipLevel, levelCount,
+					VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, dstLayout,
+					VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT,
+					VK_PIPELINE_STAGE_TRANSFER_BIT,
+					VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, cmdBuffer);
+		return;
+	}
+
+	uint32_t srcFamily = queue->getQueueFamilyIndex();
+	uint32_t dstFamily = dstQueue->getQueueFamilyIndex();
+	dst.transitionMipLevels(baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				dstLayout, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				cmdBuffer, srcFamily, dstFamily);
+	dst.transitionMipLevels(baseMipLevel, levelCount, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				dstLayout, 0, VK_ACCESS_MEMORY_READ_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, beginAcquire(), srcFamily,
+				dstFamily);
+}
+
+void UploadContext::record(const function<void(VkCommandBuffer)>& commands)
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	commands(begin());
+}
+
+void UploadContext::recordOnDstQueue(const function<void(VkCommandBuffer)>& commands)
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	VkCommandBuffer cmdBuffer = begin();
+	if (needsOwnershipTransfer()) cmdBuffer = beginAcquire();
+	commands(cmdBuffer);
+}
+
+void UploadContext::transferOwnership(Buffer& buffer)
+{
+	assertReady();
+	if (!needsOwnershipTransfer()) return;
+	lock_guard<mutex> lock(recordMutex);
+	transferBufferOwnership(buffer);
+}
+
+void UploadContext::transferOwnership(Image& image, VkImageLayout dstLayout)
+{
+	assertReady();
+	if (!needsOwnershipTransfer()) return;
+	lock_guard<mutex> lock(recordMutex);
+	transferImageOwnership(image, dstLayout);
+}
+
+UploadHandle UploadContext::submit()
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	collect();
+	if (current.cmdBuffer == VK_NULL_HANDLE) return {};
+
+	return UploadHandle{submitCurrent()};
+}
+
+void UploadContext::waitIdle()
+{
+	assertReady();
+	lock_guard<mutex> lock(recordMutex);
+	for (Batch& batch : pending)
+		batch.fence->wait();
+	collect();
+}
+
+VkCommandBuffer UploadContext::begin()
+{
+	if (current.cmdBuffer == VK_NULL_HANDLE)
+		current.cmdBuffer = beginCmdBuffer(cmdPool, freeCmdBuffers);
+	return current.cmdBuffer;
+}
+
+VkCommandBuffer UploadContext::beginAcquire()
+{
+	if (current.acquireCmdBuffer == VK_NULL_HANDLE)
+		current.acquireCmdBuffer = beginCmdBuffer(acquireCmdPool, freeAcquireCmdBuffers);
+	return current.acquireCmdBuffer;
+}
+
+VkCommandBuffer UploadContext::beginCmdBuffer(CommandPool& pool, vector<VkCommandBuffer>& freeList)
+{
+	VkCommandBuffer cmdBuffer;
+	if (freeList.empty())
+	{
+		cmdBuffer = pool.allocateCommandBuffer();
+	} else
+	{
+		cmdBuffer = freeList.back();
+		freeList.pop_back();
+	}
+
+	VkCommandBufferBeginInfo beginInfo = {};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(cmdBuffer, &beginInfo);
+	return cmdBuffer;
+}
+
+bool UploadContext::needsOwnershipTransfer() const
+{
+	return queue->getQueueFamilyIndex() != dstQueue->getQueueFamilyIndex();
+}
+
+/*
+ * The release is recorded when the batch is submitted, after all uploads to the buffer, while
+ * the acquire is recorded right away, before commands later recorded on the destination queue.
+ */
+void UploadContext::transferBufferOwnership(Buffer& buffer)
+{
+	if (buffer.isConcurrent()) return;
+	if (find(current.releasedBuffers.begin(), current.releasedBuffers.end(), &buffer)
+	    != current.releasedBuffers.end())
+		return;
+	begin();
+	current.releasedBuffers.push_back(&buffer);
+	buffer.acquireOwnership(queue->getQueueFamilyIndex(), dstQueue->getQueueFamilyIndex(),
+				VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				beginAcquire());
+}
+
+void UploadContext::transferImageOwnership(Image& image, VkImageLayout dstLayout)
+{
+	uint32_t src = queue->getQueueFamilyIndex();
+	uint32_t dst = dstQueue->getQueueFamilyIndex();
+	image.releaseOwnership(src, dst, dstLayout, begin());
+	image.acquireOwnership(src, dst, dstLayout, VK_ACCESS_MEMORY_READ_BIT,
+			       VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, beginAcquire());
+}
+
+/*
+ * Copies data to staging memory and returns the buffer and offset it was copied to. The ring
+ * is used when possible. If it is full, the batch recorded so far is submitted and the oldest
+ * batches are waited for until enough space has been reclaimed.
+ */
+Buffer* UploadContext::stage(const void* data, VkDeviceSize size, VkDeviceSize& offset)
+{
+	StagingRing& ring = device->getStagingRing();
+	StagingRing::Region region;
+	bool allocated = size <= ring.getSize();
+	while (allocated && !ring.allocate(size, STAGING_ALIGNMENT, region))
+	{
+		if (current.cmdBuffer != VK_NULL_HANDLE) submitCurrent();
+		if (pending.empty())
+		{
+			allocated = false;
+			break;
+		}
+		pending.front().fence->wait();
+		collect();
+	}
+
+	if (allocated)
+	{
+		parallelCopy(region.mapped, data, size);
+		current.stagingRegions.push_back(region.id);
+		offset = region.offset;
+		return &ring.getBuffer();
+	}
+
+	Buffer* staging = new Buffer();
+	current.stagingBuffers.emplace_back(staging);
+	if (needsOwnershipTransfer())
+		staging->setConcurrentSharing({queue->getQueueFamilyIndex(),
+					       dstQueue->getQueueFamilyIndex()});
+	staging->init(*device, size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+	parallelCopy(staging->map(), data, size);
+	offset = 0;
+	return staging;
+}
+
+shared_ptr<Fence> UploadContext::submitCurrent()
+{
+	for (Buffer* buffer : current.releasedBuffers)
+	{
+		buffer->releaseOwnership(queue->getQueueFamilyIndex(),
+					 dstQueue->getQueueFamilyIndex(),
+					 VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+					 current.cmdBuffer);
+	}
+	vkEndCommandBuffer(current.cmdBuffer);
+	current.fence = make_shared<Fence>(*device);
+	if (current.acquireCmdBuffer == VK_NULL_HANDLE)
+	{
+		queue->submit({}, {current.cmdBuffer}, {}, *current.fence);
+	} else
+	{
+		vkEndCommandBuffer(current.acquireCmdBuffer);
+		current.semaphore.reset(new Semaphore(*device));
+		VkSemaphore semaphore = current.semaphore->getHandle();
+		queue->submit({}, {current.cmdBuffer}, {semaphore});
+		dstQueue->submit({{semaphore, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT}},
+				 {current.acquireCmdBuffer}, {}, *current.fence);
+	}
+	device->getStagingRing().release(current.stagingRegions, current.fence);
+
+	shared_ptr<Fence> fence = current.fence;
+	pending.push_back(move(current));
+	current = Batch{};
+	return fence;
+}
+
+void UploadContext::collect()
+{
+	auto completed = [this](Batch& batch) {
+		if (!batch.fence->isSignaled()) return false;
+		freeCmdBuffers.push_back(batch.cmdBuffer);
+		if (batch.acquireCmdBuffer != VK_NULL_HANDLE)
+			freeAcquireCmdBuffers.push_back(batch.acquireCmdBuffer);
+		return true;
+	};
+	pending.erase(remove_if(pending.begin(), pending.end(), completed), pending.end());
+}
+
+void UploadContext::finishImageUpload(Image& image, VkImageLayout dstLayout,
+				      VkCommandBuffer cmdBuffer)
+{
+	if (needsOwnershipTransfer())
+		transferImageOwnership(image, dstLayout);
+	else if (dstLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+		image.transition(dstLayout, 0, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, cmdBuffer);
+}
+
+void UploadContext::assertReady()
+{
+	if (!isReady())
+		throw runtime_error("Upload context not ready. Must initialize before use.");
+}
+
+}
@@ -6,6 +6,7 @@
 #include <thread>
 #include <cstring>
 #include <future>
+#include <algorithm>
 
 using namespace std;
 
@@ -143,6 +144,54 @@ void endSingleUseCmdBuffer(VkDevice device, VkQueue queue, VkCommandPool pool,
 	vkFreeCommandBuffers(device, pool, 1, &cmdBuffer);
 }
 
+bool isFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format, VkImageTiling tiling,
+		       VkFormatFeatureFlags features)
+{
+	if (format == VK_FORMAT_UNDEFINED) return false;
+	VkFormatProperties properties;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &properties);
+	VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_OPTIMAL
+					 ? properties.optimalTilingFeatures
+					 : properties.linearTilingFeatures;
+	return (supported & features) == features;
+}
+
+uint32_t calculateMipLevels(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = max(width, height); size > 1; size /= 2) levels++;
+	return levels;
+}
+
+bool isDepthFormat(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM:
+	case VK_FORMAT_X8_D24_UNORM_PACK32:
+	case VK_FORMAT_D32_SFLOAT:
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+VkImageAspectFlags getAspectFlags(VkFormat format)
+{
+	switch (format)
+	{
+	case VK_FORMAT_D16_UNORM_S8_UINT:
+	case VK_FORMAT_D24_UNORM_S8_UINT:
+	case VK_FORMAT_D32_SFLOAT_S8_UINT:
+		return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+	default:
+		return isDepthFormat(format) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
+	}
+}
+
 vector<char> readBinaryFile(const string& path)
 {
 	ifstream file(path, ios::ate | ios::binary);
@@ -219,5 +268,10 @@ void* parallelCopy(void* dest, const void* src, size_t count)
 
 	return dest;
 }
+shared_ptr<int> getThreadToken()
+{
+	static thread_local shared_ptr<int> token = make_shared<int>(0);
+	return token;
+}
 
 }
\ No newline at end of file
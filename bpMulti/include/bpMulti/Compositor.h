@@ -7,6 +7,7 @@
 #include <bp/PipelineLayout.h>
 #include <bp/GraphicsPipeline.h>
 #include <bp/DescriptorPool.h>
+#include <bp/BarrierBatch.h>
 #include <bpScene/DrawableSubpass.h>
 #include <vector>
 #include "Contribution.h"
@@ -38,6 +39,7 @@ protected:
 	bp::Queue* transferQueue;
 	bp::CommandPool transferCommandPool;
 	VkCommandBuffer transferCommandBuffer;
+	bp::BarrierBatch barrierBatch;
 	bool dedicatedTransferQueue;
 
 	unsigned deviceCount;
@@ -59,6 +61,7 @@ protected:
 	virtual VkExtent2D getContributionSize(unsigned deviceIndex) = 0;
 	virtual unsigned getCompositingElementCount() const = 0;
 	virtual bool shouldCopyDepth() const = 0;
+	VkDescriptorSetLayoutCreateFlags getDescriptorSetLayoutFlags();
 	void hostCopyStep();
 	void hostToDeviceStep();
 	virtual void initShaders() = 0;
@@ -23,7 +23,7 @@ public:
 	unsigned createTexture(VkFormat format, bool addToDescriptorSet);
 	unsigned addTexture(bp::Texture& texture, bool addToDescriptorSet);
 	void flushStagingBuffer(unsigned index, VkCommandBuffer cmdBuffer);
-	void transitionTextureShaderReadable(unsigned index, VkCommandBuffer cmdBuffer);
+	void transitionTextureShaderReadable(unsigned index, bp::BarrierBatch& batch);
 	void update() { descriptorSet.update(); }
 	void bind(VkCommandBuffer cmdBuffer);
 
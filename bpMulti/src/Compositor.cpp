@@ -34,21 +34,22 @@ void Compositor::render(bp::Framebuffer& fbo, VkCommandBuffer cmdBuffer)
 		hostToDeviceStep();
 	}
 
-	primaryContributions[currentFrameIndex].transitionTextureShaderReadable(0, cmdBuffer);
+	primaryContributions[currentFrameIndex].transitionTextureShaderReadable(0, barrierBatch);
 	if (shouldCopyDepth())
 	{
 		primaryContributions[currentFrameIndex]
-			.transitionTextureShaderReadable(1, cmdBuffer);
+			.transitionTextureShaderReadable(1, barrierBatch);
 	}
 
 	for (auto& c : secondaryContributions)
 	{
-		c.transitionTextureShaderReadable(0, cmdBuffer);
+		c.transitionTextureShaderReadable(0, barrierBatch);
 		if (shouldCopyDepth())
 		{
-			c.transitionTextureShaderReadable(1, cmdBuffer);
+			c.transitionTextureShaderReadable(1, barrierBatch);
 		}
 	}
+	barrierBatch.record(cmdBuffer);
 	Renderer::render(fbo, cmdBuffer);
 	for (auto& f : renderFutures) f.wait();
 	currentFrameIndex = nextFrameIndex;
@@ -103,6 +104,17 @@ void Compositor::hostCopyStep()
 	for (auto& f : futures) f.wait();
 }
 
+/*
+ * Contributions push their descriptors when the device supports it, so that no descriptor pool
+ * is needed.
+ */
+VkDescriptorSetLayoutCreateFlags Compositor::getDescriptorSetLayoutFlags()
+{
+	if (getDevice().getFunctions().cmdPushDescriptorSet != nullptr)
+		return VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+	return 0;
+}
+
 void Compositor::hostToDeviceStep()
 {
 	VkCommandBufferBeginInfo beginInfo = {};
@@ -137,8 +149,9 @@ void Compositor::initResources(uint32_t width, uint32_t height)
 	initDescriptorSetLayout();
 	initPipelineLayout();
 	initPipeline();
-	initDescriptorPool();
+	if (!descriptorSetLayout.isPushDescriptorsEnabled()) initDescriptorPool();
 
+	barrierBatch.init(getDevice());
 	transferQueue = &getDevice().getTransferQueue();
 	transferCommandPool.init(*transferQueue);
 	transferCommandBuffer = transferCommandPool.allocateCommandBuffer();
@@ -151,6 +164,7 @@ void Compositor::initResources(uint32_t width, uint32_t height)
 
 	//Setup resources for primary device
 	auto primarySize = getContributionSize(0);
+	primaryRenderer->setDepthUsedAfterPass(shouldCopyDepth());
 	primaryRenderDeviceSteps.init(getDevice(), *primaryRenderer, primarySize.width,
 				      primarySize.height, 2);
 	primaryContributions.resize(2);
@@ -177,6 +191,7 @@ void Compositor::initResources(uint32_t width, uint32_t height)
 	for (unsigned i = 0; i < deviceCount - 1; i++)
 	{
 		auto size = getContributionSize(i + 1);
+		secondaryRenderers[i]->setDepthUsedAfterPass(shouldCopyDepth());
 		secondaryRenderDeviceSteps[i].init(*secondaryDevices[i], *secondaryRenderers[i],
 						   size.width, size.height, 2);
 		secondaryContributions[i].init(getDevice(), descriptorPool, descriptorSetLayout,
@@ -13,7 +13,10 @@ void Contribution::init(Device& device, DescriptorPool& descriptorPool,
 	Contribution::width = width;
 	Contribution::height = height;
 	Contribution::pipelineLayout = &pipelineLayout;
-	descriptorSet.init(device, descriptorPool, descriptorSetLayout);
+	if (descriptorSetLayout.isPushDescriptorsEnabled())
+		descriptorSet.init(device, descriptorSetLayout, pipelineLayout);
+	else
+		descriptorSet.init(device, descriptorPool, descriptorSetLayout);
 	descriptorSet.update();
 }
 
@@ -29,7 +32,8 @@ unsigned Contribution::createTexture(VkFormat format, bool addToDescriptorSet)
 {
 	uint32_t idx = static_cast<uint32_t>(textures.size());
 	textures.emplace_back(
-		new Texture(*device, format, VK_IMAGE_USAGE_SAMPLED_BIT, width, height));
+		new Texture(*device, format, VK_IMAGE_USAGE_SAMPLED_BIT, width, height, 1,
+			    MemoryPool::ATTACHMENT));
 	if (addToDescriptorSet)
 	{
 		textures[idx]->setDescriptorBinding(idx);
@@ -55,17 +59,14 @@ void Contribution::flushStagingBuffer(unsigned index, VkCommandBuffer cmdBuffer)
 	getTexture(index).getImage().flushStagingBuffer(cmdBuffer);
 }
 
-void Contribution::transitionTextureShaderReadable(unsigned index, VkCommandBuffer cmdBuffer)
+void Contribution::transitionTextureShaderReadable(unsigned index, bp::BarrierBatch& batch)
 {
-	getTexture(index).transitionShaderReadable(cmdBuffer,
-						   VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+	getTexture(index).transitionShaderReadable(batch, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
 }
 
 void Contribution::bind(VkCommandBuffer cmdBuffer)
 {
-	VkDescriptorSet set = descriptorSet;
-	vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, *pipelineLayout,
-				0, 1, &set, 0, nullptr);
+	descriptorSet.bind(cmdBuffer, *pipelineLayout);
 }
 
 }
\ No newline at end of file
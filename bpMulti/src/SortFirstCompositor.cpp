@@ -126,7 +126,7 @@ void SortFirstCompositor::initDescriptorSetLayout()
 {
 	descriptorSetLayout.addLayoutBinding({0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					      1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});
-	descriptorSetLayout.init(getDevice());
+	descriptorSetLayout.init(getDevice(), getDescriptorSetLayoutFlags());
 }
 
 void SortFirstCompositor::initPipelineLayout()
@@ -55,7 +55,7 @@ void SortLastCompositor::initDescriptorSetLayout()
 					      1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});
 	descriptorSetLayout.addLayoutBinding({1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
 					      1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr});
-	descriptorSetLayout.init(getDevice());
+	descriptorSetLayout.init(getDevice(), getDescriptorSetLayoutFlags());
 }
 
 void SortLastCompositor::initPipelineLayout()
@@ -5,10 +5,12 @@
 #include <bp/Swapchain.h>
 #include <bp/CommandPool.h>
 #include <bp/Semaphore.h>
+#include <bp/Fence.h>
 #include <bpUtil/Event.h>
 #include <QWindow>
 #include <QVulkanInstance>
 #include <chrono>
+#include <memory>
 
 namespace bpQt
 {
@@ -29,7 +31,8 @@ public:
 		resized{false},
 		fpsFrameCount{0},
 		graphicsQueue{nullptr},
-		frameCmdBuffer{VK_NULL_HANDLE},
+		framesInFlight{2},
+		frameIndex{0},
 		frameCmdBufferBeginInfo{}
 	{
 		setSurfaceType(VulkanSurface);
@@ -40,9 +43,15 @@ public:
 		setVulkanInstance(&instance);
 	}
 
-	virtual ~Window() = default;
+	virtual ~Window();
 
 	void setVSync(bool enabled) { vsync = enabled; }
+	/*
+	 * Number of frames the CPU may record ahead of the GPU. Must be set before the window is
+	 * shown. Resources written by render() should be duplicated per frame in flight and
+	 * selected with getFrameIndex().
+	 */
+	void setFramesInFlight(unsigned count) { framesInFlight = count > 0 ? count : 1; }
 	void setContinuousRendering(bool enabled) { continuousAnimation = enabled; }
 
 	bpUtil::Event<float> framerateEvent;
@@ -57,7 +66,9 @@ protected:
 	virtual VkPhysicalDevice selectDevice(const std::vector<VkPhysicalDevice>& devices);
 	virtual void render(VkCommandBuffer cmdBuffer) = 0;
 	virtual void update(double frameDeltaTime) {}
-	VkCommandBuffer getFrameCommandBuffer() { return frameCmdBuffer; }
+	VkCommandBuffer getFrameCommandBuffer() { return frames[frameIndex].cmdBuffer; }
+	unsigned getFramesInFlight() const { return framesInFlight; }
+	unsigned getFrameIndex() const { return frameIndex; }
 
 private:
 	bool surfaceDestroyed, inited, continuousAnimation;
@@ -71,8 +82,18 @@ private:
 
 	bp::Queue* graphicsQueue;
 	bp::CommandPool cmdPool;
-	VkCommandBuffer frameCmdBuffer;
-	bp::Semaphore renderCompleteSem;
+
+	struct FrameContext
+	{
+		VkCommandBuffer cmdBuffer;
+		bp::Fence fence;
+		bp::Semaphore imageAvailableSem;
+		bp::Semaphore renderCompleteSem;
+	};
+
+	unsigned framesInFlight;
+	unsigned frameIndex;
+	std::unique_ptr<FrameContext[]> frames;
 
 	VkCommandBufferBeginInfo frameCmdBufferBeginInfo;
 
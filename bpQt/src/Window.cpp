@@ -9,6 +9,11 @@ using namespace bp;
 namespace bpQt
 {
 
+Window::~Window()
+{
+	if (inited) vkDeviceWaitIdle(device);
+}
+
 VkPhysicalDevice Window::selectDevice(const vector<VkPhysicalDevice>& devices)
 {
 	if (devices.empty()) return VK_NULL_HANDLE;
@@ -27,10 +32,19 @@ void Window::init()
 
 	VkPhysicalDevice physical = selectDevice(queryDevices(*vulkanInstance(), requirements));
 	if (physical == VK_NULL_HANDLE) throw runtime_error("No suitable device available.");
-	device.init(physical, requirements);
-
+	QVersionNumber version = vulkanInstance()->apiVersion();
+	uint32_t apiVersion = version.isNull()
+			      ? VK_MAKE_VERSION(1, 0, 0)
+			      : VK_MAKE_VERSION(version.majorVersion(), version.minorVersion(),
+						version.microVersion());
+	device.init(physical, requirements, vulkanInstance()->vkInstance(), apiVersion);
+
+	/*
+	 * One image is being displayed while the others are rendered to, so the swapchain needs
+	 * one image more than there are frames in flight. The swapchain adds one for mailbox.
+	 */
 	swapchain.init(device, surface, static_cast<uint32_t>(width()),
-		       static_cast<uint32_t>(height()), vsync);
+		       static_cast<uint32_t>(height()), vsync, framesInFlight + 1);
 	bpUtil::connect(swapchain.resizeEvent, *this, &Window::resizeRenderResources);
 
 	graphicsQueue = &device.getGraphicsQueue();
@@ -38,9 +52,16 @@ void Window::init()
 	bpUtil::connect(swapchain.presentQueuedEvent, *this, &Window::presentQueued);
 
 	cmdPool.init(device.getGraphicsQueue());
-	frameCmdBuffer = cmdPool.allocateCommandBuffer();
-
-	renderCompleteSem.init(device);
+	frames.reset(new FrameContext[framesInFlight]);
+	for (unsigned i = 0; i < framesInFlight; i++)
+	{
+		frames[i].cmdBuffer = cmdPool.allocateCommandBuffer();
+		frames[i].fence.init(device, VK_FENCE_CREATE_SIGNALED_BIT);
+		frames[i].imageAvailableSem.init(device);
+		frames[i].renderCompleteSem.init(device);
+	}
+	frameIndex = 0;
+	device.getRetireQueue().setFrameCount(framesInFlight);
 
 	frameCmdBufferBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	frameCmdBufferBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
@@ -63,14 +84,29 @@ void Window::frame()
 		resized = false;
 	}
 
-	vkBeginCommandBuffer(frameCmdBuffer, &frameCmdBufferBeginInfo);
-	render(frameCmdBuffer);
-	vkEndCommandBuffer(frameCmdBuffer);
-
-	graphicsQueue->submit({{swapchain.getImageAvailableSemaphore(), VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT}},
-		     {frameCmdBuffer}, {renderCompleteSem});
-	graphicsQueue->waitIdle();
-	swapchain.present(renderCompleteSem);
+	/*
+	 * Only wait for the frame that last used this context, so the CPU can record the next
+	 * frames while the GPU is still busy with the previous ones.
+	 */
+	FrameContext& current = frames[frameIndex];
+	current.fence.wait();
+	device.getRetireQueue().beginFrame(frameIndex);
+	swapchain.setImageAvailableSemaphore(current.imageAvailableSem);
+
+	vkBeginCommandBuffer(current.cmdBuffer, &frameCmdBufferBeginInfo);
+	render(current.cmdBuffer);
+	vkEndCommandBuffer(current.cmdBuffer);
+
+	/*
+	 * The fence is reset just before it is submitted, so that it stays signaled and the frame
+	 * context can be reused if recording throws.
+	 */
+	current.fence.reset();
+	graphicsQueue->submit({{current.imageAvailableSem,
+				VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT}},
+			      {current.cmdBuffer}, {current.renderCompleteSem}, current.fence);
+	swapchain.present(current.renderCompleteSem);
+	frameIndex = (frameIndex + 1) % framesInFlight;
 
 	auto updatedTimer = Clock::now();
 	Duration delta = updatedTimer - timer;
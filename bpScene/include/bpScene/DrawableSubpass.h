@@ -3,7 +3,12 @@
 
 #include "Drawable.h"
 #include <bp/Subpass.h>
+#include <bp/CommandPool.h>
+#include <bpUtil/AsyncQueue.h>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <future>
 
 namespace bpScene
 {
@@ -12,16 +17,62 @@ class DrawableSubpass : public bp::Subpass
 {
 public:
 	DrawableSubpass() :
-		Subpass{} {}
+		Subpass{},
+		frameIndex{0},
+		minDrawablesPerWorker{256} {}
+	~DrawableSubpass();
 
 	void render(const VkRect2D& area, VkCommandBuffer cmdBuffer) override;
+	VkSubpassContents getContents() const override
+	{
+		return frames.empty() ? VK_SUBPASS_CONTENTS_INLINE
+				      : VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS;
+	}
 	void addDrawable(Drawable& drawable);
 	void removeDrawable(Drawable& drawable);
 
+	/*
+	 * Split the drawables across workerCount threads, the rendering thread included, each
+	 * recording a secondary command buffer that is executed in order by the primary command
+	 * buffer. Command buffers are allocated for queue, the queue the primary command buffer is
+	 * submitted to, and are reused frameCount renders later, so there must be no more than
+	 * frameCount frames in flight. Drawables must be safe to record from any thread.
+	 */
+	void setParallelRecording(bp::Queue& queue, unsigned workerCount, unsigned frameCount = 2);
+	void setMinDrawablesPerWorker(unsigned count) { minDrawablesPerWorker = count; }
+
+	unsigned getWorkerCount() const { return static_cast<unsigned>(workers.size()) + 1; }
+
 private:
+	struct Job
+	{
+		size_t begin, end;
+		VkRect2D area;
+		VkCommandBuffer cmdBuffer;
+		bp::CommandPool* pool;
+		std::promise<void> done;
+	};
+
+	struct WorkerFrame
+	{
+		bp::CommandPool pool;
+		VkCommandBuffer cmdBuffer;
+	};
+
 	std::vector<Drawable*> drawables;
+
+	std::vector<std::unique_ptr<WorkerFrame[]>> frames;
+	unsigned frameIndex;
+	unsigned minDrawablesPerWorker;
+	std::vector<std::thread> workers;
+	bpUtil::AsyncQueue<Job*> jobQueue;
+
+	void recordDrawables(size_t begin, size_t end, const VkRect2D& area,
+			     VkCommandBuffer cmdBuffer);
+	void recordSecondary(Job& job);
+	void stopWorkers();
 };
 
 }
 
-#endif
\ No newline at end of file
+#endif
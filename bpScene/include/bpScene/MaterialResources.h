@@ -3,6 +3,7 @@
 
 #include "Material.h"
 #include <bp/Texture.h>
+#include <bp/TextureStreamer.h>
 #include <bp/DescriptorPool.h>
 #include <bp/DescriptorSet.h>
 #include <bp/BufferDescriptor.h>
@@ -23,6 +24,31 @@ public:
 		  bp::DescriptorSetLayout& descriptorSetLayout,
 		  uint32_t textureBinding, uint32_t uniformBinding,
 		  bp::Buffer& uniformBuffer, VkDeviceSize offset);
+	void init(bp::UploadContext& uploadContext, const Material& material,
+		  bp::DescriptorPool& descriptorPool, bp::DescriptorSetLayout& descriptorSetLayout,
+		  uint32_t textureBinding, uint32_t uniformBinding,
+		  bp::Buffer& uniformBuffer, VkDeviceSize offset);
+	/*
+	 * Stream the texture of the material with textureStreamer instead of loading it. The
+	 * descriptor set is updated as the texture becomes resident, so the material can be drawn
+	 * right away. This requires a layout with push descriptors or updates after binding, and
+	 * the texture is loaded up front otherwise.
+	 */
+	void init(bp::UploadContext& uploadContext, bp::TextureStreamer& textureStreamer,
+		  const Material& material, bp::DescriptorPool& descriptorPool,
+		  bp::DescriptorSetLayout& descriptorSetLayout,
+		  uint32_t textureBinding, uint32_t uniformBinding,
+		  bp::Buffer& uniformBuffer, VkDeviceSize offset);
+
+	/*
+	 * Bindless setup, where the material has no descriptor set of its own. The texture is
+	 * bound to the shared set at element index of the texture array at textureBinding, and the
+	 * uniform is written to element index of the material storage buffer.
+	 */
+	void initBindless(bp::UploadContext& uploadContext, bp::TextureStreamer* textureStreamer,
+			  const Material& material, bp::DescriptorSet& sharedDescriptorSet,
+			  bp::DescriptorSetLayout& descriptorSetLayout, uint32_t textureBinding,
+			  uint32_t index, bp::Buffer& materialBuffer);
 
 	bp::DescriptorSet& getDescriptorSet() { return descriptorSet; }
 
@@ -32,6 +58,17 @@ private:
 	bp::DescriptorSet descriptorSet;
 	bp::Texture texture;
 	bp::BufferDescriptor uniformBufferDescriptor;
+
+	void setup(bp::UploadContext& uploadContext, bp::TextureStreamer* textureStreamer,
+		   const Material& material, bp::DescriptorPool& descriptorPool,
+		   bp::DescriptorSetLayout& descriptorSetLayout,
+		   uint32_t textureBinding, uint32_t uniformBinding,
+		   bp::Buffer& uniformBuffer, VkDeviceSize offset);
+	void setupTexture(bp::UploadContext& uploadContext, bp::TextureStreamer* textureStreamer,
+			  const Material& material, bp::DescriptorSet& descriptorSet,
+			  bool updatable);
+	void uploadUniform(bp::UploadContext& uploadContext, const Material& material,
+			   bp::Buffer& buffer, VkDeviceSize offset);
 };
 
 }
@@ -3,6 +3,7 @@
 
 #include "Mesh.h"
 #include <bp/Buffer.h>
+#include <bp/UploadContext.h>
 #include <vector>
 
 namespace bpScene
@@ -27,6 +28,17 @@ public:
 		init(device, mesh, 0, mesh.getElementCount());
 	}
 	void init(bp::Device& device, const Mesh& mesh, uint32_t offset, uint32_t count);
+	void init(bp::UploadContext& uploadContext, const Mesh& mesh)
+	{
+		init(uploadContext, mesh, 0, mesh.getElementCount());
+	}
+	void init(bp::UploadContext& uploadContext, const Mesh& mesh, uint32_t offset,
+		  uint32_t count);
+	/*
+	 * Let defragmentation move the buffers of the mesh. They are bound by handle every time
+	 * the mesh is drawn, so no descriptors need to be updated.
+	 */
+	void enableRelocation();
 	void bind(VkCommandBuffer cmdBuffer);
 	VkPrimitiveTopology getTopology() const { return topology; }
 	uint32_t getOffset() const { return offset; }
@@ -10,14 +10,31 @@ namespace bpScene
 class ModelDrawable : public Drawable
 {
 public:
-	ModelDrawable() : pipeline{nullptr}, model{nullptr} {}
+	ModelDrawable() :
+		pipeline{nullptr},
+		model{nullptr},
+		materialIndexStages{VK_SHADER_STAGE_FRAGMENT_BIT},
+		materialIndexOffset{0} {}
 
 	void init(bp::GraphicsPipeline& pipeline, ModelResources& model);
+
+	/*
+	 * Push constant range the material index is written to when drawing a bindless model. The
+	 * index is a single uint.
+	 */
+	void setMaterialIndexPushConstant(VkShaderStageFlags stages, uint32_t offset)
+	{
+		materialIndexStages = stages;
+		materialIndexOffset = offset;
+	}
+
 	void draw(VkCommandBuffer cmdBuffer) override;
 	bp::GraphicsPipeline* getPipeline() override { return pipeline; }
 private:
 	bp::GraphicsPipeline* pipeline;
 	ModelResources* model;
+	VkShaderStageFlags materialIndexStages;
+	uint32_t materialIndexOffset;
 };
 
 }
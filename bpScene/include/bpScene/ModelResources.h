@@ -19,7 +19,43 @@ class ModelResources
 public:
 	void init(bp::Device& device, bp::DescriptorSetLayout& descriptorSetLayout,
 		  uint32_t textureBinding, uint32_t uniformBinding, const Model& model);
+	/*
+	 * Stream the textures of the materials with textureStreamer. Meshes and uniforms are
+	 * uploaded before init returns. Textures are only streamed when the layout has push
+	 * descriptors or updates after binding, as the descriptor sets of the materials are used by
+	 * pending frames when streamed levels become resident. Otherwise they are loaded up front.
+	 */
+	void init(bp::Device& device, bp::TextureStreamer& textureStreamer,
+		  bp::DescriptorSetLayout& descriptorSetLayout,
+		  uint32_t textureBinding, uint32_t uniformBinding, const Model& model);
+
+	/*
+	 * Bindless setup, using VK_EXT_descriptor_indexing. The textures of all materials are bound
+	 * to one array at textureBinding, indexed by material index, and the uniforms of all
+	 * materials are in one storage buffer at materialBinding. The model is drawn with a single
+	 * descriptor set, and the material index of each mesh is passed as a push constant. The
+	 * layout must be set up with addBindlessLayoutBindings. textureStreamer may be null, and is
+	 * not used unless the layout can be updated after binding, as the descriptor set of a
+	 * model is used by every frame. The textures are then loaded up front.
+	 */
+	void initBindless(bp::Device& device, bp::TextureStreamer* textureStreamer,
+			  bp::DescriptorSetLayout& descriptorSetLayout,
+			  uint32_t textureBinding, uint32_t materialBinding, const Model& model);
+
+	/*
+	 * Add the bindings for bindless models to layout. The texture array is partially bound,
+	 * so that untextured materials need no texture, and maxMaterialCount is the most materials
+	 * a model using the layout may have. When the device has the sampled image update after
+	 * bind and update unused while pending features enabled, streamed textures are written
+	 * to the array while frames using it are pending.
+	 */
+	static void addBindlessLayoutBindings(bp::Device& device, bp::DescriptorSetLayout& layout,
+					      uint32_t textureBinding, uint32_t materialBinding,
+					      uint32_t maxMaterialCount,
+					      VkShaderStageFlags stages = VK_SHADER_STAGE_FRAGMENT_BIT);
 
+	bool isBindless() const { return bindlessDescriptorSet.isReady(); }
+	bp::DescriptorSet& getBindlessDescriptorSet() { return bindlessDescriptorSet; }
 	unsigned getMeshCount() const { return static_cast<unsigned>(meshes.size()); }
 	unsigned getMaterialCount() const { return static_cast<unsigned>(materials.size()); }
 	MeshResources& getMesh(unsigned index) { return meshes[index];}
@@ -43,6 +79,14 @@ private:
 
 	VkDeviceSize uniformStride;
 	bp::Buffer uniformBuffer;
+
+	bp::DescriptorSet bindlessDescriptorSet;
+	bp::BufferDescriptor materialBufferDescriptor;
+
+	void initMeshes(bp::UploadContext& uploadContext, const Model& model);
+	void setup(bp::Device& device, bp::TextureStreamer* textureStreamer,
+		   bp::DescriptorSetLayout& descriptorSetLayout,
+		   uint32_t textureBinding, uint32_t uniformBinding, const Model& model);
 };
 
 }
@@ -7,14 +7,96 @@ using namespace std;
 namespace bpScene
 {
 
+DrawableSubpass::~DrawableSubpass()
+{
+	stopWorkers();
+}
+
 void DrawableSubpass::render(const VkRect2D& area, VkCommandBuffer cmdBuffer)
+{
+	if (frames.empty())
+	{
+		recordDrawables(0, drawables.size(), area, cmdBuffer);
+		return;
+	}
+
+	/*
+	 * Only as many workers as there are drawables for are used, but at least one secondary
+	 * command buffer must be recorded, as the subpass contents are secondary.
+	 */
+	WorkerFrame* frame = frames[frameIndex].get();
+	frameIndex = (frameIndex + 1) % static_cast<unsigned>(frames.size());
+	size_t perWorker = max<size_t>(minDrawablesPerWorker, 1);
+	size_t jobCount = min<size_t>(getWorkerCount(), (drawables.size() + perWorker - 1) / perWorker);
+	jobCount = max<size_t>(jobCount, 1);
+	size_t chunk = (drawables.size() + jobCount - 1) / jobCount;
+
+	vector<Job> jobs(jobCount);
+	vector<future<void>> futures;
+	for (size_t i = 0; i < jobCount; i++)
+	{
+		Job& job = jobs[i];
+		job.begin = min(i * chunk, drawables.size());
+		job.end = min(job.begin + chunk, drawables.size());
+		job.area = area;
+		job.cmdBuffer = frame[i].cmdBuffer;
+		job.pool = &frame[i].pool;
+		futures.push_back(job.done.get_future());
+		if (i > 0) jobQueue.enqueue(&job);
+	}
+	recordSecondary(jobs[0]);
+
+	/*
+	 * The jobs live on this stack frame, so every worker must be done with them before an
+	 * exception from any of them is rethrown.
+	 */
+	for (auto& f : futures) f.wait();
+	for (auto& f : futures) f.get();
+
+	vector<VkCommandBuffer> cmdBuffers;
+	for (auto& job : jobs) cmdBuffers.push_back(job.cmdBuffer);
+	vkCmdExecuteCommands(cmdBuffer, static_cast<uint32_t>(cmdBuffers.size()),
+			     cmdBuffers.data());
+}
+
+void DrawableSubpass::setParallelRecording(Queue& queue, unsigned workerCount,
+					   unsigned frameCount)
+{
+	stopWorkers();
+	frames.clear();
+	frameIndex = 0;
+	if (workerCount == 0 || frameCount == 0) return;
+
+	for (unsigned i = 0; i < frameCount; i++)
+	{
+		frames.emplace_back(new WorkerFrame[workerCount]);
+		for (unsigned j = 0; j < workerCount; j++)
+		{
+			WorkerFrame& w = frames.back()[j];
+			w.pool.init(queue, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+			w.cmdBuffer = w.pool.allocateCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		}
+	}
+
+	for (unsigned i = 1; i < workerCount; i++)
+	{
+		workers.emplace_back([this] {
+			for (Job* job = jobQueue.dequeue(); job != nullptr; job = jobQueue.dequeue())
+				recordSecondary(*job);
+		});
+	}
+}
+
+void DrawableSubpass::recordDrawables(size_t begin, size_t end, const VkRect2D& area,
+				      VkCommandBuffer cmdBuffer)
 {
 	VkViewport viewport = {(float) area.offset.x, (float) area.offset.y,
 			       (float) area.extent.width, (float) area.extent.height, 0.f, 1.f};
 
 	GraphicsPipeline* currentPipeline = nullptr;
-	for (auto d : drawables)
+	for (size_t i = begin; i < end; i++)
 	{
+		Drawable* d = drawables[i];
 		if (d->getPipeline() != currentPipeline)
 		{
 			currentPipeline = d->getPipeline();
@@ -31,6 +113,38 @@ void DrawableSubpass::render(const VkRect2D& area, VkCommandBuffer cmdBuffer)
 	}
 }
 
+/*
+ * Secondary command buffers inherit no state, so each one binds its first pipeline and sets
+ * the viewport and scissor again.
+ */
+void DrawableSubpass::recordSecondary(Job& job)
+{
+	try
+	{
+		job.pool->reset();
+
+		VkCommandBufferBeginInfo beginInfo = {};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT
+				  | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+		beginInfo.pInheritanceInfo = &getInheritanceInfo();
+		vkBeginCommandBuffer(job.cmdBuffer, &beginInfo);
+		recordDrawables(job.begin, job.end, job.area, job.cmdBuffer);
+		vkEndCommandBuffer(job.cmdBuffer);
+		job.done.set_value();
+	} catch (...)
+	{
+		job.done.set_exception(current_exception());
+	}
+}
+
+void DrawableSubpass::stopWorkers()
+{
+	for (size_t i = 0; i < workers.size(); i++) jobQueue.enqueue(nullptr);
+	for (auto& w : workers) w.join();
+	workers.clear();
+}
+
 static bool drawablePipelineSortPredicate(Drawable* a, Drawable* b)
 {
 	return a->getPipeline() < b->getPipeline();
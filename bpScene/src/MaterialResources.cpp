@@ -1,5 +1,7 @@
 #include <bpScene/MaterialResources.h>
 #include <bp/Buffer.h>
+#include <bp/CompressedImage.h>
+#include <bp/Util.h>
 
 using namespace bp;
 using namespace std;
@@ -13,17 +15,65 @@ void MaterialResources::init(Device& device, const Material& material,
 			     uint32_t textureBinding, uint32_t uniformBinding,
 			     Buffer& uniformBuffer, VkDeviceSize offset)
 {
-	descriptorSet.init(device, descriptorPool, descriptorSetLayout);
+	UploadContext& uploadContext = device.getUploadContext();
+	init(uploadContext, material, descriptorPool, descriptorSetLayout, textureBinding,
+	     uniformBinding, uniformBuffer, offset);
+	uploadContext.submit().wait();
+}
+
+void MaterialResources::init(UploadContext& uploadContext, const Material& material,
+			     DescriptorPool& descriptorPool,
+			     bp::DescriptorSetLayout& descriptorSetLayout,
+			     uint32_t textureBinding, uint32_t uniformBinding,
+			     Buffer& uniformBuffer, VkDeviceSize offset)
+{
+	setup(uploadContext, nullptr, material, descriptorPool, descriptorSetLayout, textureBinding,
+	      uniformBinding, uniformBuffer, offset);
+}
+
+void MaterialResources::init(UploadContext& uploadContext, TextureStreamer& textureStreamer,
+			     const Material& material, DescriptorPool& descriptorPool,
+			     bp::DescriptorSetLayout& descriptorSetLayout,
+			     uint32_t textureBinding, uint32_t uniformBinding,
+			     Buffer& uniformBuffer, VkDeviceSize offset)
+{
+	setup(uploadContext, &textureStreamer, material, descriptorPool, descriptorSetLayout,
+	      textureBinding, uniformBinding, uniformBuffer, offset);
+}
+
+void MaterialResources::initBindless(UploadContext& uploadContext,
+				     TextureStreamer* textureStreamer, const Material& material,
+				     DescriptorSet& sharedDescriptorSet,
+				     bp::DescriptorSetLayout& descriptorSetLayout,
+				     uint32_t textureBinding, uint32_t index,
+				     Buffer& materialBuffer)
+{
 	if (material.isTextured())
 	{
-		texture.load(device, VK_IMAGE_USAGE_SAMPLED_BIT, material.getTexturePath());
-		texture.getImage().freeStagingBuffer();
-		loadMessageEvent("Loaded texture \"" + material.getTexturePath()
-				 + "\" of resolution "
-				 + to_string(texture.getWidth()) + "X"
-				 + to_string(texture.getHeight()) + ".");
-		texture.transitionShaderReadable(VK_NULL_HANDLE,
-						 VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+		setupTexture(uploadContext, textureStreamer, material, sharedDescriptorSet,
+			     descriptorSetLayout.isUpdateAfterBindEnabled());
+		texture.setDescriptorBinding(textureBinding);
+		texture.setDescriptorArrayIndex(index);
+		sharedDescriptorSet.bind(texture.getDescriptor());
+	}
+	uploadUniform(uploadContext, material, materialBuffer, index * sizeof(MaterialUniform));
+}
+
+void MaterialResources::setup(UploadContext& uploadContext, TextureStreamer* textureStreamer,
+			      const Material& material, DescriptorPool& descriptorPool,
+			      bp::DescriptorSetLayout& descriptorSetLayout,
+			      uint32_t textureBinding, uint32_t uniformBinding,
+			      Buffer& uniformBuffer, VkDeviceSize offset)
+{
+	if (descriptorSetLayout.isPushDescriptorsEnabled())
+		descriptorSet.init(uploadContext.getDevice(), descriptorSetLayout);
+	else
+		descriptorSet.init(uploadContext.getDevice(), descriptorPool, descriptorSetLayout);
+	if (material.isTextured())
+	{
+		setupTexture(uploadContext, textureStreamer, material, descriptorSet,
+			     descriptorSetLayout.isPushDescriptorsEnabled()
+			     || descriptorSetLayout.isUpdateAfterBindEnabled());
 		texture.setDescriptorBinding(textureBinding);
 		descriptorSet.bind(texture.getDescriptor());
 	}
@@ -36,9 +86,69 @@ void MaterialResources::init(Device& device, const Material& material,
 
 	descriptorSet.update();
 
-	MaterialUniform& uniform = *reinterpret_cast<MaterialUniform*>(uniformBuffer.map() + offset);
+	uploadUniform(uploadContext, material, uniformBuffer, offset);
+}
+
+/*
+ * Load or stream the texture of the material. Streamed textures update descriptorSet as they
+ * become resident, and loaded textures when moved by defragmentation. Both require descriptorSet
+ * to be updatable, meaning that it is a push descriptor set or allows updates after binding, as
+ * frames using it may be pending. Otherwise the texture is loaded and stays in place.
+ */
+void MaterialResources::setupTexture(UploadContext& uploadContext,
+				     TextureStreamer* textureStreamer, const Material& material,
+				     DescriptorSet& descriptorSet, bool updatable)
+{
+	/*
+	 * Prefer a pre-compressed variant of the texture, if the device can sample from its
+	 * format.
+	 */
+	string path = material.getTexturePath();
+	string compressedPath = CompressedImage::findVariant(path);
+	if (!compressedPath.empty()
+	    && isFormatSupported(uploadContext.getDevice().getPhysicalHandle(),
+				 CompressedImage::queryFormat(compressedPath),
+				 VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT))
+		path = compressedPath;
+
+	if (textureStreamer != nullptr && updatable)
+	{
+		/*
+		 * Only the descriptor of the texture is written, as the set may be a bindless set
+		 * whose other bindings can not be updated while frames using it are pending.
+		 */
+		DescriptorSet* set = &descriptorSet;
+		const Descriptor* descriptor = &texture.getDescriptor();
+		textureStreamer->stream(texture, path, [set, descriptor] {
+			set->update(*descriptor);
+		});
+		loadMessageEvent("Streaming texture \"" + path + "\".");
+	} else
+	{
+		texture.load(uploadContext, VK_IMAGE_USAGE_SAMPLED_BIT, path);
+		if (updatable)
+		{
+			DescriptorSet* set = &descriptorSet;
+			const Descriptor* descriptor = &texture.getDescriptor();
+			texture.enableRelocation();
+			bpUtil::connect(texture.relocateEvent, [set, descriptor] {
+				set->update(*descriptor);
+			});
+		}
+		loadMessageEvent("Loaded texture \"" + path
+				 + "\" of resolution "
+				 + to_string(texture.getWidth()) + "X"
+				 + to_string(texture.getHeight()) + ".");
+	}
+}
+
+void MaterialResources::uploadUniform(UploadContext& uploadContext, const Material& material,
+				      Buffer& buffer, VkDeviceSize offset)
+{
+	MaterialUniform uniform;
 	uniform.ambient = {material.getAmbient(), 1.f};
 	uniform.diffuse = {material.getDiffuse(), 1.f};
+	uploadContext.upload(buffer, offset, sizeof(MaterialUniform), &uniform);
 }
 
 }
\ No newline at end of file
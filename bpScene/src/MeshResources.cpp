@@ -8,6 +8,15 @@ namespace bpScene
 
 void MeshResources::init(Device& device, const Mesh& mesh, uint32_t offset, uint32_t count)
 {
+	UploadContext& uploadContext = device.getUploadContext();
+	init(uploadContext, mesh, offset, count);
+	uploadContext.submit().wait();
+}
+
+void MeshResources::init(UploadContext& uploadContext, const Mesh& mesh, uint32_t offset,
+			 uint32_t count)
+{
+	Device& device = uploadContext.getDevice();
 	MeshResources::offset = offset;
 	MeshResources::elementCount = count;
 	indexBufferOffset = offset * sizeof(uint32_t);
@@ -19,37 +28,46 @@ void MeshResources::init(Device& device, const Mesh& mesh, uint32_t offset, uint
 	buffers.resize(bufferCount);
 
 	buffers[0].init(device, mesh.getIndexDataSize(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-			VMA_MEMORY_USAGE_GPU_ONLY);
-	buffers[0].transfer(0, VK_WHOLE_SIZE, mesh.getIndexDataPtr());
-	buffers[0].freeStagingBuffer();
+			VMA_MEMORY_USAGE_GPU_ONLY, MemoryPool::STATIC_GEOMETRY);
+	uploadContext.upload(buffers[0], 0, VK_WHOLE_SIZE, mesh.getIndexDataPtr());
 
 	buffers[1].init(device, mesh.getPositionDataSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			  VMA_MEMORY_USAGE_GPU_ONLY);
-	buffers[1].transfer(0, VK_WHOLE_SIZE, mesh.getPositionDataPtr());
-	buffers[1].freeStagingBuffer();
+			VMA_MEMORY_USAGE_GPU_ONLY, MemoryPool::STATIC_GEOMETRY);
+	uploadContext.upload(buffers[1], 0, VK_WHOLE_SIZE, mesh.getPositionDataPtr());
 	vertexBufferOffsets.push_back(0);
 	vertexBufferHandles.push_back(buffers[1].getHandle());
 
 	if (mesh.haveNormals())
 	{
 		buffers[2].init(device, mesh.getNormalDataSize(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-				VMA_MEMORY_USAGE_GPU_ONLY);
-		buffers[2].transfer(0, VK_WHOLE_SIZE, mesh.getNormalDataPtr());
-		buffers[2].freeStagingBuffer();
+				VMA_MEMORY_USAGE_GPU_ONLY, MemoryPool::STATIC_GEOMETRY);
+		uploadContext.upload(buffers[2], 0, VK_WHOLE_SIZE, mesh.getNormalDataPtr());
 		vertexBufferOffsets.push_back(0);
 		vertexBufferHandles.push_back(buffers[2].getHandle());
 	}
 	if (mesh.haveTexCoords())
 	{
 		buffers[3].init(device, mesh.getTexCoordDataSize(),
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-		buffers[3].transfer(0, VK_WHOLE_SIZE, mesh.getTexCoordDataPtr());
-		buffers[3].freeStagingBuffer();
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY,
+				MemoryPool::STATIC_GEOMETRY);
+		uploadContext.upload(buffers[3], 0, VK_WHOLE_SIZE, mesh.getTexCoordDataPtr());
 		vertexBufferOffsets.push_back(0);
 		vertexBufferHandles.push_back(buffers[3].getHandle());
 	}
 }
 
+void MeshResources::enableRelocation()
+{
+	buffers[0].enableRelocation();
+	for (size_t i = 1; i < buffers.size(); i++)
+	{
+		buffers[i].enableRelocation();
+		bpUtil::connect(buffers[i].relocateEvent, [this, i] {
+			vertexBufferHandles[i - 1] = buffers[i].getHandle();
+		});
+	}
+}
+
 void MeshResources::bind(VkCommandBuffer cmdBuffer)
 {
 	vkCmdBindVertexBuffers(cmdBuffer, 0, static_cast<uint32_t>(vertexBufferHandles.size()),
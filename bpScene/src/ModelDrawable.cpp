@@ -11,13 +11,28 @@ void ModelDrawable::init(bp::GraphicsPipeline& pipeline, ModelResources& model)
 
 void ModelDrawable::draw(VkCommandBuffer cmdBuffer)
 {
+	if (model->isBindless())
+	{
+		model->getBindlessDescriptorSet().bind(cmdBuffer, pipeline->getPipelineLayout());
+		for (unsigned i = 0; i < model->getMeshCount(); i++)
+		{
+			uint32_t materialIndex = model->getMaterialIndexForMesh(i);
+			vkCmdPushConstants(cmdBuffer, pipeline->getPipelineLayout(),
+					   materialIndexStages, materialIndexOffset,
+					   sizeof(materialIndex), &materialIndex);
+
+			auto& mesh = model->getMesh(i);
+			mesh.bind(cmdBuffer);
+			vkCmdDrawIndexed(cmdBuffer, mesh.getElementCount(), 1, 0, 0, 0);
+		}
+		return;
+	}
+
 	for (unsigned i = 0; i < model->getMeshCount(); i++)
 	{
 		auto& material = model->getMaterialForMesh(i);
 
-		VkDescriptorSet set = material.getDescriptorSet();
-		vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
-					pipeline->getPipelineLayout(), 0, 1, &set, 0, nullptr);
+		material.getDescriptorSet().bind(cmdBuffer, pipeline->getPipelineLayout());
 
 		auto& mesh = model->getMesh(i);
 		mesh.bind(cmdBuffer);
@@ -1,4 +1,8 @@
 #include <bpScene/ModelResources.h>
+#include <stdexcept>
+#include <algorithm>
+
+using namespace std;
 
 namespace bpScene
 {
@@ -6,14 +10,22 @@ namespace bpScene
 void ModelResources::init(bp::Device& device, bp::DescriptorSetLayout& descriptorSetLayout,
 			  uint32_t textureBinding, uint32_t uniformBinding, const Model& model)
 {
-	meshMaterialIndices = model.meshMaterialIndices;
+	setup(device, nullptr, descriptorSetLayout, textureBinding, uniformBinding, model);
+}
 
-	meshes.resize(model.getMeshCount());
+void ModelResources::init(bp::Device& device, bp::TextureStreamer& textureStreamer,
+			  bp::DescriptorSetLayout& descriptorSetLayout,
+			  uint32_t textureBinding, uint32_t uniformBinding, const Model& model)
+{
+	setup(device, &textureStreamer, descriptorSetLayout, textureBinding, uniformBinding, model);
+}
 
-	for (unsigned i = 0; i < model.getMeshCount(); i++)
-	{
-		meshes[i].init(device, model.getMesh(i));
-	}
+void ModelResources::setup(bp::Device& device, bp::TextureStreamer* textureStreamer,
+			   bp::DescriptorSetLayout& descriptorSetLayout,
+			   uint32_t textureBinding, uint32_t uniformBinding, const Model& model)
+{
+	bp::UploadContext& uploadContext = device.getUploadContext();
+	initMeshes(uploadContext, model);
 
 	auto& limits = device.getProperties().limits;
 
@@ -25,20 +37,106 @@ void ModelResources::init(bp::Device& device, bp::DescriptorSetLayout& descripto
 	uniformBuffer.init(device, uniformBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 			   VMA_MEMORY_USAGE_GPU_ONLY);
 
-	descriptorPool.init(device,
-			    {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, model.getMaterialCount()},
-			     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, model.getMaterialCount()}},
-			    model.getMaterialCount());
+	VkDescriptorPoolCreateFlags poolFlags = 0;
+	if (descriptorSetLayout.isUpdateAfterBindEnabled())
+		poolFlags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	if (!descriptorSetLayout.isPushDescriptorsEnabled())
+		descriptorPool.init(device,
+				    {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, model.getMaterialCount()},
+				     {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, model.getMaterialCount()}},
+				    model.getMaterialCount(), poolFlags);
 
 	materials.resize(model.getMaterialCount());
 	for (unsigned i = 0; i < model.getMaterialCount(); i++)
 	{
 		bpUtil::connect(materials[i].loadMessageEvent, loadMessageEvent);
-		materials[i].init(device, model.getMaterial(i), descriptorPool, descriptorSetLayout,
-				  textureBinding, uniformBinding, uniformBuffer, i * uniformStride);
+		if (textureStreamer != nullptr)
+			materials[i].init(uploadContext, *textureStreamer, model.getMaterial(i),
+					  descriptorPool, descriptorSetLayout, textureBinding,
+					  uniformBinding, uniformBuffer, i * uniformStride);
+		else
+			materials[i].init(uploadContext, model.getMaterial(i), descriptorPool,
+					  descriptorSetLayout, textureBinding, uniformBinding,
+					  uniformBuffer, i * uniformStride);
+	}
+	uploadContext.submit().wait();
+}
+
+void ModelResources::initBindless(bp::Device& device, bp::TextureStreamer* textureStreamer,
+				  bp::DescriptorSetLayout& descriptorSetLayout,
+				  uint32_t textureBinding, uint32_t materialBinding,
+				  const Model& model)
+{
+	uint32_t materialCount = model.getMaterialCount();
+	for (auto& binding : descriptorSetLayout.getBindings())
+	{
+		if (binding.binding == textureBinding && binding.descriptorCount < materialCount)
+			throw runtime_error("Model has more materials than the texture array holds.");
 	}
-	uniformBuffer.flushStagingBuffer();
 
+	bp::UploadContext& uploadContext = device.getUploadContext();
+	initMeshes(uploadContext, model);
+
+	VkDeviceSize materialBufferSize = max(materialCount, 1u)
+					  * sizeof(MaterialResources::MaterialUniform);
+	uniformBuffer.init(device, materialBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+			   VMA_MEMORY_USAGE_GPU_ONLY);
+
+	VkDescriptorPoolCreateFlags poolFlags = 0;
+	if (descriptorSetLayout.isUpdateAfterBindEnabled())
+		poolFlags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT_EXT;
+	else textureStreamer = nullptr;
+	descriptorPool.init(device,
+			    {{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, max(materialCount, 1u)},
+			     {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1}},
+			    1, poolFlags);
+	bindlessDescriptorSet.init(device, descriptorPool, descriptorSetLayout);
+
+	materials.resize(materialCount);
+	for (unsigned i = 0; i < materialCount; i++)
+	{
+		bpUtil::connect(materials[i].loadMessageEvent, loadMessageEvent);
+		materials[i].initBindless(uploadContext, textureStreamer, model.getMaterial(i),
+					  bindlessDescriptorSet, descriptorSetLayout,
+					  textureBinding, i, uniformBuffer);
+	}
+
+	materialBufferDescriptor.setType(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	materialBufferDescriptor.setBinding(materialBinding);
+	materialBufferDescriptor.addDescriptorInfo({uniformBuffer.getHandle(), 0,
+						    materialBufferSize});
+	bindlessDescriptorSet.bind(materialBufferDescriptor);
+	bindlessDescriptorSet.update();
+
+	uploadContext.submit().wait();
+}
+
+void ModelResources::addBindlessLayoutBindings(bp::Device& device, bp::DescriptorSetLayout& layout,
+					       uint32_t textureBinding, uint32_t materialBinding,
+					       uint32_t maxMaterialCount, VkShaderStageFlags stages)
+{
+	auto& features = device.getDescriptorIndexingFeatures();
+	VkDescriptorBindingFlagsEXT flags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT_EXT;
+	if (features.descriptorBindingSampledImageUpdateAfterBind
+	    && features.descriptorBindingUpdateUnusedWhilePending)
+		flags |= VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT
+			 | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
+
+	layout.addLayoutBinding({textureBinding, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+				 maxMaterialCount, stages, nullptr}, flags);
+	layout.addLayoutBinding({materialBinding, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, stages,
+				 nullptr});
+}
+
+void ModelResources::initMeshes(bp::UploadContext& uploadContext, const Model& model)
+{
+	meshMaterialIndices = model.meshMaterialIndices;
+	meshes.resize(model.getMeshCount());
+	for (unsigned i = 0; i < model.getMeshCount(); i++)
+	{
+		meshes[i].init(uploadContext, model.getMesh(i));
+		meshes[i].enableRelocation();
+	}
 }
 
 }
\ No newline at end of file